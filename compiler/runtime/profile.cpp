@@ -0,0 +1,208 @@
+// Profile runtime of programs compiled with `tildac -fprofile-generate`. Link the library into the
+// program together with its objects, e.g. `cc prog.o -ltildac_profile`. Every instrumented object
+// references the runtime, so the linker pulls it out of the archive. When the program exits, the runtime
+// writes the counters into a raw profile, which `tildac profile-merge` turns into the indexed profile
+// for -fprofile-use.
+//
+// The profile is written to `$LLVM_PROFILE_FILE`, the file named by -fprofile-generate=<file>
+// or `default.profraw`, in that order. An existing profile is overwritten.
+//
+// The layout of the counters and of the raw profile is shared with LLVM through InstrProfData.inc,
+// so that the runtime always matches the version of LLVM that instrumented the program.
+// Values of indirect call targets and memory operation sizes are not collected.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Without any of the list macros defined, the file only defines the names of sections and symbols.
+#include <llvm/ProfileData/InstrProfData.inc>
+
+namespace {
+    enum Value_Kind {
+#define VALUE_PROF_KIND(Enumerator, Value, Descr) Enumerator = Value,
+#include <llvm/ProfileData/InstrProfData.inc>
+    };
+
+    using IntPtrT = void*;
+
+    // Per-function record that the compiler places in the data section.
+    struct Profile_Data {
+#define INSTR_PROF_DATA(Type, LLVMType, Name, Initializer) Type Name;
+#include <llvm/ProfileData/InstrProfData.inc>
+    };
+
+    struct Raw_Header {
+#define INSTR_PROF_RAW_HEADER(Type, Name, Initializer) Type Name;
+#include <llvm/ProfileData/InstrProfData.inc>
+    };
+} // namespace
+
+extern "C" {
+    // Referenced by every instrumented object, so that linking the library pulls in the runtime.
+    int INSTR_PROF_PROFILE_RUNTIME_VAR = 0;
+
+    // Defined by the instrumented objects. The version carries the variant of the profile, e.g. IR-level.
+    extern uint64_t const INSTR_PROF_RAW_VERSION_VAR __attribute__((weak));
+    extern char const INSTR_PROF_PROFILE_NAME_VAR[] __attribute__((weak));
+
+    // The linker defines the bounds of the sections that hold the records, counters and names.
+    extern Profile_Data const INSTR_PROF_SECT_START(INSTR_PROF_DATA_COMMON)[] __attribute__((weak, visibility("hidden")));
+    extern Profile_Data const INSTR_PROF_SECT_STOP(INSTR_PROF_DATA_COMMON)[] __attribute__((weak, visibility("hidden")));
+    extern uint64_t INSTR_PROF_SECT_START(INSTR_PROF_CNTS_COMMON)[] __attribute__((weak, visibility("hidden")));
+    extern uint64_t INSTR_PROF_SECT_STOP(INSTR_PROF_CNTS_COMMON)[] __attribute__((weak, visibility("hidden")));
+    extern char const INSTR_PROF_SECT_START(INSTR_PROF_NAME_COMMON)[] __attribute__((weak, visibility("hidden")));
+    extern char const INSTR_PROF_SECT_STOP(INSTR_PROF_NAME_COMMON)[] __attribute__((weak, visibility("hidden")));
+
+    // Value profiling hooks, of which different versions of LLVM call different ones. Values are not collected.
+    void INSTR_PROF_VALUE_PROF_FUNC(uint64_t, void*, uint32_t) {}
+    void __llvm_profile_instrument_memop(uint64_t, void*, uint32_t) {}
+    void __llvm_profile_instrument_range(uint64_t, void*, uint32_t, int64_t, int64_t, int64_t) {}
+}
+
+namespace {
+    // Named as the initializers of the header fields in InstrProfData.inc expect.
+    uint64_t __llvm_profile_get_magic() {
+        return INSTR_PROF_RAW_MAGIC_64;
+    }
+
+    uint64_t __llvm_profile_get_version() {
+        return &INSTR_PROF_RAW_VERSION_VAR ? INSTR_PROF_RAW_VERSION_VAR : INSTR_PROF_RAW_VERSION;
+    }
+
+    uint64_t __llvm_write_binary_ids(void*) {
+        return 0;
+    }
+
+    uint64_t get_padding(uint64_t const size) {
+        return (sizeof(uint64_t) - size % sizeof(uint64_t)) % sizeof(uint64_t);
+    }
+
+    bool write_padding(FILE* const file, uint64_t const size) {
+        char const zeros[sizeof(uint64_t)] = {};
+        return fwrite(zeros, 1, size, file) == size;
+    }
+
+    // Writes value profile data without any values for a record with value sites. The reader expects
+    // one such entry for every record that has value sites.
+    bool write_empty_value_data(FILE* const file, const Profile_Data& data) {
+        uint32_t kinds = 0;
+        uint32_t total_size = 2 * sizeof(uint32_t);
+        for(uint32_t kind = IPVK_First; kind <= IPVK_Last; ++kind) {
+            if(data.NumValueSites[kind] != 0) {
+                kinds += 1;
+                // The kind, the number of sites and a count of values per site.
+                uint32_t const record_size = 2 * sizeof(uint32_t) + data.NumValueSites[kind];
+                total_size += record_size + static_cast<uint32_t>(get_padding(record_size));
+            }
+        }
+
+        if(kinds == 0) {
+            return true;
+        }
+
+        uint32_t const header[] = {total_size, kinds};
+        if(fwrite(header, sizeof(header), 1, file) != 1) {
+            return false;
+        }
+
+        for(uint32_t kind = IPVK_First; kind <= IPVK_Last; ++kind) {
+            uint32_t const sites = data.NumValueSites[kind];
+            if(sites == 0) {
+                continue;
+            }
+
+            uint32_t const record[] = {kind, sites};
+            if(fwrite(record, sizeof(record), 1, file) != 1) {
+                return false;
+            }
+
+            for(uint32_t site = 0; site < sites; ++site) {
+                if(fputc(0, file) == EOF) {
+                    return false;
+                }
+            }
+
+            if(!write_padding(file, get_padding(2 * sizeof(uint32_t) + sites))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool write_profile(FILE* const file) {
+        Profile_Data const* const DataBegin = INSTR_PROF_SECT_START(INSTR_PROF_DATA_COMMON);
+        Profile_Data const* const data_end = INSTR_PROF_SECT_STOP(INSTR_PROF_DATA_COMMON);
+        uint64_t const* const CountersBegin = INSTR_PROF_SECT_START(INSTR_PROF_CNTS_COMMON);
+        uint64_t const* const counters_end = INSTR_PROF_SECT_STOP(INSTR_PROF_CNTS_COMMON);
+        char const* const NamesBegin = INSTR_PROF_SECT_START(INSTR_PROF_NAME_COMMON);
+        char const* const names_end = INSTR_PROF_SECT_STOP(INSTR_PROF_NAME_COMMON);
+
+        uint64_t const DataSize = static_cast<uint64_t>(data_end - DataBegin);
+        uint64_t const CountersSize = static_cast<uint64_t>(counters_end - CountersBegin);
+        uint64_t const NamesSize = static_cast<uint64_t>(names_end - NamesBegin);
+        // Records and counters are multiples of 8 bytes, only the names need padding.
+        uint64_t const PaddingBytesBeforeCounters = 0;
+        uint64_t const PaddingBytesAfterCounters = 0;
+
+        Raw_Header header;
+#define INSTR_PROF_RAW_HEADER(Type, Name, Initializer) header.Name = Initializer;
+#include <llvm/ProfileData/InstrProfData.inc>
+
+        if(fwrite(&header, sizeof(header), 1, file) != 1) {
+            return false;
+        }
+
+        // Pointers to value profiling state are meaningless outside of the process.
+        for(Profile_Data const* data = DataBegin; data != data_end; ++data) {
+            unsigned char record[sizeof(Profile_Data)];
+            memcpy(record, data, sizeof(Profile_Data));
+            memset(record + offsetof(Profile_Data, Values), 0, sizeof(IntPtrT));
+            if(fwrite(record, sizeof(record), 1, file) != 1) {
+                return false;
+            }
+        }
+
+        if(fwrite(CountersBegin, sizeof(uint64_t), CountersSize, file) != CountersSize || fwrite(NamesBegin, 1, NamesSize, file) != NamesSize ||
+           !write_padding(file, get_padding(NamesSize))) {
+            return false;
+        }
+
+        for(Profile_Data const* data = DataBegin; data != data_end; ++data) {
+            if(!write_empty_value_data(file, *data)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void write_profile_at_exit() {
+        char const* path = getenv("LLVM_PROFILE_FILE");
+        if(!path || !*path) {
+            path = INSTR_PROF_PROFILE_NAME_VAR && *INSTR_PROF_PROFILE_NAME_VAR ? INSTR_PROF_PROFILE_NAME_VAR : "default.profraw";
+        }
+
+        FILE* const file = fopen(path, "wb");
+        if(!file) {
+            fprintf(stderr, "profile: could not open '%s' for writing\n", path);
+            return;
+        }
+
+        bool const written = write_profile(file);
+        if(fclose(file) != 0 || !written) {
+            fprintf(stderr, "profile: could not write '%s'\n", path);
+        }
+    }
+
+    // Exit handlers run in the reverse order of their registration. Registering before main runs
+    // writes the profile after all handlers of the program.
+    struct Profile_Writer_Registration {
+        Profile_Writer_Registration() {
+            atexit(write_profile_at_exit);
+        }
+    };
+
+    Profile_Writer_Registration const registration;
+} // namespace
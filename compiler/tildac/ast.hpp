@@ -3,20 +3,30 @@
 #include <tildac/types.hpp>
 #include <tildac/utility.hpp>
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
 namespace tildac {
     enum struct AST_Node_Type {
         identifier,
+        attribute,
+        attribute_list,
         qualified_type,
         template_id,
+        array_type,
+        template_parameter_list,
+        template_argument_list,
         identifier_expression,
         binary_expression,
+        index_expression,
+        assignment_expression,
         argument_list,
         function_call_expression,
         bool_literal,
         integer_literal,
+        float_literal,
+        array_literal,
         declaration_sequence,
         variable_declaration,
         statement_list,
@@ -38,10 +48,16 @@ namespace tildac {
         binary_or,
         binary_and,
         binary_eq,
+        binary_neq,
+        binary_lt,
+        binary_gt,
+        binary_leq,
+        binary_geq,
         binary_add,
         binary_sub,
         binary_mul,
         binary_div,
+        assign,
     };
 
     struct Source_Info {
@@ -51,18 +67,58 @@ namespace tildac {
         i64 column;
     };
 
+    struct AST_Node;
+
+    // Attribute the nodes and the strings that they own to the memory report.
+    void count_ast_node(AST_Node const& node);
+    void count_ast_string(std::string const& string);
+
     struct AST_Node {
         Source_Info source_info;
         AST_Node_Type node_type;
 
-        AST_Node(Source_Info source_info, AST_Node_Type type): source_info(source_info), node_type(type) {}
+        AST_Node(Source_Info source_info, AST_Node_Type type): source_info(source_info), node_type(type) {
+            count_ast_node(*this);
+        }
         virtual ~AST_Node() = default;
+
+        // Nodes are allocated by a counting allocator, which measures the trees for -fmem-report.
+        static void* operator new(std::size_t size);
+        static void operator delete(void* pointer, std::size_t size);
     };
 
     struct Identifier: public AST_Node {
         std::string name;
 
-        Identifier(std::string string): AST_Node({}, AST_Node_Type::identifier), name(std::move(string)) {}
+        Identifier(std::string string): AST_Node({}, AST_Node_Type::identifier), name(std::move(string)) {
+            count_ast_string(this->name);
+        }
+    };
+
+    struct Attribute_Argument {
+        // Empty for positional arguments, e.g. `4` in `#[unroll(4)]`.
+        std::string key;
+        std::string value;
+    };
+
+    // `#[vectorize(width=8)]`
+    struct Attribute: public AST_Node {
+        std::string name;
+        std::vector<Attribute_Argument> arguments;
+
+        Attribute(std::string name): AST_Node({}, AST_Node_Type::attribute), name(std::move(name)) {
+            count_ast_string(this->name);
+        }
+    };
+
+    struct Attribute_List: public AST_Node {
+        std::vector<Owning_Ptr<Attribute>> attributes;
+
+        Attribute_List(): AST_Node({}, AST_Node_Type::attribute_list) {}
+
+        void append(Attribute* attribute) {
+            attributes.emplace_back(attribute);
+        }
     };
 
     struct Type: public AST_Node {
@@ -72,7 +128,9 @@ namespace tildac {
     struct Qualified_Type: public Type {
         std::string name;
 
-        Qualified_Type(std::string name): Type({}, AST_Node_Type::qualified_type), name(std::move(name)) {}
+        Qualified_Type(std::string name): Type({}, AST_Node_Type::qualified_type), name(std::move(name)) {
+            count_ast_string(this->name);
+        }
     };
 
     struct Template_ID: public Type {
@@ -86,14 +144,57 @@ namespace tildac {
         }
     };
 
+    // `T[4]` is an array of 4 elements of type T, `T[]` a slice, which refers to the elements of an array
+    // and knows their number. `T[4][2]` is an array of 2 arrays of 4 elements.
+    struct Array_Type: public Type {
+        Owning_Ptr<Type> element_type;
+        // -1 for slices.
+        i64 size;
+
+        Array_Type(Type* element_type, i64 size): Type({}, AST_Node_Type::array_type), element_type(element_type), size(size) {}
+    };
+
+    // template<typename T, typename U>
+    struct Template_Parameter_List: public AST_Node {
+        std::vector<Owning_Ptr<Identifier>> parameters;
+
+        Template_Parameter_List(): AST_Node({}, AST_Node_Type::template_parameter_list) {}
+
+        void append(Identifier* parameter) {
+            parameters.emplace_back(parameter);
+        }
+
+        [[nodiscard]] i64 size() const {
+            return parameters.size();
+        }
+    };
+
+    // The `<u64, V<i64>>` in `v<u64, V<i64>>` or `f<u64, V<i64>>(...)`.
+    struct Template_Argument_List: public AST_Node {
+        std::vector<Owning_Ptr<Type>> arguments;
+
+        Template_Argument_List(): AST_Node({}, AST_Node_Type::template_argument_list) {}
+
+        void append(Type* argument) {
+            arguments.emplace_back(argument);
+        }
+
+        [[nodiscard]] i64 size() const {
+            return arguments.size();
+        }
+    };
+
     struct Expression: public AST_Node {
         using AST_Node::AST_Node;
     };
 
+    // template_arguments is optional.
     struct Identifier_Expression: public Expression {
         Owning_Ptr<Identifier> identifier;
+        Owning_Ptr<Template_Argument_List> template_arguments;
 
-        Identifier_Expression(Identifier* identifier): Expression({}, AST_Node_Type::identifier_expression), identifier(identifier) {}
+        Identifier_Expression(Identifier* identifier, Template_Argument_List* template_arguments, Source_Info const& source_info)
+            : Expression(source_info, AST_Node_Type::identifier_expression), identifier(identifier), template_arguments(template_arguments) {}
     };
 
     struct Binary_Expression: public Expression {
@@ -101,7 +202,32 @@ namespace tildac {
         Operator op;
         Owning_Ptr<Expression> rhs;
 
-        Binary_Expression(Expression* lhs, Operator op, Expression* rhs): Expression({}, AST_Node_Type::binary_expression), lhs(lhs), op(op), rhs(rhs) {}
+        // source_info is the location of the operator.
+        Binary_Expression(Expression* lhs, Operator op, Expression* rhs, Source_Info const& source_info)
+            : Expression(source_info, AST_Node_Type::binary_expression), lhs(lhs), op(op), rhs(rhs) {}
+    };
+
+    // `a[i]`
+    struct Index_Expression: public Expression {
+        Owning_Ptr<Expression> base;
+        Owning_Ptr<Expression> index;
+
+        // source_info is the location of the `[`.
+        Index_Expression(Expression* base, Expression* index, Source_Info const& source_info)
+            : Expression(source_info, AST_Node_Type::index_expression), base(base), index(index) {}
+    };
+
+    // `x = value` or a compound assignment such as `x += value`, in which case
+    // op is the arithmetic operator that is applied before the assignment.
+    struct Assignment_Expression: public Expression {
+        Owning_Ptr<Identifier> identifier;
+        Operator op;
+        Owning_Ptr<Expression> value;
+        // The element of the array x that is assigned, e.g. `x[i][j]` in `x[i][j] = value`. nullptr if x itself is assigned.
+        Owning_Ptr<Index_Expression> element;
+
+        Assignment_Expression(Identifier* identifier, Operator op, Expression* value, Source_Info const& source_info)
+            : Expression(source_info, AST_Node_Type::assignment_expression), identifier(identifier), op(op), value(value) {}
     };
 
     struct Argument_List: public AST_Node {
@@ -114,24 +240,48 @@ namespace tildac {
         std::vector<Owning_Ptr<Expression>> arguments;
     };
 
+    // template_arguments is optional.
     struct Function_Call_Expression: public Expression {
         Owning_Ptr<Identifier> identifier;
+        Owning_Ptr<Template_Argument_List> template_arguments;
         Owning_Ptr<Argument_List> arg_list;
 
-        Function_Call_Expression(Identifier* identifier, Argument_List* arg_list)
-            : Expression({}, AST_Node_Type::function_call_expression), identifier(identifier), arg_list(arg_list) {}
+        Function_Call_Expression(Identifier* identifier, Template_Argument_List* template_arguments, Argument_List* arg_list, Source_Info const& source_info)
+            : Expression(source_info, AST_Node_Type::function_call_expression), identifier(identifier), template_arguments(template_arguments), arg_list(arg_list) {}
     };
 
     struct Bool_Literal: public Expression {
         bool value;
 
-        Bool_Literal(bool value): Expression({}, AST_Node_Type::bool_literal), value(value) {}
+        Bool_Literal(bool value, Source_Info const& source_info): Expression(source_info, AST_Node_Type::bool_literal), value(value) {}
     };
 
     struct Integer_Literal: public Expression {
         std::string value;
 
-        Integer_Literal(std::string value): Expression({}, AST_Node_Type::integer_literal), value(value) {}
+        Integer_Literal(std::string value, Source_Info const& source_info): Expression(source_info, AST_Node_Type::integer_literal), value(value) {
+            count_ast_string(this->value);
+        }
+    };
+
+    // `1.5`, `0.25e-3`. value is the literal as written.
+    struct Float_Literal: public Expression {
+        std::string value;
+
+        Float_Literal(std::string value, Source_Info const& source_info): Expression(source_info, AST_Node_Type::float_literal), value(value) {
+            count_ast_string(this->value);
+        }
+    };
+
+    // `[1, 2, 3]`
+    struct Array_Literal: public Expression {
+        std::vector<Owning_Ptr<Expression>> elements;
+
+        Array_Literal(Source_Info const& source_info): Expression(source_info, AST_Node_Type::array_literal) {}
+
+        void append(Expression* element) {
+            elements.emplace_back(element);
+        }
     };
 
     struct Declaration: public AST_Node {
@@ -152,13 +302,16 @@ namespace tildac {
         }
     };
 
+    // template_parameters is non-null only for templated global variables.
     struct Variable_Declaration: public Declaration {
+        Owning_Ptr<Template_Parameter_List> template_parameters = nullptr;
         Owning_Ptr<Type> type = nullptr;
         Owning_Ptr<Identifier> identifier = nullptr;
         Owning_Ptr<Expression> initializer = nullptr;
+        bool is_mutable = false;
 
-        Variable_Declaration(Type* type, Identifier* identifier, Expression* initializer)
-            : Declaration({}, AST_Node_Type::variable_declaration), type(type), identifier(identifier), initializer(initializer) {}
+        Variable_Declaration(Type* type, Identifier* identifier, Expression* initializer, bool is_mutable, Source_Info const& source_info)
+            : Declaration(source_info, AST_Node_Type::variable_declaration), type(type), identifier(identifier), initializer(initializer), is_mutable(is_mutable) {}
     };
 
     struct Statement;
@@ -184,7 +337,7 @@ namespace tildac {
     struct Block_Statement: public Statement {
         Owning_Ptr<Statement_List> statements;
 
-        Block_Statement(Statement_List* statements): Statement({}, AST_Node_Type::block_statement), statements(statements) {}
+        Block_Statement(Statement_List* statements, Source_Info const& source_info): Statement(source_info, AST_Node_Type::block_statement), statements(statements) {}
     };
 
     struct If_Statement: public Statement {
@@ -193,59 +346,69 @@ namespace tildac {
         Owning_Ptr<Block_Statement> else_block;
         Owning_Ptr<If_Statement> else_if;
 
-        If_Statement(Expression* condition, Block_Statement* block, Block_Statement* else_block, If_Statement* else_if)
-            : Statement({}, AST_Node_Type::if_statement), condition(condition), block(block), else_block(else_block), else_if(else_if) {}
+        If_Statement(Expression* condition, Block_Statement* block, Block_Statement* else_block, If_Statement* else_if, Source_Info const& source_info)
+            : Statement(source_info, AST_Node_Type::if_statement), condition(condition), block(block), else_block(else_block), else_if(else_if) {}
     };
 
-    // condition and post_expr are optional.
+    // init, condition, post_expr and attributes are optional.
+    // init is either a Declaration_Statement or an Expression_Statement.
     struct For_Statement: public Statement {
-        // TODO: Add inits
+        Owning_Ptr<Statement> init;
         Owning_Ptr<Expression> condition;
         Owning_Ptr<Expression> post_expr;
         Owning_Ptr<Statement_List> statements;
+        Owning_Ptr<Attribute_List> attributes;
 
-        For_Statement(Expression* condition, Expression* post_expr, Statement_List* statements, Source_Info const& source_info)
-            : Statement(source_info, AST_Node_Type::for_statement), condition(condition), post_expr(post_expr), statements(statements) {}
+        For_Statement(Statement* init, Expression* condition, Expression* post_expr, Statement_List* statements, Source_Info const& source_info)
+            : Statement(source_info, AST_Node_Type::for_statement), init(init), condition(condition), post_expr(post_expr), statements(statements) {}
     };
 
+    // attributes is optional.
     struct While_Statement: public Statement {
         Owning_Ptr<Expression> condition;
         Owning_Ptr<Block_Statement> block;
+        Owning_Ptr<Attribute_List> attributes;
 
-        While_Statement(Expression* condition, Block_Statement* block): Statement({}, AST_Node_Type::while_statement), condition(condition), block(block) {}
+        While_Statement(Expression* condition, Block_Statement* block, Source_Info const& source_info)
+            : Statement(source_info, AST_Node_Type::while_statement), condition(condition), block(block) {}
     };
 
+    // attributes is optional.
     struct Do_While_Statement: public Statement {
         Owning_Ptr<Expression> condition;
         Owning_Ptr<Block_Statement> block;
+        Owning_Ptr<Attribute_List> attributes;
 
-        Do_While_Statement(Expression* condition, Block_Statement* block)
-            : Statement({}, AST_Node_Type::do_while_statement), condition(condition), block(block) {}
+        Do_While_Statement(Expression* condition, Block_Statement* block, Source_Info const& source_info)
+            : Statement(source_info, AST_Node_Type::do_while_statement), condition(condition), block(block) {}
     };
 
     struct Return_Statement: public Statement {
         Owning_Ptr<Expression> expression;
 
-        Return_Statement(Expression* expression): Statement({}, AST_Node_Type::return_statement), expression(expression) {}
+        Return_Statement(Expression* expression, Source_Info const& source_info): Statement(source_info, AST_Node_Type::return_statement), expression(expression) {}
     };
 
     struct Declaration_Statement: public Statement {
         Owning_Ptr<Variable_Declaration> var_decl;
 
-        Declaration_Statement(Variable_Declaration* var_decl): Statement({}, AST_Node_Type::declaration_statement), var_decl(var_decl) {}
+        Declaration_Statement(Variable_Declaration* var_decl, Source_Info const& source_info)
+            : Statement(source_info, AST_Node_Type::declaration_statement), var_decl(var_decl) {}
     };
 
     struct Expression_Statement: public Statement {
         Owning_Ptr<Expression> expr;
 
-        Expression_Statement(Expression* expression): Statement({}, AST_Node_Type::expression_statement), expr(expression) {}
+        Expression_Statement(Expression* expression, Source_Info const& source_info)
+            : Statement(source_info, AST_Node_Type::expression_statement), expr(expression) {}
     };
 
     struct Function_Parameter: public AST_Node {
         Owning_Ptr<Identifier> identifier;
         Owning_Ptr<Type> type;
 
-        Function_Parameter(Identifier* identifier, Type* type): AST_Node({}, AST_Node_Type::declaration_statement), identifier(identifier), type(type) {}
+        Function_Parameter(Identifier* identifier, Type* type, Source_Info const& source_info)
+            : AST_Node(source_info, AST_Node_Type::declaration_statement), identifier(identifier), type(type) {}
     };
 
     struct Function_Parameter_List: public AST_Node {
@@ -268,13 +431,19 @@ namespace tildac {
         Function_Body(Statement_List* statement_list): AST_Node({}, AST_Node_Type::function_body), statements(statement_list) {}
     };
 
+    // template_parameters is non-null only for templated functions.
     struct Function_Declaration: public Declaration {
+        Owning_Ptr<Template_Parameter_List> template_parameters;
         Owning_Ptr<Identifier> name;
         Owning_Ptr<Function_Parameter_List> parameter_list;
         Owning_Ptr<Type> return_type;
+        // nullptr if the function is only declared.
         Owning_Ptr<Function_Body> body;
+        // `#[xray_always]` or `#[xray_never]`. nullptr if the function has no attributes.
+        Owning_Ptr<Attribute_List> attributes;
 
-        Function_Declaration(Identifier* name, Function_Parameter_List* function_parameter_list, Type* return_type, Function_Body* body)
-            : Declaration({}, AST_Node_Type::function_declaration), name(name), parameter_list(function_parameter_list), return_type(return_type), body(body) {}
+        Function_Declaration(Identifier* name, Function_Parameter_List* function_parameter_list, Type* return_type, Function_Body* body,
+                             Source_Info const& source_info)
+            : Declaration(source_info, AST_Node_Type::function_declaration), name(name), parameter_list(function_parameter_list), return_type(return_type), body(body) {}
     };
 } // namespace tildac
@@ -24,6 +24,28 @@ namespace tildac {
                 return;
             }
 
+            case AST_Node_Type::attribute: {
+                auto const& node = static_cast<Attribute const&>(ast_node);
+                std::cout << Indent{indent_level} << "Attribute: '" << node.name << "'\n";
+                for(auto& argument: node.arguments) {
+                    std::cout << Indent{indent_level + 1} << "Argument: ";
+                    if(argument.key.size() != 0) {
+                        std::cout << "'" << argument.key << "' = ";
+                    }
+                    std::cout << "'" << argument.value << "'\n";
+                }
+                return;
+            }
+
+            case AST_Node_Type::attribute_list: {
+                auto const& node = static_cast<Attribute_List const&>(ast_node);
+                std::cout << Indent{indent_level} << "Attribute_List:\n";
+                for(auto& attribute: node.attributes) {
+                    print_ast(*attribute, indent_level + 1);
+                }
+                return;
+            }
+
             case AST_Node_Type::qualified_type: {
                 auto const& node = static_cast<Qualified_Type const&>(ast_node);
                 std::cout << Indent{indent_level} << "Qualified_Type: '" << node.name << "'\n";
@@ -42,10 +64,43 @@ namespace tildac {
                 return;
             }
 
+            case AST_Node_Type::array_type: {
+                auto const& node = static_cast<Array_Type const&>(ast_node);
+                std::cout << Indent{indent_level} << "Array_Type:\n";
+                print_ast(*node.element_type, indent_level + 1);
+                if(node.size >= 0) {
+                    std::cout << Indent{indent_level + 1} << "Size: " << node.size << "\n";
+                } else {
+                    std::cout << Indent{indent_level + 1} << "Size: slice\n";
+                }
+                return;
+            }
+
+            case AST_Node_Type::template_parameter_list: {
+                auto const& node = static_cast<Template_Parameter_List const&>(ast_node);
+                std::cout << Indent{indent_level} << "Template_Parameter_List:\n";
+                for(auto& parameter: node.parameters) {
+                    print_ast(*parameter, indent_level + 1);
+                }
+                return;
+            }
+
+            case AST_Node_Type::template_argument_list: {
+                auto const& node = static_cast<Template_Argument_List const&>(ast_node);
+                std::cout << Indent{indent_level} << "Template_Argument_List:\n";
+                for(auto& argument: node.arguments) {
+                    print_ast(*argument, indent_level + 1);
+                }
+                return;
+            }
+
             case AST_Node_Type::identifier_expression: {
                 auto const& node = static_cast<Identifier_Expression const&>(ast_node);
                 std::cout << Indent{indent_level} << "Identifier_Expression:\n";
                 print_ast(*node.identifier, indent_level + 1);
+                if(node.template_arguments) {
+                    print_ast(*node.template_arguments, indent_level + 1);
+                }
                 return;
             }
 
@@ -66,6 +121,26 @@ namespace tildac {
                         std::cout << Indent{indent_level + 1} << "Operator: '=='\n";
                     } break;
 
+                    case Operator::binary_neq: {
+                        std::cout << Indent{indent_level + 1} << "Operator: '!='\n";
+                    } break;
+
+                    case Operator::binary_lt: {
+                        std::cout << Indent{indent_level + 1} << "Operator: '<'\n";
+                    } break;
+
+                    case Operator::binary_gt: {
+                        std::cout << Indent{indent_level + 1} << "Operator: '>'\n";
+                    } break;
+
+                    case Operator::binary_leq: {
+                        std::cout << Indent{indent_level + 1} << "Operator: '<='\n";
+                    } break;
+
+                    case Operator::binary_geq: {
+                        std::cout << Indent{indent_level + 1} << "Operator: '>='\n";
+                    } break;
+
                     case Operator::binary_add: {
                         std::cout << Indent{indent_level + 1} << "Operator: '+'\n";
                     } break;
@@ -81,11 +156,56 @@ namespace tildac {
                     case Operator::binary_div: {
                         std::cout << Indent{indent_level + 1} << "Operator: '/'\n";
                     } break;
+
+                    case Operator::assign: {
+                        std::cout << Indent{indent_level + 1} << "Operator: '='\n";
+                    } break;
                 }
                 print_ast(*node.rhs, indent_level + 1);
                 return;
             }
 
+            case AST_Node_Type::index_expression: {
+                auto const& node = static_cast<Index_Expression const&>(ast_node);
+                std::cout << Indent{indent_level} << "Index_Expression:\n";
+                print_ast(*node.base, indent_level + 1);
+                print_ast(*node.index, indent_level + 1);
+                return;
+            }
+
+            case AST_Node_Type::assignment_expression: {
+                auto const& node = static_cast<Assignment_Expression const&>(ast_node);
+                std::cout << Indent{indent_level} << "Assignment_Expression:\n";
+                if(node.element) {
+                    print_ast(*node.element, indent_level + 1);
+                } else {
+                    print_ast(*node.identifier, indent_level + 1);
+                }
+                switch(node.op) {
+                    case Operator::binary_add: {
+                        std::cout << Indent{indent_level + 1} << "Operator: '+='\n";
+                    } break;
+
+                    case Operator::binary_sub: {
+                        std::cout << Indent{indent_level + 1} << "Operator: '-='\n";
+                    } break;
+
+                    case Operator::binary_mul: {
+                        std::cout << Indent{indent_level + 1} << "Operator: '*='\n";
+                    } break;
+
+                    case Operator::binary_div: {
+                        std::cout << Indent{indent_level + 1} << "Operator: '/='\n";
+                    } break;
+
+                    default: {
+                        std::cout << Indent{indent_level + 1} << "Operator: '='\n";
+                    } break;
+                }
+                print_ast(*node.value, indent_level + 1);
+                return;
+            }
+
             case AST_Node_Type::statement_list: {
                 auto const& node = static_cast<Statement_List const&>(ast_node);
                 for(auto& statement: node.statements) {
@@ -107,6 +227,9 @@ namespace tildac {
                 auto const& node = static_cast<Function_Call_Expression const&>(ast_node);
                 std::cout << Indent{indent_level} << "Function_Call_Expression:\n";
                 print_ast(*node.identifier, indent_level + 1);
+                if(node.template_arguments) {
+                    print_ast(*node.template_arguments, indent_level + 1);
+                }
                 print_ast(*node.arg_list, indent_level + 1);
                 return;
             }
@@ -125,6 +248,22 @@ namespace tildac {
                 return;
             }
 
+            case AST_Node_Type::float_literal: {
+                auto const& node = static_cast<Float_Literal const&>(ast_node);
+                std::cout << Indent{indent_level} << "Float_Literal:\n";
+                std::cout << Indent{indent_level + 1} << "Value: " << node.value << "\n";
+                return;
+            }
+
+            case AST_Node_Type::array_literal: {
+                auto const& node = static_cast<Array_Literal const&>(ast_node);
+                std::cout << Indent{indent_level} << "Array_Literal:\n";
+                for(const auto& element: node.elements) {
+                    print_ast(*element, indent_level + 1);
+                }
+                return;
+            }
+
             case AST_Node_Type::declaration_sequence: {
                 auto const& node = static_cast<Declaration_Sequence const&>(ast_node);
                 std::cout << Indent{indent_level} << "Declaration_Sequence:\n";
@@ -137,6 +276,10 @@ namespace tildac {
             case AST_Node_Type::variable_declaration: {
                 auto const& node = static_cast<Variable_Declaration const&>(ast_node);
                 std::cout << Indent{indent_level} << "Variable_Declaration:\n";
+                std::cout << Indent{indent_level + 1} << "Mutable: " << std::boolalpha << node.is_mutable << std::noboolalpha << "\n";
+                if(node.template_parameters) {
+                    print_ast(*node.template_parameters, indent_level + 1);
+                }
                 print_ast(*node.identifier, indent_level + 1);
                 print_ast(*node.type, indent_level + 1);
                 if(node.initializer) {
@@ -166,9 +309,31 @@ namespace tildac {
                 return;
             }
 
+            case AST_Node_Type::for_statement: {
+                auto const& node = static_cast<For_Statement const&>(ast_node);
+                std::cout << Indent{indent_level} << "For_Statement:\n";
+                if(node.attributes) {
+                    print_ast(*node.attributes, indent_level + 1);
+                }
+                if(node.init) {
+                    print_ast(*node.init, indent_level + 1);
+                }
+                if(node.condition) {
+                    print_ast(*node.condition, indent_level + 1);
+                }
+                if(node.post_expr) {
+                    print_ast(*node.post_expr, indent_level + 1);
+                }
+                print_ast(*node.statements, indent_level + 1);
+                return;
+            }
+
             case AST_Node_Type::while_statement: {
                 auto const& node = static_cast<While_Statement const&>(ast_node);
                 std::cout << Indent{indent_level} << "While_Statement:\n";
+                if(node.attributes) {
+                    print_ast(*node.attributes, indent_level + 1);
+                }
                 print_ast(*node.block, indent_level + 1);
                 print_ast(*node.condition, indent_level + 1);
                 return;
@@ -177,6 +342,9 @@ namespace tildac {
             case AST_Node_Type::do_while_statement: {
                 auto const& node = static_cast<Do_While_Statement const&>(ast_node);
                 std::cout << Indent{indent_level} << "Do_While_Statement:\n";
+                if(node.attributes) {
+                    print_ast(*node.attributes, indent_level + 1);
+                }
                 print_ast(*node.block, indent_level + 1);
                 print_ast(*node.condition, indent_level + 1);
                 return;
@@ -230,12 +398,20 @@ namespace tildac {
             case AST_Node_Type::function_declaration: {
                 auto const& node = static_cast<Function_Declaration const&>(ast_node);
                 std::cout << Indent{indent_level} << "Function_Declaration:\n";
+                if(node.template_parameters) {
+                    print_ast(*node.template_parameters, indent_level + 1);
+                }
                 std::cout << Indent{indent_level + 1} << "Function Name:\n";
                 print_ast(*node.name, indent_level + 2);
                 std::cout << Indent{indent_level + 1} << "Return Type:\n";
                 print_ast(*node.return_type, indent_level + 2);
                 print_ast(*node.parameter_list, indent_level + 1);
-                print_ast(*node.body, indent_level + 1);
+                if(node.body) {
+                    print_ast(*node.body, indent_level + 1);
+                }
+                if(node.attributes) {
+                    print_ast(*node.attributes, indent_level + 1);
+                }
                 return;
             }
         }
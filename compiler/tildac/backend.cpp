@@ -0,0 +1,132 @@
+#include <tildac/backend.hpp>
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/Triple.h>
+#include <llvm/MC/MCSubtargetInfo.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/TargetRegistry.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Target/TargetOptions.h>
+
+namespace tildac {
+    Backend_Session::Backend_Session(): _host_triple(llvm::sys::getDefaultTargetTriple()) {
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmPrinter();
+        llvm::InitializeNativeTargetAsmParser();
+    }
+
+    Backend_Session& Backend_Session::get() {
+        static Backend_Session session;
+        return session;
+    }
+
+    // The host target is always initialized. The remaining backends are linked in only when
+    // the compiler is built with CRUST_ALL_TARGETS.
+    bool Backend_Session::initialize_target(const std::string& triple) {
+        if(llvm::Triple(triple).getArch() == llvm::Triple(_host_triple).getArch()) {
+            return true;
+        }
+
+#ifdef TILDAC_NATIVE_TARGET_ONLY
+        return false;
+#else
+        std::call_once(_all_targets_initialized, []() {
+            llvm::InitializeAllTargetInfos();
+            llvm::InitializeAllTargets();
+            llvm::InitializeAllTargetMCs();
+            llvm::InitializeAllAsmParsers();
+            llvm::InitializeAllAsmPrinters();
+        });
+        return true;
+#endif
+    }
+
+    // Resolves `native` to the name and the features of the host cpu. Explicitly requested
+    // features come last so that they override the detected ones.
+    static void resolve_native_cpu(std::string& cpu, std::string& features) {
+        if(cpu != "native") {
+            return;
+        }
+
+        cpu = llvm::sys::getHostCPUName().str();
+        llvm::StringMap<bool> host_features;
+        if(!llvm::sys::getHostCPUFeatures(host_features)) {
+            // The cpu name alone implies the features.
+            return;
+        }
+
+        std::string resolved;
+        for(const auto& feature: host_features) {
+            if(resolved.size() != 0) {
+                resolved += ',';
+            }
+            resolved += feature.getValue() ? '+' : '-';
+            resolved += feature.getKey().str();
+        }
+
+        if(features.size() != 0) {
+            resolved += ',' + features;
+        }
+        features = std::move(resolved);
+    }
+
+    anton::Expected<std::unique_ptr<llvm::TargetMachine>, std::string> Backend_Session::create_target_machine(const Target_Description& description) {
+        std::string const& triple = description.triple.size() != 0 ? description.triple : _host_triple;
+        if(!initialize_target(triple)) {
+            return {anton::expected_error, "the backend for '" + triple + "' is not linked into this compiler"};
+        }
+
+        std::string cpu = description.cpu;
+        std::string features = description.features;
+        if(cpu == "native" && llvm::Triple(triple).getArch() != llvm::Triple(_host_triple).getArch()) {
+            return {anton::expected_error, "'-march=native' requires the host triple"};
+        }
+        resolve_native_cpu(cpu, features);
+
+        std::string error;
+        const llvm::Target* target = llvm::TargetRegistry::lookupTarget(triple, error);
+        if(!target) {
+            return {anton::expected_error, std::move(error)};
+        }
+
+        // Checked up front, LLVM would only warn and fall back to the generic cpu.
+        std::unique_ptr<llvm::MCSubtargetInfo> subtarget_info{target->createMCSubtargetInfo(triple, "", "")};
+        if(cpu != "generic" && !subtarget_info->isCPUStringValid(cpu)) {
+            return {anton::expected_error, "unknown cpu '" + cpu + "' for '" + triple + "'"};
+        }
+
+        llvm::TargetOptions target_options;
+        std::unique_ptr<llvm::TargetMachine> target_machine{
+            target->createTargetMachine(triple, cpu, features, target_options, llvm::Reloc::Model::PIC_, llvm::None, description.optimization)};
+        if(!target_machine) {
+            return {anton::expected_error, "could not create a target machine for '" + triple + "'"};
+        }
+
+        if(description.global_isel) {
+            target_machine->setGlobalISel(true);
+            // Functions that GlobalISel cannot select fall back to SelectionDAG instead of failing.
+            target_machine->setGlobalISelAbort(llvm::GlobalISelAbortMode::Disable);
+        } else if(description.optimization == llvm::CodeGenOpt::None) {
+            target_machine->setFastISel(true);
+        }
+
+        return {anton::expected_value, std::move(target_machine)};
+    }
+
+    anton::Expected<llvm::TargetMachine*, std::string> Backend_Session::get_target_machine(const Target_Description& description) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        Key key{description.triple, description.cpu, description.features, description.optimization, description.global_isel};
+        if(auto iter = _target_machines.find(key); iter != _target_machines.end()) {
+            return {anton::expected_value, iter->second.get()};
+        }
+
+        anton::Expected<std::unique_ptr<llvm::TargetMachine>, std::string> result = create_target_machine(description);
+        if(!result) {
+            return {anton::expected_error, std::move(result.error())};
+        }
+
+        llvm::TargetMachine* target_machine = result.value().get();
+        _target_machines.emplace(std::move(key), std::move(result.value()));
+        return {anton::expected_value, target_machine};
+    }
+} // namespace tildac
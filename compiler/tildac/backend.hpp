@@ -0,0 +1,53 @@
+#pragma once
+
+#include <anton/expected.hpp>
+#include <tildac/types.hpp>
+
+#include <llvm/Support/CodeGen.h>
+#include <llvm/Target/TargetMachine.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+
+namespace tildac {
+    struct Target_Description {
+        std::string triple;
+        // `native` selects the cpu of the host and all of its features.
+        std::string cpu = "generic";
+        // Comma separated list of features, e.g. `+avx2,-sse4a`. Applied on top of the features of the cpu.
+        std::string features;
+        llvm::CodeGenOpt::Level optimization = llvm::CodeGenOpt::Default;
+        // Use GlobalISel instead of SelectionDAG or, at CodeGenOpt::None, FastISel.
+        bool global_isel = false;
+    };
+
+    // Process-wide state of the LLVM backends. Targets are initialized once, the host target
+    // eagerly and all others only when they are first requested, and target machines are cached
+    // per target description so that compiling many files does not rebuild them every time.
+    class Backend_Session {
+    public:
+        [[nodiscard]] static Backend_Session& get();
+
+        // Returns the cached target machine for the description, creating it on first use.
+        // The machine is shared and must only be used by one thread at a time.
+        [[nodiscard]] anton::Expected<llvm::TargetMachine*, std::string> get_target_machine(const Target_Description& description);
+
+        // Creates a target machine owned by the caller, e.g. for use on a code generation thread.
+        [[nodiscard]] anton::Expected<std::unique_ptr<llvm::TargetMachine>, std::string> create_target_machine(const Target_Description& description);
+
+    private:
+        using Key = std::tuple<std::string, std::string, std::string, llvm::CodeGenOpt::Level, bool>;
+
+        std::mutex _mutex;
+        std::once_flag _all_targets_initialized;
+        std::map<Key, std::unique_ptr<llvm::TargetMachine>> _target_machines;
+        std::string _host_triple;
+
+        Backend_Session();
+
+        bool initialize_target(const std::string& triple);
+    };
+} // namespace tildac
@@ -0,0 +1,963 @@
+#include <tildac/bytecode.hpp>
+
+#include <algorithm>
+#include <string_view>
+#include <unordered_map>
+
+namespace tildac {
+    // Width in bits of a value. 0 for void, 1 for bool. Pointers are opaque 64 bit values.
+    using Width = i64;
+
+    // Unsigned integers, characters and bool are held zero-extended, all other values sign-extended.
+    struct Value_Type {
+        Width width;
+        bool is_unsigned;
+    };
+
+    struct Operand {
+        i32 index;
+        Width width;
+        bool is_unsigned = false;
+    };
+
+    struct Local {
+        std::string name;
+        i32 index;
+        Value_Type type;
+        bool is_mutable;
+    };
+
+    struct Function_Signature {
+        i64 index;
+        std::vector<Value_Type> parameters;
+        Value_Type return_type;
+    };
+
+    struct Global {
+        i64 index;
+        Value_Type type;
+    };
+
+    struct Bytecode_Context {
+        std::unordered_map<std::string, Function_Signature> functions;
+        std::unordered_map<std::string, Global> globals;
+        Overflow_Policy overflow = Overflow_Policy::wrap;
+        // The function that is currently being lowered.
+        Bytecode_Function* function = nullptr;
+        Value_Type return_type = {0, false};
+        // Innermost last. Parameters come first.
+        std::vector<Local> locals;
+        // Registers above the locals hold temporaries of the statement that is being lowered.
+        i32 next_register = 0;
+        std::string error;
+    };
+
+    static bool fail(Bytecode_Context& context, std::string message) {
+        if(context.error.size() == 0) {
+            context.error = std::move(message);
+        }
+        return false;
+    }
+
+    static bool resolve_type(Bytecode_Context& context, const Type& type, Value_Type& out) {
+        if(type.node_type == AST_Node_Type::array_type) {
+            return fail(context, "arrays are not supported by the bytecode compiler");
+        } else if(type.node_type != AST_Node_Type::qualified_type) {
+            return fail(context, "templates are not supported by the bytecode compiler");
+        }
+
+        struct Builtin_Type {
+            std::string_view name;
+            Value_Type type;
+        };
+
+        static constexpr Builtin_Type builtin_types[] = {
+            {"void", {0, false}}, {"bool", {1, true}}, {"i8", {8, false}},  {"i16", {16, false}}, {"i32", {32, false}},
+            {"i64", {64, false}}, {"u8", {8, true}},   {"u16", {16, true}}, {"u32", {32, true}},  {"u64", {64, true}},
+            {"c8", {8, true}},    {"c16", {16, true}}, {"c32", {32, true}},
+        };
+
+        const std::string& name = static_cast<const Qualified_Type&>(type).name;
+        for(const Builtin_Type& builtin: builtin_types) {
+            if(builtin.name == name) {
+                out = builtin.type;
+                return true;
+            }
+        }
+
+        if(name.size() != 0 && name.back() == '*') {
+            out = Value_Type{64, false};
+            return true;
+        }
+        return fail(context, "values of type \"" + name + "\" are not supported by the bytecode compiler");
+    }
+
+    static i64 emit(Bytecode_Context& context, Opcode const opcode, i32 const a = 0, i32 const b = 0, i32 const c = 0) {
+        context.function->code.push_back(Instruction{opcode, a, b, c});
+        return static_cast<i64>(context.function->code.size()) - 1;
+    }
+
+    static i32 allocate_register(Bytecode_Context& context) {
+        i32 const index = context.next_register++;
+        context.function->register_count = max<i64>(context.function->register_count, context.next_register);
+        return index;
+    }
+
+    // Uses the destination if there is one, otherwise a new temporary.
+    static i32 select_register(Bytecode_Context& context, i32 const destination) {
+        return destination >= 0 ? destination : allocate_register(context);
+    }
+
+    // Whether the register of the value already holds it as a value of the type. Widening is free unless
+    // a signed value becomes unsigned, and so are all conversions to 64 bit types.
+    static bool is_held_as(Operand const value, Value_Type const type) {
+        if(type.width == 64) {
+            return true;
+        } else if(value.is_unsigned) {
+            return value.width < type.width || (type.is_unsigned && value.width == type.width);
+        } else {
+            return !type.is_unsigned && value.width <= type.width;
+        }
+    }
+
+    // Converts the value in src to the type and writes it to dst.
+    static void emit_conversion(Bytecode_Context& context, i32 const dst, Operand const src, Value_Type const type) {
+        if(type.width == 1 && src.width > 1) {
+            emit(context, Opcode::truncate_to_bool, dst, src.index);
+        } else if(!is_held_as(src, type)) {
+            emit(context, type.is_unsigned ? Opcode::zero_extend : Opcode::sign_extend, dst, src.index, static_cast<i32>(64 - type.width));
+        } else if(dst != src.index) {
+            emit(context, Opcode::move, dst, src.index);
+        }
+    }
+
+    static void patch_jumps(Bytecode_Context& context, const std::vector<i64>& jumps, i32 const target) {
+        for(i64 const jump: jumps) {
+            Instruction& instruction = context.function->code[jump];
+            switch(instruction.opcode) {
+                case Opcode::jump: {
+                    instruction.a = target;
+                } break;
+
+                case Opcode::jump_if_zero:
+                case Opcode::jump_if_not_zero: {
+                    instruction.b = target;
+                } break;
+
+                default: {
+                    instruction.c = target;
+                } break;
+            }
+        }
+    }
+
+    // Forward jumps are emitted before their targets are known and patched once the code reaches them.
+    static void patch_jumps(Bytecode_Context& context, const std::vector<i64>& jumps) {
+        patch_jumps(context, jumps, static_cast<i32>(context.function->code.size()));
+    }
+
+    static Local* find_local(Bytecode_Context& context, const std::string& name) {
+        for(auto local = context.locals.rbegin(), end = context.locals.rend(); local != end; ++local) {
+            if(local->name == name) {
+                return &*local;
+            }
+        }
+        return nullptr;
+    }
+
+    // An operand that refers to the register of a local variable would observe the assignment.
+    static bool contains_assignment(const Expression& expression) {
+        switch(expression.node_type) {
+            case AST_Node_Type::assignment_expression: {
+                return true;
+            }
+
+            case AST_Node_Type::binary_expression: {
+                auto& binary_expression = static_cast<const Binary_Expression&>(expression);
+                return contains_assignment(*binary_expression.lhs) || contains_assignment(*binary_expression.rhs);
+            }
+
+            case AST_Node_Type::function_call_expression: {
+                const auto& arguments = static_cast<const Function_Call_Expression&>(expression).arg_list->arguments;
+                for(const auto& argument: arguments) {
+                    if(contains_assignment(*argument)) {
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            default:
+                return false;
+        }
+    }
+
+    static bool compile_expression(Bytecode_Context& context, const Expression& expression, Operand& out, i32 destination = -1);
+    static bool compile_branch(Bytecode_Context& context, const Expression& expression, bool jump_if, std::vector<i64>& jumps);
+
+    static bool is_comparison(Operator const op) {
+        return op == Operator::binary_eq || op == Operator::binary_neq || op == Operator::binary_lt || op == Operator::binary_gt ||
+               op == Operator::binary_leq || op == Operator::binary_geq;
+    }
+
+    static bool is_local_register(Bytecode_Context& context, i32 const index) {
+        return std::any_of(context.locals.begin(), context.locals.end(), [index](const Local& local) { return local.index == index; });
+    }
+
+    // Compiles the operands of a binary expression. The lhs is copied if the rhs may assign to it.
+    static bool compile_operands(Bytecode_Context& context, const Expression& lhs_expression, const Expression& rhs_expression, Operand& lhs, Operand& rhs) {
+        if(!compile_expression(context, lhs_expression, lhs)) {
+            return false;
+        }
+
+        if(contains_assignment(rhs_expression) && is_local_register(context, lhs.index)) {
+            i32 const copy = allocate_register(context);
+            emit(context, Opcode::move, copy, lhs.index);
+            lhs.index = copy;
+        }
+        return compile_expression(context, rhs_expression, rhs);
+    }
+
+    // The result of 64 bit arithmetic in dst is truncated to its type. Under the trap policy the truncation
+    // traps if the result does not fit into the type.
+    static void emit_truncation(Bytecode_Context& context, i32 const dst, Value_Type const type, bool const checked) {
+        if(type.width == 64) {
+            return;
+        }
+
+        if(checked) {
+            emit(context, type.is_unsigned ? Opcode::zero_extend_checked : Opcode::sign_extend_checked, dst, dst, static_cast<i32>(64 - type.width));
+        } else {
+            emit_conversion(context, dst, Operand{dst, 64, type.is_unsigned}, type);
+        }
+    }
+
+    // The operands of arithmetic are converted to the type of the wider of the two, the same as in the generated
+    // code. Of two types of the same width the unsigned one wins. Returns that type.
+    static Value_Type unify_operands(Bytecode_Context& context, Operand& lhs, Operand& rhs) {
+        Value_Type type{max(lhs.width, rhs.width), false};
+        if(lhs.width == rhs.width) {
+            type.is_unsigned = lhs.is_unsigned || rhs.is_unsigned;
+        } else {
+            type.is_unsigned = lhs.width > rhs.width ? lhs.is_unsigned : rhs.is_unsigned;
+        }
+
+        for(Operand* const operand: {&lhs, &rhs}) {
+            if(!is_held_as(*operand, type)) {
+                i32 const converted = allocate_register(context);
+                emit_conversion(context, converted, *operand, type);
+                *operand = Operand{converted, type.width, type.is_unsigned};
+            }
+        }
+        return type;
+    }
+
+    // Arithmetic is done in 64 bits and the result, written to dst, is truncated to the type of the operands.
+    static bool compile_arithmetic(Bytecode_Context& context, Operator const op, Operand lhs, Operand rhs, i32 const dst, Operand& out) {
+        Value_Type const type = unify_operands(context, lhs, rhs);
+        bool const trap = context.overflow == Overflow_Policy::trap;
+        Opcode const less = type.is_unsigned ? Opcode::less_unsigned : Opcode::less;
+        Opcode const less_equal = type.is_unsigned ? Opcode::less_equal_unsigned : Opcode::less_equal;
+        out = Operand{dst, 1, true};
+        switch(op) {
+            // Narrower results do not overflow 64 bits and are checked when they are truncated.
+            case Operator::binary_add: {
+                Opcode const checked = type.is_unsigned ? Opcode::add_unsigned_checked : Opcode::add_checked;
+                emit(context, trap && type.width == 64 ? checked : Opcode::add, dst, lhs.index, rhs.index);
+            } break;
+
+            case Operator::binary_sub: {
+                Opcode const checked = type.is_unsigned ? Opcode::sub_unsigned_checked : Opcode::sub_checked;
+                emit(context, trap && type.width == 64 ? checked : Opcode::sub, dst, lhs.index, rhs.index);
+            } break;
+
+            case Operator::binary_mul: {
+                Opcode const checked = type.is_unsigned ? Opcode::mul_unsigned_checked : Opcode::mul_checked;
+                emit(context, trap && type.width == 64 ? checked : Opcode::mul, dst, lhs.index, rhs.index);
+            } break;
+
+            case Operator::binary_div: {
+                // The quotient of unsigned values is never larger than the dividend.
+                out = Operand{dst, type.width, type.is_unsigned};
+                if(type.is_unsigned) {
+                    emit(context, Opcode::div_unsigned, dst, lhs.index, rhs.index);
+                } else {
+                    emit(context, Opcode::div, dst, lhs.index, rhs.index);
+                    emit_truncation(context, dst, type, false);
+                }
+                return true;
+            }
+
+            // Comparisons of values that are extended alike are the same at every width.
+            case Operator::binary_eq: {
+                emit(context, Opcode::equal, dst, lhs.index, rhs.index);
+                return true;
+            }
+
+            case Operator::binary_neq: {
+                emit(context, Opcode::not_equal, dst, lhs.index, rhs.index);
+                return true;
+            }
+
+            case Operator::binary_lt: {
+                emit(context, less, dst, lhs.index, rhs.index);
+                return true;
+            }
+
+            case Operator::binary_gt: {
+                emit(context, less, dst, rhs.index, lhs.index);
+                return true;
+            }
+
+            case Operator::binary_leq: {
+                emit(context, less_equal, dst, lhs.index, rhs.index);
+                return true;
+            }
+
+            case Operator::binary_geq: {
+                emit(context, less_equal, dst, rhs.index, lhs.index);
+                return true;
+            }
+
+            default:
+                return fail(context, "operator is not supported by the bytecode compiler");
+        }
+
+        out = Operand{dst, type.width, type.is_unsigned};
+        emit_truncation(context, dst, type, trap);
+        return true;
+    }
+
+    // `x + 1` and `x - 1` are common enough in loops and recursion to get an instruction of their own.
+    // Checked arithmetic has no immediate form.
+    static bool get_immediate_operand(Bytecode_Context& context, Operator const op, const Expression& rhs, i32& immediate) {
+        if((op != Operator::binary_add && op != Operator::binary_sub) || rhs.node_type != AST_Node_Type::integer_literal ||
+           context.overflow == Overflow_Policy::trap) {
+            return false;
+        }
+
+        u64 const value = std::stoull(static_cast<const Integer_Literal&>(rhs).value);
+        if(value > 0x7FFFFFFF) {
+            return false;
+        }
+
+        immediate = op == Operator::binary_add ? static_cast<i32>(value) : -static_cast<i32>(value);
+        return true;
+    }
+
+    // The immediate is an integer literal and has type i32.
+    static void compile_add_immediate(Bytecode_Context& context, Operand const lhs, i32 const immediate, i32 const dst, Operand& out) {
+        Value_Type const type{max<Width>(lhs.width, 32), lhs.width >= 32 && lhs.is_unsigned};
+        emit(context, Opcode::add_immediate, dst, lhs.index, immediate);
+        out = Operand{dst, type.width, type.is_unsigned};
+        emit_truncation(context, dst, type, false);
+    }
+
+    static bool compile_binary_expression(Bytecode_Context& context, const Binary_Expression& expression, Operand& out, i32 const destination) {
+        if(expression.op == Operator::binary_or || expression.op == Operator::binary_and) {
+            // The destination is written only after the operands have been evaluated, they may read it.
+            std::vector<i64> false_jumps;
+            if(!compile_branch(context, expression, false, false_jumps)) {
+                return false;
+            }
+
+            out = Operand{select_register(context, destination), 1, true};
+            emit(context, Opcode::load_immediate, out.index, 1);
+            i64 const end_jump = emit(context, Opcode::jump);
+            patch_jumps(context, false_jumps);
+            emit(context, Opcode::load_immediate, out.index, 0);
+            patch_jumps(context, {end_jump});
+            return true;
+        }
+
+        i32 immediate;
+        if(get_immediate_operand(context, expression.op, *expression.rhs, immediate)) {
+            Operand lhs;
+            if(!compile_expression(context, *expression.lhs, lhs)) {
+                return false;
+            }
+
+            compile_add_immediate(context, lhs, immediate, select_register(context, destination), out);
+            return true;
+        }
+
+        Operand lhs;
+        Operand rhs;
+        if(!compile_operands(context, *expression.lhs, *expression.rhs, lhs, rhs)) {
+            return false;
+        }
+
+        return compile_arithmetic(context, expression.op, lhs, rhs, select_register(context, destination), out);
+    }
+
+    static bool compile_assignment_expression(Bytecode_Context& context, const Assignment_Expression& expression, Operand& out, i32 const destination) {
+        if(expression.element) {
+            return fail(context, "arrays are not supported by the bytecode compiler");
+        }
+
+        const std::string& name = expression.identifier->name;
+        Local* local = find_local(context, name);
+        if(!local) {
+            if(context.globals.count(name)) {
+                return fail(context, "Cannot assign to global variable \"" + name + "\"");
+            }
+            return fail(context, "Undefined variable: \"" + name + "\" referenced");
+        }
+
+        if(!local->is_mutable) {
+            return fail(context, "Cannot assign to immutable variable \"" + name + "\"");
+        }
+
+        Local const variable = *local;
+        if(expression.op == Operator::assign) {
+            Operand value;
+            if(!compile_expression(context, *expression.value, value, variable.index)) {
+                return false;
+            }
+            emit_conversion(context, variable.index, value, variable.type);
+        } else {
+            // The value is evaluated before the variable is read, it may assign to it.
+            Operand const lhs{variable.index, variable.type.width, variable.type.is_unsigned};
+            Operand result;
+            i32 immediate;
+            if(get_immediate_operand(context, expression.op, *expression.value, immediate)) {
+                compile_add_immediate(context, lhs, immediate, variable.index, result);
+            } else {
+                Operand value;
+                if(!compile_expression(context, *expression.value, value) ||
+                   !compile_arithmetic(context, expression.op, lhs, value, variable.index, result)) {
+                    return false;
+                }
+            }
+            emit_conversion(context, variable.index, result, variable.type);
+        }
+
+        out = Operand{variable.index, variable.type.width, variable.type.is_unsigned};
+        if(destination >= 0 && destination != variable.index) {
+            emit(context, Opcode::move, destination, variable.index);
+            out.index = destination;
+        }
+        return true;
+    }
+
+    static bool compile_call_expression(Bytecode_Context& context, const Function_Call_Expression& expression, Operand& out, i32 const destination) {
+        const std::string& name = expression.identifier->name;
+        if(expression.template_arguments) {
+            return fail(context, "templates are not supported by the bytecode compiler");
+        }
+
+        auto iter = context.functions.find(name);
+        if(iter == context.functions.end()) {
+            return fail(context, "Undefined function \"" + name + "\"");
+        }
+
+        const Function_Signature& signature = iter->second;
+        const auto& arguments = expression.arg_list->arguments;
+        if(arguments.size() != signature.parameters.size()) {
+            return fail(context, "Wrong number of arguments in call to \"" + name + "\"");
+        }
+
+        // The result register must not be one of the argument registers, which the callee overwrites.
+        out = Operand{-1, signature.return_type.width, signature.return_type.is_unsigned};
+        if(signature.return_type.width != 0) {
+            out.index = select_register(context, destination);
+        }
+
+        i32 const first_argument = context.next_register;
+        for(u64 i = 0; i < arguments.size(); ++i) {
+            allocate_register(context);
+        }
+
+        for(u64 i = 0; i < arguments.size(); ++i) {
+            i32 const argument_register = first_argument + static_cast<i32>(i);
+            Operand argument;
+            if(!compile_expression(context, *arguments[i], argument, argument_register)) {
+                return false;
+            }
+            emit_conversion(context, argument_register, argument, signature.parameters[i]);
+            // Temporaries of the argument are dead.
+            context.next_register = argument_register + 1;
+        }
+
+        if(signature.return_type.width != 0) {
+            emit(context, Opcode::call, out.index, static_cast<i32>(signature.index), first_argument);
+        } else {
+            emit(context, Opcode::call_void, static_cast<i32>(signature.index), first_argument);
+        }
+        context.next_register = first_argument;
+        return true;
+    }
+
+    static bool compile_expression(Bytecode_Context& context, const Expression& expression, Operand& out, i32 const destination) {
+        switch(expression.node_type) {
+            case AST_Node_Type::integer_literal: {
+                // Integer literals have type i32, the same as in codegen.
+                u64 const value = std::stoull(static_cast<const Integer_Literal&>(expression).value);
+                out = Operand{select_register(context, destination), 32};
+                emit(context, Opcode::load_immediate, out.index, static_cast<i32>(value));
+                return true;
+            }
+
+            case AST_Node_Type::bool_literal: {
+                out = Operand{select_register(context, destination), 1, true};
+                emit(context, Opcode::load_immediate, out.index, static_cast<const Bool_Literal&>(expression).value);
+                return true;
+            }
+
+            case AST_Node_Type::identifier_expression: {
+                auto& identifier = static_cast<const Identifier_Expression&>(expression);
+                if(identifier.template_arguments) {
+                    return fail(context, "templates are not supported by the bytecode compiler");
+                }
+
+                const std::string& name = identifier.identifier->name;
+                if(Local* local = find_local(context, name)) {
+                    out = Operand{local->index, local->type.width, local->type.is_unsigned};
+                    if(destination >= 0 && destination != local->index) {
+                        emit(context, Opcode::move, destination, local->index);
+                        out.index = destination;
+                    }
+                    return true;
+                }
+
+                if(auto iter = context.globals.find(name); iter != context.globals.end()) {
+                    const Global& global = iter->second;
+                    out = Operand{select_register(context, destination), global.type.width, global.type.is_unsigned};
+                    emit(context, Opcode::load_global, out.index, static_cast<i32>(global.index));
+                    return true;
+                }
+                return fail(context, "Undefined variable: \"" + name + "\" referenced");
+            }
+
+            case AST_Node_Type::binary_expression: {
+                return compile_binary_expression(context, static_cast<const Binary_Expression&>(expression), out, destination);
+            }
+
+            case AST_Node_Type::assignment_expression: {
+                return compile_assignment_expression(context, static_cast<const Assignment_Expression&>(expression), out, destination);
+            }
+
+            case AST_Node_Type::function_call_expression: {
+                return compile_call_expression(context, static_cast<const Function_Call_Expression&>(expression), out, destination);
+            }
+
+            default:
+                return fail(context, "expression is not supported by the bytecode compiler");
+        }
+    }
+
+    // Emits jumps that are taken when the condition equals jump_if and appends them to jumps.
+    // Comparisons are fused with the branch and || and && short-circuit without materializing a bool.
+    static bool compile_branch(Bytecode_Context& context, const Expression& expression, bool const jump_if, std::vector<i64>& jumps) {
+        i32 const first_temporary = context.next_register;
+        if(expression.node_type == AST_Node_Type::bool_literal) {
+            if(static_cast<const Bool_Literal&>(expression).value == jump_if) {
+                jumps.push_back(emit(context, Opcode::jump));
+            }
+            return true;
+        }
+
+        if(expression.node_type == AST_Node_Type::binary_expression) {
+            auto& binary_expression = static_cast<const Binary_Expression&>(expression);
+            Operator const op = binary_expression.op;
+            if(op == Operator::binary_or || op == Operator::binary_and) {
+                // `a || b` jumps if a is true, `a && b` if a is false. Otherwise b decides.
+                bool const short_circuit = op == Operator::binary_or;
+                if(jump_if == short_circuit) {
+                    return compile_branch(context, *binary_expression.lhs, jump_if, jumps) &&
+                           compile_branch(context, *binary_expression.rhs, jump_if, jumps);
+                }
+
+                std::vector<i64> skip_jumps;
+                if(!compile_branch(context, *binary_expression.lhs, short_circuit, skip_jumps) ||
+                   !compile_branch(context, *binary_expression.rhs, jump_if, jumps)) {
+                    return false;
+                }
+                patch_jumps(context, skip_jumps);
+                return true;
+            }
+
+            if(is_comparison(op)) {
+                Operand lhs;
+                Operand rhs;
+                if(!compile_operands(context, *binary_expression.lhs, *binary_expression.rhs, lhs, rhs)) {
+                    return false;
+                }
+
+                bool const is_unsigned = unify_operands(context, lhs, rhs).is_unsigned;
+                // a > b is b < a, a <= b is !(b < a) and a >= b is !(a < b).
+                bool const swap = op == Operator::binary_gt || op == Operator::binary_leq;
+                bool const negate = op == Operator::binary_neq || op == Operator::binary_leq || op == Operator::binary_geq;
+                bool const equality = op == Operator::binary_eq || op == Operator::binary_neq;
+                Opcode opcode;
+                if(equality) {
+                    opcode = jump_if != negate ? Opcode::jump_if_equal : Opcode::jump_if_not_equal;
+                } else if(is_unsigned) {
+                    opcode = jump_if != negate ? Opcode::jump_if_less_unsigned : Opcode::jump_if_not_less_unsigned;
+                } else {
+                    opcode = jump_if != negate ? Opcode::jump_if_less : Opcode::jump_if_not_less;
+                }
+                jumps.push_back(swap ? emit(context, opcode, rhs.index, lhs.index) : emit(context, opcode, lhs.index, rhs.index));
+                context.next_register = first_temporary;
+                return true;
+            }
+        }
+
+        Operand condition;
+        if(!compile_expression(context, expression, condition)) {
+            return false;
+        }
+        jumps.push_back(emit(context, jump_if ? Opcode::jump_if_not_zero : Opcode::jump_if_zero, condition.index));
+        context.next_register = first_temporary;
+        return true;
+    }
+
+    static bool compile_statement(Bytecode_Context& context, const Statement& statement);
+
+    static bool compile_statement_list(Bytecode_Context& context, const Statement_List& statements) {
+        for(const auto& statement: statements.statements) {
+            if(!compile_statement(context, *statement)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Locals declared by the statements go out of scope at the end.
+    template<typename Compile>
+    static bool compile_in_scope(Bytecode_Context& context, Compile compile) {
+        u64 const local_count = context.locals.size();
+        i32 const next_register = context.next_register;
+        bool const success = compile();
+        context.locals.resize(local_count);
+        context.next_register = next_register;
+        return success;
+    }
+
+    static bool compile_if_statement(Bytecode_Context& context, const If_Statement& statement) {
+        std::vector<i64> else_jumps;
+        if(!compile_branch(context, *statement.condition, false, else_jumps) || !compile_statement(context, *statement.block)) {
+            return false;
+        }
+
+        if(!statement.else_if && !statement.else_block) {
+            patch_jumps(context, else_jumps);
+            return true;
+        }
+
+        i64 const end_jump = emit(context, Opcode::jump);
+        patch_jumps(context, else_jumps);
+        bool const success = statement.else_if ? compile_if_statement(context, *statement.else_if) : compile_statement(context, *statement.else_block);
+        patch_jumps(context, {end_jump});
+        return success;
+    }
+
+    // Loops are rotated like in codegen: the condition is tested once before the loop and then
+    // at the bottom of every iteration, so an iteration takes a single branch.
+    template<typename Compile_Body>
+    static bool compile_loop(Bytecode_Context& context, const Expression* condition, const Expression* post_expr, bool const test_first,
+                             Compile_Body compile_body) {
+        std::vector<i64> exit_jumps;
+        if(test_first && condition && !compile_branch(context, *condition, false, exit_jumps)) {
+            return false;
+        }
+
+        i32 const loop_start = static_cast<i32>(context.function->code.size());
+        if(!compile_in_scope(context, compile_body)) {
+            return false;
+        }
+
+        if(post_expr) {
+            i32 const first_temporary = context.next_register;
+            Operand value;
+            if(!compile_expression(context, *post_expr, value)) {
+                return false;
+            }
+            context.next_register = first_temporary;
+        }
+
+        std::vector<i64> loop_jumps;
+        if(condition) {
+            if(!compile_branch(context, *condition, true, loop_jumps)) {
+                return false;
+            }
+        } else {
+            loop_jumps.push_back(emit(context, Opcode::jump));
+        }
+
+        patch_jumps(context, loop_jumps, loop_start);
+        patch_jumps(context, exit_jumps);
+        return true;
+    }
+
+    static bool compile_return_statement(Bytecode_Context& context, const Return_Statement& statement) {
+        if(!statement.expression) {
+            if(context.return_type.width != 0) {
+                return fail(context, "Function \"" + context.function->name + "\" must return a value");
+            }
+            emit(context, Opcode::ret_void);
+            return true;
+        }
+
+        i32 const first_temporary = context.next_register;
+        Operand value;
+        if(!compile_expression(context, *statement.expression, value)) {
+            return false;
+        }
+
+        if(!is_held_as(value, context.return_type)) {
+            i32 const converted = allocate_register(context);
+            emit_conversion(context, converted, value, context.return_type);
+            value.index = converted;
+        }
+        emit(context, Opcode::ret, value.index);
+        context.next_register = first_temporary;
+        return true;
+    }
+
+    static bool compile_variable_declaration(Bytecode_Context& context, const Variable_Declaration& declaration) {
+        const std::string& name = declaration.identifier->name;
+        Value_Type type;
+        if(!resolve_type(context, *declaration.type, type)) {
+            return false;
+        }
+
+        if(type.width == 0) {
+            return fail(context, "Variable \"" + name + "\" may not have type void");
+        }
+
+        // The initializer is compiled before the variable is declared, so it refers to any shadowed variable.
+        i32 const index = allocate_register(context);
+        if(declaration.initializer) {
+            Operand value;
+            if(!compile_expression(context, *declaration.initializer, value, index)) {
+                return false;
+            }
+            emit_conversion(context, index, value, type);
+        } else {
+            emit(context, Opcode::load_immediate, index, 0);
+        }
+
+        context.locals.push_back(Local{name, index, type, declaration.is_mutable});
+        context.next_register = index + 1;
+        return true;
+    }
+
+    static bool compile_statement(Bytecode_Context& context, const Statement& statement) {
+        switch(statement.node_type) {
+            case AST_Node_Type::block_statement: {
+                auto& block = static_cast<const Block_Statement&>(statement);
+                return compile_in_scope(context, [&]() { return compile_statement_list(context, *block.statements); });
+            }
+
+            case AST_Node_Type::if_statement: {
+                return compile_if_statement(context, static_cast<const If_Statement&>(statement));
+            }
+
+            case AST_Node_Type::for_statement: {
+                auto& node = static_cast<const For_Statement&>(statement);
+                // Variables declared by the init statement live in a scope enclosing the loop.
+                return compile_in_scope(context, [&]() {
+                    return (!node.init || compile_statement(context, *node.init)) &&
+                           compile_loop(context, node.condition.get(), node.post_expr.get(), true,
+                                        [&]() { return compile_statement_list(context, *node.statements); });
+                });
+            }
+
+            case AST_Node_Type::while_statement: {
+                auto& node = static_cast<const While_Statement&>(statement);
+                return compile_loop(context, node.condition.get(), nullptr, true, [&]() { return compile_statement(context, *node.block); });
+            }
+
+            case AST_Node_Type::do_while_statement: {
+                auto& node = static_cast<const Do_While_Statement&>(statement);
+                return compile_loop(context, node.condition.get(), nullptr, false, [&]() { return compile_statement(context, *node.block); });
+            }
+
+            case AST_Node_Type::return_statement: {
+                return compile_return_statement(context, static_cast<const Return_Statement&>(statement));
+            }
+
+            case AST_Node_Type::declaration_statement: {
+                return compile_variable_declaration(context, *static_cast<const Declaration_Statement&>(statement).var_decl);
+            }
+
+            case AST_Node_Type::expression_statement: {
+                i32 const first_temporary = context.next_register;
+                Operand value;
+                bool const success = compile_expression(context, *static_cast<const Expression_Statement&>(statement).expr, value);
+                context.next_register = first_temporary;
+                return success;
+            }
+
+            default:
+                return fail(context, "statement is not supported by the bytecode compiler");
+        }
+    }
+
+    static bool compile_function(Bytecode_Context& context, const Function_Declaration& declaration, Bytecode_Function& function) {
+        const Function_Signature& signature = context.functions.at(declaration.name->name);
+        context.function = &function;
+        context.return_type = signature.return_type;
+        context.locals.clear();
+        context.next_register = 0;
+        const auto& parameters = declaration.parameter_list->params;
+        for(u64 i = 0; i < parameters.size(); ++i) {
+            i32 const index = allocate_register(context);
+            context.locals.push_back(Local{parameters[i]->identifier->name, index, signature.parameters[i], false});
+        }
+
+        if(!compile_statement_list(context, *declaration.body->statements)) {
+            return false;
+        }
+
+        // Also the target of forward jumps out of the last statement, even if that statement returns.
+        emit(context, function.returns_value ? Opcode::missing_return : Opcode::ret_void);
+        return true;
+    }
+
+    static bool compile_global_initializer(Bytecode_Context& context, const Variable_Declaration& declaration) {
+        const Global& global = context.globals.at(declaration.identifier->name);
+        i32 const first_temporary = context.next_register;
+        Operand value{allocate_register(context), global.type.width, global.type.is_unsigned};
+        if(declaration.initializer) {
+            if(!compile_expression(context, *declaration.initializer, value, value.index)) {
+                return false;
+            }
+            emit_conversion(context, value.index, value, global.type);
+        } else {
+            emit(context, Opcode::load_immediate, value.index, 0);
+        }
+        emit(context, Opcode::store_global, static_cast<i32>(global.index), value.index);
+        context.next_register = first_temporary;
+        return true;
+    }
+
+    anton::Expected<Bytecode_Program, std::string> compile_bytecode(const std::vector<Owning_Ptr<Declaration>>& nodes, Overflow_Policy const overflow) {
+        Bytecode_Context context;
+        context.overflow = overflow;
+        Bytecode_Program program;
+        std::vector<const Function_Declaration*> functions;
+        std::vector<const Variable_Declaration*> globals;
+        // Functions and globals may be used before they are declared.
+        for(const auto& node: nodes) {
+            if(node->node_type == AST_Node_Type::function_declaration) {
+                auto& declaration = static_cast<const Function_Declaration&>(*node);
+                if(declaration.template_parameters) {
+                    return {anton::expected_error, "templates are not supported by the bytecode compiler"};
+                }
+
+                // Functions may be used before they are defined, so that declarations add nothing.
+                if(!declaration.body) {
+                    continue;
+                }
+
+                Function_Signature signature{static_cast<i64>(functions.size()), {}, {0, false}};
+                for(const auto& parameter: declaration.parameter_list->params) {
+                    Value_Type type;
+                    if(!resolve_type(context, *parameter->type, type)) {
+                        return {anton::expected_error, std::move(context.error)};
+                    }
+                    signature.parameters.push_back(type);
+                }
+
+                if(!resolve_type(context, *declaration.return_type, signature.return_type)) {
+                    return {anton::expected_error, std::move(context.error)};
+                }
+
+                const std::string& name = declaration.name->name;
+                if(!context.functions.emplace(name, std::move(signature)).second) {
+                    return {anton::expected_error, "Redefinition of function \"" + name + "\""};
+                }
+                functions.push_back(&declaration);
+            } else if(node->node_type == AST_Node_Type::variable_declaration) {
+                auto& declaration = static_cast<const Variable_Declaration&>(*node);
+                if(declaration.template_parameters) {
+                    return {anton::expected_error, "templates are not supported by the bytecode compiler"};
+                }
+
+                Value_Type type;
+                if(!resolve_type(context, *declaration.type, type)) {
+                    return {anton::expected_error, std::move(context.error)};
+                }
+
+                const std::string& name = declaration.identifier->name;
+                if(!context.globals.emplace(name, Global{static_cast<i64>(globals.size()), type}).second) {
+                    return {anton::expected_error, "Redefinition of global variable \"" + name + "\""};
+                }
+                globals.push_back(&declaration);
+            }
+        }
+
+        program.functions.resize(functions.size());
+        for(u64 i = 0; i < functions.size(); ++i) {
+            Bytecode_Function& function = program.functions[i];
+            const Function_Signature& signature = context.functions.at(functions[i]->name->name);
+            function.name = functions[i]->name->name;
+            function.parameter_count = static_cast<i64>(signature.parameters.size());
+            function.returns_value = signature.return_type.width != 0;
+            if(!compile_function(context, *functions[i], function)) {
+                return {anton::expected_error, "in \"" + function.name + "\": " + context.error};
+            }
+        }
+
+        // Globals are initialized in the order of their declarations.
+        program.global_initializer.name = "global initializer";
+        program.global_count = static_cast<i64>(globals.size());
+        context.function = &program.global_initializer;
+        context.locals.clear();
+        context.next_register = 0;
+        for(const Variable_Declaration* declaration: globals) {
+            if(!compile_global_initializer(context, *declaration)) {
+                return {anton::expected_error, "in the initializer of \"" + declaration->identifier->name + "\": " + context.error};
+            }
+        }
+        emit(context, Opcode::ret_void);
+        return {anton::expected_value, std::move(program)};
+    }
+
+    i64 find_bytecode_function(const Bytecode_Program& program, const std::string& name) {
+        for(u64 i = 0; i < program.functions.size(); ++i) {
+            if(program.functions[i].name == name) {
+                return static_cast<i64>(i);
+            }
+        }
+        return -1;
+    }
+
+    static void print_function(std::string& out, const Bytecode_Function& function) {
+        static constexpr std::string_view opcode_names[] = {
+#define TILDAC_BYTECODE_OPCODE_NAME(name, operands) #name,
+            TILDAC_BYTECODE_OPCODES(TILDAC_BYTECODE_OPCODE_NAME)
+#undef TILDAC_BYTECODE_OPCODE_NAME
+        };
+
+        static constexpr std::string_view opcode_operands[] = {
+#define TILDAC_BYTECODE_OPCODE_OPERANDS(name, operands) operands,
+            TILDAC_BYTECODE_OPCODES(TILDAC_BYTECODE_OPCODE_OPERANDS)
+#undef TILDAC_BYTECODE_OPCODE_OPERANDS
+        };
+
+        out += function.name + ": parameters " + std::to_string(function.parameter_count) + ", registers " + std::to_string(function.register_count) + '\n';
+        for(u64 i = 0; i < function.code.size(); ++i) {
+            const Instruction& instruction = function.code[i];
+            std::string_view const operands = opcode_operands[static_cast<u8>(instruction.opcode)];
+            i64 const operand_count = operands.size() == 0 ? 0 : std::count(operands.begin(), operands.end(), ',') + 1;
+            out += "    " + std::to_string(i) + ": " + std::string(opcode_names[static_cast<u8>(instruction.opcode)]);
+            i32 const values[] = {instruction.a, instruction.b, instruction.c};
+            for(i64 operand = 0; operand < operand_count; ++operand) {
+                out += (operand == 0 ? " " : ", ") + std::to_string(values[operand]);
+            }
+            out += '\n';
+        }
+    }
+
+    std::string print_bytecode(const Bytecode_Program& program) {
+        std::string out;
+        for(const Bytecode_Function& function: program.functions) {
+            print_function(out, function);
+        }
+        print_function(out, program.global_initializer);
+        return out;
+    }
+} // namespace tildac
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <anton/expected.hpp>
+#include <tildac/ast.hpp>
+#include <tildac/constant_evaluation.hpp>
+#include <tildac/types.hpp>
+#include <tildac/utility.hpp>
+
+#include <string>
+#include <vector>
+
+namespace tildac {
+    // X(name, operands). Registers are indices into the frame of the executing function.
+    // Jump targets are indices into the code of the function.
+#define TILDAC_BYTECODE_OPCODES(X)                                                                                  \
+    X(load_immediate, "dst, value")                                                                                 \
+    X(load_global, "dst, global")                                                                                   \
+    X(store_global, "global, src")                                                                                  \
+    X(move, "dst, src")                                                                                             \
+    /* Truncation of a value to a narrower type. shift is 64 minus the width of the type. */                        \
+    X(sign_extend, "dst, src, shift")                                                                               \
+    X(zero_extend, "dst, src, shift")                                                                               \
+    /* Truncation of the result of arithmetic that traps if the result does not fit into the type. */               \
+    X(sign_extend_checked, "dst, src, shift")                                                                       \
+    X(zero_extend_checked, "dst, src, shift")                                                                       \
+    X(truncate_to_bool, "dst, src")                                                                                 \
+    X(add, "dst, lhs, rhs")                                                                                         \
+    X(sub, "dst, lhs, rhs")                                                                                         \
+    X(mul, "dst, lhs, rhs")                                                                                         \
+    X(div, "dst, lhs, rhs")                                                                                         \
+    X(div_unsigned, "dst, lhs, rhs")                                                                                \
+    /* Arithmetic on 64 bit types that traps on overflow. */                                                        \
+    X(add_checked, "dst, lhs, rhs")                                                                                 \
+    X(sub_checked, "dst, lhs, rhs")                                                                                 \
+    X(mul_checked, "dst, lhs, rhs")                                                                                 \
+    X(add_unsigned_checked, "dst, lhs, rhs")                                                                        \
+    X(sub_unsigned_checked, "dst, lhs, rhs")                                                                        \
+    X(mul_unsigned_checked, "dst, lhs, rhs")                                                                        \
+    X(add_immediate, "dst, lhs, value")                                                                             \
+    X(equal, "dst, lhs, rhs")                                                                                       \
+    X(not_equal, "dst, lhs, rhs")                                                                                   \
+    X(less, "dst, lhs, rhs")                                                                                        \
+    X(less_equal, "dst, lhs, rhs")                                                                                  \
+    X(less_unsigned, "dst, lhs, rhs")                                                                               \
+    X(less_equal_unsigned, "dst, lhs, rhs")                                                                         \
+    X(jump, "target")                                                                                               \
+    X(jump_if_zero, "condition, target")                                                                            \
+    X(jump_if_not_zero, "condition, target")                                                                        \
+    /* Conditional branches fused with the comparison that decides them. */                                         \
+    X(jump_if_less, "lhs, rhs, target")                                                                             \
+    X(jump_if_not_less, "lhs, rhs, target")                                                                         \
+    X(jump_if_less_unsigned, "lhs, rhs, target")                                                                    \
+    X(jump_if_not_less_unsigned, "lhs, rhs, target")                                                                \
+    X(jump_if_equal, "lhs, rhs, target")                                                                            \
+    X(jump_if_not_equal, "lhs, rhs, target")                                                                        \
+    /* The arguments are in consecutive registers starting at `arguments` and become the first */                   \
+    /* registers of the callee's frame. */                                                                          \
+    X(call, "dst, function, arguments")                                                                             \
+    X(call_void, "function, arguments")                                                                             \
+    X(ret, "src")                                                                                                   \
+    X(ret_void, "")                                                                                                 \
+    /* Flowing off the end of a function that returns a value. */                                                   \
+    X(missing_return, "")
+
+    enum struct Opcode : u8 {
+#define TILDAC_BYTECODE_OPCODE_ENUM(name, operands) name,
+        TILDAC_BYTECODE_OPCODES(TILDAC_BYTECODE_OPCODE_ENUM)
+#undef TILDAC_BYTECODE_OPCODE_ENUM
+    };
+
+    struct Instruction {
+        Opcode opcode;
+        i32 a = 0;
+        i32 b = 0;
+        i32 c = 0;
+    };
+
+    struct Bytecode_Function {
+        std::string name;
+        std::vector<Instruction> code;
+        i64 parameter_count = 0;
+        // Parameters, locals and temporaries.
+        i64 register_count = 0;
+        bool returns_value = false;
+    };
+
+    // A translation unit lowered to bytecode. Values are integers of at most 64 bits held sign-extended,
+    // or zero-extended if they are unsigned, in 64 bit registers, and have the same semantics as in the code
+    // generated by LLVM. Overflows trap with Overflow_Policy::trap and wrap around otherwise.
+    struct Bytecode_Program {
+        std::vector<Bytecode_Function> functions;
+        // Stores the initial values of the global variables.
+        Bytecode_Function global_initializer;
+        i64 global_count = 0;
+    };
+
+    // Lowers the non-templated functions and global variables.
+    // Fails on templates and on types other than integers, bool and pointers.
+    [[nodiscard]] anton::Expected<Bytecode_Program, std::string> compile_bytecode(const std::vector<Owning_Ptr<Declaration>>& nodes,
+                                                                                  Overflow_Policy overflow);
+
+    // Returns the index of the function or -1 if the program does not define it.
+    [[nodiscard]] i64 find_bytecode_function(const Bytecode_Program& program, const std::string& name);
+
+    [[nodiscard]] std::string print_bytecode(const Bytecode_Program& program);
+} // namespace tildac
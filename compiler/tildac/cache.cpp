@@ -0,0 +1,230 @@
+#include <tildac/cache.hpp>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/SHA1.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+
+namespace tildac {
+    namespace fs = std::filesystem;
+
+    // Evicting down to below the limit leaves room for a number of compilations before the next eviction.
+    static constexpr i64 eviction_target_percent = 90;
+
+    // Unique temporary directories with relative paths are created in the temporary directory of the system.
+    Compilation_Cache::Compilation_Cache(fs::path const directory, i64 const max_size): _directory(fs::absolute(directory)), _max_size(max_size) {}
+
+    Compilation_Cache::~Compilation_Cache() {
+        flush_statistics();
+    }
+
+    fs::path Compilation_Cache::default_directory() {
+        if(char const* directory = std::getenv("TILDAC_CACHE_DIR"); directory && *directory) {
+            return directory;
+        }
+
+        if(char const* directory = std::getenv("XDG_CACHE_HOME"); directory && *directory) {
+            return fs::path(directory) / "tildac";
+        }
+
+        if(char const* home = std::getenv("HOME"); home && *home) {
+            return fs::path(home) / ".cache" / "tildac";
+        }
+        return fs::temp_directory_path() / "tildac-cache";
+    }
+
+    std::string Compilation_Cache::make_key(std::string_view const source, std::string_view const compiler_identity, std::string_view const options_description) {
+        // Every part is prefixed by its size, so that no two different sets of parts hash the same bytes.
+        llvm::SHA1 hash;
+        for(std::string_view const part: {compiler_identity, options_description, source}) {
+            hash.update(std::to_string(part.size()) + ':');
+            hash.update(llvm::StringRef(part.data(), part.size()));
+        }
+        return llvm::toHex(hash.final(), true);
+    }
+
+    fs::path Compilation_Cache::get_entry_path(const std::string& key) const {
+        return _directory / key.substr(0, 2) / key;
+    }
+
+    bool Compilation_Cache::retrieve(const std::string& key, const std::vector<fs::path>& paths, bool const hard_link) {
+        fs::path const entry = get_entry_path(key);
+        std::error_code error;
+        // The entry must have exactly as many partitions as there are paths.
+        bool hit = fs::is_regular_file(entry / std::to_string(paths.size() - 1), error) && !fs::exists(entry / std::to_string(paths.size()), error);
+        for(u64 i = 0; hit && i < paths.size(); ++i) {
+            fs::path const cached = entry / std::to_string(i);
+            // Links cannot replace existing files.
+            fs::remove(paths[i], error);
+            if(hard_link) {
+                fs::create_hard_link(cached, paths[i], error);
+                if(!error) {
+                    continue;
+                }
+            }
+            hit = fs::copy_file(cached, paths[i], fs::copy_options::overwrite_existing, error);
+        }
+
+        if(hit) {
+            _pending.hits += 1;
+            fs::last_write_time(entry, fs::file_time_type::clock::now(), error);
+        } else {
+            _pending.misses += 1;
+        }
+        return hit;
+    }
+
+    bool Compilation_Cache::retrieve(const std::string& key, Output_Buffer& buffer) {
+        fs::path const entry = get_entry_path(key);
+        std::error_code error;
+        std::uintmax_t const size = fs::file_size(entry / "0", error);
+        bool hit = !error && !fs::exists(entry / "1", error);
+        if(hit) {
+            std::ifstream file(entry / "0", std::ios::binary);
+            buffer.resize(size);
+            hit = static_cast<bool>(file.read(buffer.data(), static_cast<std::streamsize>(size)));
+        }
+
+        if(hit) {
+            _pending.hits += 1;
+            fs::last_write_time(entry, fs::file_time_type::clock::now(), error);
+        } else {
+            _pending.misses += 1;
+        }
+        return hit;
+    }
+
+    void Compilation_Cache::store(const std::string& key, const std::vector<Output_Buffer>& buffers) {
+        fs::path const entry = get_entry_path(key);
+        std::error_code error;
+        fs::create_directories(entry.parent_path(), error);
+        llvm::SmallString<128> temporary;
+        if(error || llvm::sys::fs::createUniqueDirectory((_directory / "tmp").string(), temporary)) {
+            return;
+        }
+
+        i64 size = 0;
+        bool written = true;
+        for(u64 i = 0; i < buffers.size(); ++i) {
+            std::ofstream file(fs::path(temporary.str().str()) / std::to_string(i), std::ios::binary);
+            file.write(buffers[i].data(), static_cast<std::streamsize>(buffers[i].size()));
+            written = written && file.good();
+            size += static_cast<i64>(buffers[i].size());
+        }
+
+        // Renaming fails if a concurrent compilation stored the entry first.
+        fs::rename(temporary.str().str(), entry, error);
+        if(!written || error) {
+            fs::remove_all(temporary.str().str(), error);
+            return;
+        }
+
+        _pending.size += size;
+        if(get_statistics().size > _max_size) {
+            flush_statistics();
+        }
+    }
+
+    void Compilation_Cache::evict(Cache_Statistics& statistics) const {
+        struct Entry {
+            fs::path path;
+            fs::file_time_type last_use;
+            i64 size;
+        };
+
+        std::vector<Entry> entries;
+        i64 total_size = 0;
+        std::error_code error;
+        for(const fs::directory_entry& bucket: fs::directory_iterator(_directory, error)) {
+            if(!bucket.is_directory(error) || bucket.path().filename().string().size() != 2) {
+                continue;
+            }
+
+            for(const fs::directory_entry& entry: fs::directory_iterator(bucket.path(), error)) {
+                i64 size = 0;
+                for(const fs::directory_entry& partition: fs::directory_iterator(entry.path(), error)) {
+                    size += static_cast<i64>(partition.file_size(error));
+                }
+                entries.push_back(Entry{entry.path(), entry.last_write_time(error), size});
+                total_size += size;
+            }
+        }
+
+        std::sort(entries.begin(), entries.end(), [](const Entry& lhs, const Entry& rhs) { return lhs.last_use < rhs.last_use; });
+        i64 const target_size = _max_size / 100 * eviction_target_percent;
+        for(const Entry& entry: entries) {
+            if(total_size <= target_size) {
+                break;
+            }
+
+            if(fs::remove_all(entry.path, error) != static_cast<std::uintmax_t>(-1)) {
+                total_size -= entry.size;
+            }
+        }
+        statistics.size = total_size;
+    }
+
+    Cache_Statistics Compilation_Cache::get_statistics() const {
+        Cache_Statistics statistics = load_statistics();
+        statistics.hits += _pending.hits;
+        statistics.misses += _pending.misses;
+        statistics.size += _pending.size;
+        return statistics;
+    }
+
+    Cache_Statistics Compilation_Cache::load_statistics() const {
+        Cache_Statistics statistics;
+        std::ifstream file(_directory / "stats");
+        std::string name;
+        i64 value;
+        while(file >> name >> value) {
+            if(name == "hits") {
+                statistics.hits = value;
+            } else if(name == "misses") {
+                statistics.misses = value;
+            } else if(name == "size") {
+                statistics.size = value;
+            }
+        }
+        return statistics;
+    }
+
+    void Compilation_Cache::flush_statistics() {
+        if(_pending.hits == 0 && _pending.misses == 0 && _pending.size == 0) {
+            return;
+        }
+
+        Cache_Statistics statistics = get_statistics();
+        _pending = Cache_Statistics();
+        if(statistics.size > _max_size) {
+            evict(statistics);
+        }
+        save_statistics(statistics);
+    }
+
+    void Compilation_Cache::save_statistics(const Cache_Statistics& statistics) const {
+        std::error_code error;
+        fs::create_directories(_directory, error);
+        llvm::SmallString<128> temporary;
+        if(error || llvm::sys::fs::createUniqueFile((_directory / "stats.tmp-%%%%%%").string(), temporary)) {
+            return;
+        }
+
+        {
+            std::ofstream file(temporary.str().str());
+            file << "hits " << statistics.hits << "\nmisses " << statistics.misses << "\nsize " << statistics.size << '\n';
+        }
+        fs::rename(temporary.str().str(), _directory / "stats", error);
+    }
+
+    void Compilation_Cache::clear() {
+        _pending = Cache_Statistics();
+        std::error_code error;
+        fs::remove_all(_directory, error);
+    }
+} // namespace tildac
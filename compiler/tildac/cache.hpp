@@ -0,0 +1,70 @@
+#pragma once
+
+#include <tildac/codegen.hpp>
+#include <tildac/types.hpp>
+
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace tildac {
+    struct Cache_Statistics {
+        i64 hits = 0;
+        i64 misses = 0;
+        // Total size of the entries in bytes.
+        i64 size = 0;
+    };
+
+    // A local, content-addressed cache of compiler outputs. Entries are keyed on a hash of the source,
+    // the identity of the compiler and every option that affects the output.
+    //
+    // Each entry is a directory `<first two digits of the key>/<key>` that holds one file per output
+    // partition. Entries are written into a temporary directory and renamed into place, so concurrent
+    // compilations never observe partial entries. The modification time of an entry is its last use.
+    // When the cache grows beyond its limit, the least recently used entries are evicted.
+    // The statistics are collected in memory and written when the cache is destroyed. They are updated
+    // without locking and may miss counts of concurrent compilations.
+    class Compilation_Cache {
+    public:
+        Compilation_Cache(std::filesystem::path directory, i64 max_size);
+        Compilation_Cache(const Compilation_Cache&) = delete;
+        Compilation_Cache& operator=(const Compilation_Cache&) = delete;
+        ~Compilation_Cache();
+
+        // `$TILDAC_CACHE_DIR`, `$XDG_CACHE_HOME/tildac` or `~/.cache/tildac`.
+        [[nodiscard]] static std::filesystem::path default_directory();
+
+        // compiler_identity distinguishes builds of the compiler that may produce different output.
+        [[nodiscard]] static std::string make_key(std::string_view source, std::string_view compiler_identity, std::string_view options_description);
+
+        // Places the outputs of the entry at the paths, one path per partition. Hard links them to the
+        // entry if hard_link is set and the file system permits, otherwise copies them.
+        // Returns false and counts a miss if there is no entry with that many partitions.
+        [[nodiscard]] bool retrieve(const std::string& key, const std::vector<std::filesystem::path>& paths, bool hard_link);
+
+        // Reads the output of an entry with a single partition into the buffer.
+        // Returns false and counts a miss if there is no such entry.
+        [[nodiscard]] bool retrieve(const std::string& key, Output_Buffer& buffer);
+
+        // Adds the outputs of a compilation and evicts entries if the cache exceeds its limit.
+        void store(const std::string& key, const std::vector<Output_Buffer>& buffers);
+
+        // The statistics of the cache including those of this instance that have not been written yet.
+        [[nodiscard]] Cache_Statistics get_statistics() const;
+        // Removes all entries and resets the statistics.
+        void clear();
+
+    private:
+        std::filesystem::path _directory;
+        i64 _max_size;
+        // Counts of this instance that have not been added to the statistics file yet.
+        Cache_Statistics _pending;
+
+        std::filesystem::path get_entry_path(const std::string& key) const;
+        Cache_Statistics load_statistics() const;
+        void flush_statistics();
+        void save_statistics(const Cache_Statistics& statistics) const;
+        void evict(Cache_Statistics& statistics) const;
+    };
+} // namespace tildac
@@ -1,65 +1,234 @@
+#include <tildac/backend.hpp>
 #include <tildac/codegen.hpp>
+#include <tildac/memory_report.hpp>
+#include <tildac/timing.hpp>
 #include <tildac/types.hpp>
 
 #include <llvm/ADT/APFloat.h>
 #include <llvm/ADT/Optional.h>
 #include <llvm/ADT/STLExtras.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/ADT/Triple.h>
+#include <llvm/BinaryFormat/Dwarf.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Bitcode/BitcodeWriterPass.h>
+#include <llvm/CodeGen/ParallelCG.h>
 #include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/CFG.h>
 #include <llvm/IR/Constants.h>
+#include <llvm/IR/DIBuilder.h>
+#include <llvm/IR/DebugInfoMetadata.h>
 #include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/DiagnosticInfo.h>
 #include <llvm/IR/Function.h>
+#include <llvm/IR/GlobalVariable.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/Instructions.h>
+#include <llvm/IR/Intrinsics.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/MDBuilder.h>
+#include <llvm/IR/Metadata.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/PassManager.h>
+#include <llvm/IR/RemarkStreamer.h>
 #include <llvm/IR/Type.h>
+#include <llvm/IR/ValueHandle.h>
 #include <llvm/IR/Verifier.h>
 #include <llvm/Passes/PassBuilder.h>
-#include <llvm/Support/FileSystem.h>
-#include <llvm/Support/Host.h>
-#include <llvm/Support/TargetRegistry.h>
-#include <llvm/Support/TargetSelect.h>
+#include <llvm/ProfileData/InstrProf.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Regex.h>
+#include <llvm/Support/SHA1.h>
+#include <llvm/Support/ToolOutputFile.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Target/TargetMachine.h>
-#include <llvm/Target/TargetOptions.h>
-#include <llvm/Transforms/InstCombine/InstCombine.h>
-#include <llvm/Transforms/Scalar.h>
-#include <llvm/Transforms/Scalar/GVN.h>
+#include <llvm/Transforms/IPO/HotColdSplitting.h>
+#include <llvm/Transforms/Scalar/InductiveRangeCheckElimination.h>
+#include <llvm/Transforms/Scalar/SimpleLoopUnswitch.h>
+#include <llvm/Transforms/Utils/ModuleUtils.h>
 
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <memory>
 #include <stack>
-#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 namespace tildac {
+    struct Template_Argument {
+        // Canonical spelling of the argument (e.g. `u64`). Instances are keyed by these.
+        std::string canonical_name;
+        llvm::Type* type;
+    };
+
+    // Maps template parameter names to the arguments they are substituted with.
+    using Template_Arguments = std::unordered_map<std::string, Template_Argument>;
+
+    struct Pending_Instantiation {
+        const Function_Declaration* declaration;
+        llvm::Function* function;
+        Template_Arguments arguments;
+    };
+
+    // A local variable or a function parameter.
+    struct Variable {
+        std::string name;
+        llvm::Type* type;
+        bool is_mutable;
+        // LLVM types carry no signedness, e.g. i8 and u8 are both i8.
+        bool is_unsigned;
+        // Only variables that cannot be held in a register live in an entry block alloca.
+        // All other variables are SSA values and stack_slot is nullptr.
+        llvm::AllocaInst* stack_slot = nullptr;
+        // The reaching definition of the variable at the end of every block that has been visited.
+        // Tracking handles follow trivial phis as they are replaced.
+        std::unordered_map<llvm::BasicBlock*, llvm::WeakTrackingVH> definitions;
+        // nullptr unless the debug info describes variables.
+        llvm::DILocalVariable* debug_variable = nullptr;
+    };
+
+    // Prints the optimization remarks that the patterns select as `file:line:column: remark: ...`.
+    // Other diagnostics are left to the default handler of the context.
+    class Remark_Handler: public llvm::DiagnosticHandler {
+    public:
+        Remark_Handler(const Remark_Options& options)
+            : _passed(make_pattern(options.passed)), _missed(make_pattern(options.missed)), _analysis(make_pattern(options.analysis)) {}
+
+        bool isPassedOptRemarkEnabled(llvm::StringRef const pass) const override {
+            return matches(_passed, pass);
+        }
+
+        bool isMissedOptRemarkEnabled(llvm::StringRef const pass) const override {
+            return matches(_missed, pass);
+        }
+
+        bool isAnalysisRemarkEnabled(llvm::StringRef const pass) const override {
+            return matches(_analysis, pass);
+        }
+
+        bool isAnyRemarkEnabled() const override {
+            return _passed || _missed || _analysis;
+        }
+
+        bool handleDiagnostics(const llvm::DiagnosticInfo& info) override {
+            auto* const remark = llvm::dyn_cast<llvm::DiagnosticInfoOptimizationBase>(&info);
+            if(!remark) {
+                return false;
+            }
+
+            // The context hands over all remarks when they are also recorded into a file.
+            if(!remark->isEnabled()) {
+                return true;
+            }
+
+            llvm::raw_ostream& out = llvm::errs();
+            llvm::StringRef const flag = remark->isPassed() ? "-Rpass" : remark->isMissed() ? "-Rpass-missed" : "-Rpass-analysis";
+            if(remark->isLocationAvailable()) {
+                out << remark->getLocationStr() << ": remark: ";
+            } else {
+                // Modules of the JIT have neither locations nor a source file.
+                const llvm::Function& function = remark->getFunction();
+                if(llvm::StringRef const source = function.getParent()->getSourceFileName(); !source.empty()) {
+                    out << source << ": ";
+                }
+                out << "remark: in function '" << function.getName() << "': ";
+            }
+            out << remark->getMsg() << " [" << flag << '=' << remark->getPassName() << "]\n";
+            return true;
+        }
+
+    private:
+        // nullptr for empty patterns, which select no pass.
+        std::unique_ptr<llvm::Regex> _passed;
+        std::unique_ptr<llvm::Regex> _missed;
+        std::unique_ptr<llvm::Regex> _analysis;
+
+        // The patterns are checked by the driver.
+        static std::unique_ptr<llvm::Regex> make_pattern(const std::string& pattern) {
+            return pattern.empty() ? nullptr : std::make_unique<llvm::Regex>(pattern);
+        }
+
+        static bool matches(const std::unique_ptr<llvm::Regex>& pattern, llvm::StringRef const pass) {
+            return pattern && pattern->match(pass);
+        }
+    };
+
     struct Compiler_Context {
-        llvm::LLVMContext handle;
+        const Codegen_Options& options;
+        // Shared by the units of an incremental compilation, otherwise owned by the context.
+        std::unique_ptr<Constant_Evaluator> owned_evaluator;
+        Constant_Evaluator& evaluator;
+        // The file that the remarks are recorded into. Destroyed after the context that writes into it.
+        std::unique_ptr<llvm::ToolOutputFile> remark_record;
+        // Owned through a pointer so that it can outlive the compilation together with the module, e.g. in the JIT.
+        std::unique_ptr<llvm::LLVMContext> owned_handle;
+        llvm::LLVMContext& handle;
         llvm::IRBuilder<> builder;
-        llvm::Module module;
-        llvm::TargetMachine* target_cpu;
-        llvm::Reloc::Model reloc_model;
+        // Owned through a pointer so that it can be handed over to the parallel code generator.
+        std::unique_ptr<llvm::Module> module;
+        // The target of the compilation with the code generation level applied.
+        Target_Description target;
+        // Owned by the backend session.
+        llvm::TargetMachine& target_machine;
         std::unordered_map<std::string, llvm::Type*> builtin_types;
-        std::vector<std::unordered_map<std::string, llvm::AllocaInst*>> symbol_table;
-
-        Compiler_Context(): handle(), builder(handle), module("", handle) {
-            auto triple = llvm::sys::getDefaultTargetTriple();
-            llvm::InitializeAllTargetInfos();
-            llvm::InitializeAllTargets();
-            llvm::InitializeAllTargetMCs();
-            llvm::InitializeAllAsmParsers();
-            llvm::InitializeAllAsmPrinters();
+        std::vector<std::unordered_map<std::string, Variable*>> symbol_table;
+        // Variables of the function that is being generated.
+        std::vector<Owning_Ptr<Variable>> variables;
+        // SSA construction state as in Braun et al., "Simple and Efficient Construction of Static
+        // Single Assignment Form". A block is sealed once all of its predecessors are known.
+        // Reads in unsealed blocks create operandless phis that are completed once the block is sealed.
+        std::unordered_set<llvm::BasicBlock*> sealed_blocks;
+        std::unordered_map<llvm::BasicBlock*, std::vector<std::pair<Variable*, llvm::PHINode*>>> incomplete_phis;
+        // Templated declarations are not lowered directly. They are instantiated on first use
+        // and every instance is cached under its canonical name (e.g. `pow<i64>`), so that each
+        // unique instantiation is lowered exactly once per compilation.
+        std::unordered_map<std::string, const Function_Declaration*> function_templates;
+        std::unordered_map<std::string, const Variable_Declaration*> variable_templates;
+        std::unordered_map<std::string, llvm::GlobalObject*> template_instances;
+        // Function instances are declared immediately, but their bodies are lowered
+        // after the current function so that the builder state is not disturbed.
+        std::vector<Pending_Instantiation> pending_instantiations;
+        // Substitutions for the instance that is currently being lowered.
+        Template_Arguments template_arguments;
+        // Set while a single unit is lowered. Functions and global variables that other units define
+        // are declared in the module on their first use.
+        Unit_Declarations* unit_declarations = nullptr;
+        // Only the declarations before this index may be used by the code that is being lowered.
+        i64 visible_declarations = 0;
+        // Set if the module carries debug info.
+        std::unique_ptr<llvm::DIBuilder> debug_builder;
+        llvm::DIFile* debug_file = nullptr;
+        // The subprogram of the function that is being generated followed by the lexical blocks
+        // that enclose the current statement.
+        std::vector<llvm::DIScope*> debug_scopes;
+        // Types of the debug info by their spelling.
+        std::unordered_map<std::string, llvm::DIType*> debug_types;
+        // Functions that return unsigned integers and global variables that hold them.
+        std::unordered_set<const llvm::GlobalObject*> unsigned_objects;
+        // Whether the results of the binary expressions are unsigned. Unlike the signedness of other
+        // expressions, it depends on the types of both operands, see is_unsigned.
+        std::unordered_map<const Expression*, bool> unsigned_results;
+        // The number of errors that have been reported in the program.
+        i64 error_count = 0;
 
-            module.setTargetTriple(triple);
-            std::string error{};
-            auto target = llvm::TargetRegistry::lookupTarget(triple, error);
-
-            llvm::TargetOptions target_options;
-            reloc_model = llvm::Reloc::Model::PIC_;
-            target_cpu = target->createTargetMachine(triple, "generic", "", target_options, reloc_model);
-            module.setDataLayout(target_cpu->createDataLayout());
+        Compiler_Context(const std::vector<Owning_Ptr<Declaration>>& nodes, const Codegen_Options& options, const Target_Description& target,
+                         llvm::TargetMachine& target_machine, Constant_Evaluator* shared_evaluator = nullptr)
+            : options(options),
+              owned_evaluator(shared_evaluator ? nullptr : std::make_unique<Constant_Evaluator>(nodes, options.evaluation_limits, options.overflow)),
+              evaluator(shared_evaluator ? *shared_evaluator : *owned_evaluator), owned_handle(std::make_unique<llvm::LLVMContext>()), handle(*owned_handle),
+              builder(handle), module(std::make_unique<llvm::Module>("", handle)),
+              target(target), target_machine(target_machine) {
+            module->setTargetTriple(target_machine.getTargetTriple().str());
+            module->setDataLayout(target_machine.createDataLayout());
+            if(options.remarks.enabled()) {
+                handle.setDiagnosticHandler(std::make_unique<Remark_Handler>(options.remarks));
+            }
 
             builtin_types = {
                 {"void", llvm::Type::getVoidTy(handle)},  {"bool", llvm::Type::getInt1Ty(handle)},
@@ -71,260 +240,3171 @@ namespace tildac {
                 {"c32", llvm::Type::getInt32Ty(handle)},  {"f32", llvm::Type::getFloatTy(handle)},
                 {"f64", llvm::Type::getDoubleTy(handle)}, {"c8**", llvm::PointerType::get(llvm::PointerType::get(llvm::Type::getInt8Ty(handle), 0), 0)},
             };
+
+            // SIMD vectors are spelled as their element type followed by the number of lanes, e.g. f32x8.
+            // Every width is available on every target: vectors that are wider than the registers of the target,
+            // e.g. 256 bits on SSE or NEON, are split into several registers by the code generator.
+            for(char const* element: {"i8", "i16", "i32", "i64", "u8", "u16", "u32", "u64", "f32", "f64"}) {
+                llvm::Type* element_type = builtin_types[element];
+                for(unsigned const bits: {128u, 256u, 512u}) {
+                    unsigned const lanes = bits / element_type->getScalarSizeInBits();
+                    builtin_types[element + ('x' + std::to_string(lanes))] = llvm::VectorType::get(element_type, lanes);
+                }
+            }
         }
     };
 
     static void emit_compile_error(const std::string& msg) {
-        llvm::errs() << msg;
+        llvm::errs() << msg << '\n';
+    }
+
+    // Errors in the program let the compilation fail once the module has been generated.
+    static void emit_compile_error(Compiler_Context& context, const std::string& msg) {
+        context.error_count += 1;
+        emit_compile_error(msg);
     }
 
     static bool is_block_terminated(llvm::BasicBlock* block) {
-        return block->getInstList().back().isTerminator();
+        return block->getTerminator() != nullptr;
     }
 
     static llvm::Type* acquire_llvm_type(Compiler_Context& context, const Qualified_Type& type) {
+        if(auto iter = context.template_arguments.find(type.name); iter != context.template_arguments.end()) {
+            return iter->second.type;
+        }
+
         return context.builtin_types[type.name];
     }
 
+    // Slices are the pointer to their first element and their number of elements.
+    static llvm::StructType* get_slice_type(Compiler_Context& context, llvm::Type* element_type) {
+        return llvm::StructType::get(context.handle, {element_type->getPointerTo(), llvm::Type::getInt64Ty(context.handle)});
+    }
+
+    // The language has no structures yet, so every literal structure is a slice.
+    static bool is_slice_type(llvm::Type* type) {
+        return type->isStructTy() && llvm::cast<llvm::StructType>(type)->isLiteral();
+    }
+
+    static i64 get_lane_count(llvm::Type* vector_type) {
+        return static_cast<i64>(llvm::cast<llvm::VectorType>(vector_type)->getNumElements());
+    }
+
+    static llvm::Type* acquire_llvm_type(Compiler_Context& context, const Type& type);
+
+    static llvm::Type* acquire_llvm_type(Compiler_Context& context, const Array_Type& type) {
+        llvm::Type* element_type = acquire_llvm_type(context, *type.element_type);
+        if(!element_type) {
+            return nullptr;
+        }
+
+        if(element_type->isVoidTy()) {
+            emit_compile_error(context, "Arrays of void are not allowed");
+            return nullptr;
+        }
+
+        if(type.size < 0) {
+            return get_slice_type(context, element_type);
+        }
+        return llvm::ArrayType::get(element_type, static_cast<u64>(type.size));
+    }
+
     static llvm::Type* acquire_llvm_type(Compiler_Context& context, const Type& type) {
         switch(type.node_type) {
             case AST_Node_Type::qualified_type: {
                 return acquire_llvm_type(context, static_cast<const Qualified_Type&>(type));
             }
 
+            case AST_Node_Type::array_type: {
+                return acquire_llvm_type(context, static_cast<const Array_Type&>(type));
+            }
+
+            case AST_Node_Type::template_id: {
+                emit_compile_error(context, "Templated types are not supported");
+                return nullptr;
+            }
+
             default:
                 return nullptr;
         }
     }
 
-    static llvm::AllocaInst* make_variable_alloca(Compiler_Context& context, const Variable_Declaration& variable) {
-        const std::string& name = variable.identifier->name;
-        llvm::Type* type = acquire_llvm_type(context, *variable.type);
-        llvm::AllocaInst* alloca = context.builder.CreateAlloca(type, nullptr, name);
-        context.symbol_table.back()[name] = alloca;
-        return alloca;
-    }
+    // Resolves a template argument as written in the source to its canonical spelling and llvm type.
+    // Template parameters of the instance that is currently being lowered are substituted,
+    // so `f<T>` inside of `g<u64>` refers to the same instance as `f<u64>`.
+    static bool resolve_template_argument(Compiler_Context& context, const Type& type, Template_Argument& out) {
+        if(type.node_type != AST_Node_Type::qualified_type) {
+            emit_compile_error(context, "Templated types are not supported");
+            return false;
+        }
 
-    static llvm::Value* generate_expression(Compiler_Context& context, const Expression& expression);
+        const std::string& name = static_cast<const Qualified_Type&>(type).name;
+        if(auto iter = context.template_arguments.find(name); iter != context.template_arguments.end()) {
+            out = iter->second;
+            return true;
+        }
 
-    static llvm::Value* generate_literal_expression(Compiler_Context& context, const Integer_Literal& expression) {
-        return llvm::ConstantInt::get(llvm::Type::getInt32Ty(context.handle), std::stoull(expression.value));
-    }
+        if(auto iter = context.builtin_types.find(name); iter != context.builtin_types.end()) {
+            out = Template_Argument{name, iter->second};
+            return true;
+        }
 
-    static llvm::Value* generate_identifier_expression(Compiler_Context& context, const Identifier& identifier) {
-        const auto variable = context.symbol_table.back().at(identifier.name);
-        return context.builder.CreateLoad(variable->getAllocatedType(), variable);
+        emit_compile_error(context, "Unknown type \"" + name + "\" used as template argument");
+        return false;
     }
 
-    static llvm::Value* generate_binary_expression(Compiler_Context& context, const Binary_Expression& expression) {
-        auto lhs = generate_expression(context, *expression.lhs);
-        auto rhs = generate_expression(context, *expression.rhs);
-        switch(expression.op) {
-            case Operator::binary_add: {
-                return context.builder.CreateAdd(lhs, rhs);
-            }
+    // Binds the template arguments to the template parameters and builds the canonical name of the instance.
+    static bool bind_template_arguments(Compiler_Context& context, const std::string& name, const Template_Parameter_List& parameters,
+                                        const Template_Argument_List& arguments, Template_Arguments& bound, std::string& instance_name) {
+        if(parameters.size() != arguments.size()) {
+            emit_compile_error(context, "Template \"" + name + "\" expects " + std::to_string(parameters.size()) + " template arguments, but " +
+                               std::to_string(arguments.size()) + " were provided");
+            return false;
+        }
 
-            case Operator::binary_sub: {
-                return context.builder.CreateSub(lhs, rhs);
+        instance_name = name + '<';
+        for(i64 i = 0; i < arguments.size(); ++i) {
+            Template_Argument argument;
+            if(!resolve_template_argument(context, *arguments.arguments[i], argument)) {
+                return false;
             }
 
-            case Operator::binary_mul: {
-                return context.builder.CreateMul(lhs, rhs);
+            if(i != 0) {
+                instance_name += ", ";
             }
+            instance_name += argument.canonical_name;
+            bound[parameters.parameters[i]->name] = std::move(argument);
+        }
+        instance_name += '>';
+        return true;
+    }
 
-            case Operator::binary_div: {
-                return context.builder.CreateSDiv(lhs, rhs);
-            }
+    static void set_instance_linkage(Compiler_Context& context, llvm::GlobalObject& instance) {
+        if(!context.options.deduplicate_instantiations) {
+            instance.setLinkage(llvm::GlobalValue::InternalLinkage);
+            return;
+        }
 
-            case Operator::binary_eq: {
-                return context.builder.CreateICmpEQ(lhs, rhs);
-            }
+        instance.setLinkage(llvm::GlobalValue::LinkOnceODRLinkage);
+        // MachO has no comdats. linkonce_odr alone is enough for the linker to coalesce the instances there.
+        if(llvm::Triple(context.module->getTargetTriple()).supportsCOMDAT()) {
+            instance.setComdat(context.module->getOrInsertComdat(instance.getName()));
+        }
+    }
+
+    static llvm::FunctionType* get_function_type(Compiler_Context& context, const Function_Declaration& node) {
+        std::vector<llvm::Type*> arguments{};
+        for(const auto& parameter: node.parameter_list->params) {
+            arguments.emplace_back(acquire_llvm_type(context, *parameter->type));
+        }
+        return llvm::FunctionType::get(acquire_llvm_type(context, *node.return_type), arguments, false);
+    }
+
+    static bool is_unsigned_type(Compiler_Context& context, const Type& type);
+
+    static llvm::Function* declare_function(Compiler_Context& context, const Function_Declaration& node, const std::string& name) {
+        llvm::FunctionType* function_type = get_function_type(context, node);
+        llvm::Function* function = llvm::Function::Create(function_type, llvm::Function::ExternalLinkage, name, *context.module);
+        if(is_unsigned_type(context, *node.return_type)) {
+            context.unsigned_objects.insert(function);
+        }
+        // The optimizer queries the subtarget through the function attributes, not the target machine.
+        function->addFnAttr("target-cpu", context.target_machine.getTargetCPU());
+        if(!context.target_machine.getTargetFeatureString().empty()) {
+            function->addFnAttr("target-features", context.target_machine.getTargetFeatureString());
+        }
+
+        switch(context.options.optimization_level) {
+            case Optimization_Level::O0: {
+                // Keeps the function unoptimized even if it is later run through a pipeline, e.g. during LTO.
+                function->addFnAttr(llvm::Attribute::OptimizeNone);
+                function->addFnAttr(llvm::Attribute::NoInline);
+            } break;
+
+            case Optimization_Level::Oz: {
+                function->addFnAttr(llvm::Attribute::MinSize);
+                function->addFnAttr(llvm::Attribute::OptimizeForSize);
+            } break;
+
+            case Optimization_Level::Os: {
+                function->addFnAttr(llvm::Attribute::OptimizeForSize);
+            } break;
 
             default:
-                return nullptr;
+                break;
         }
+        return function;
     }
 
-    static llvm::Value* generate_function_call_expression(Compiler_Context& context, const Function_Call_Expression& expression) {
-        llvm::Function* function = context.module.getFunction(expression.identifier->name);
-        if(!function) {
-            emit_compile_error("Undefined function: \"" + expression.identifier->name + "\" referenced");
+    static llvm::GlobalVariable* define_global_variable(Compiler_Context& context, const Variable_Declaration& declaration, const std::string& name);
+
+    static llvm::Function* instantiate_function(Compiler_Context& context, const std::string& name, const Template_Argument_List& arguments) {
+        auto template_iter = context.function_templates.find(name);
+        if(template_iter == context.function_templates.end()) {
+            emit_compile_error(context, "\"" + name + "\" is not a function template");
+            return nullptr;
         }
 
-        std::vector<llvm::Value*> arguments{};
-        for(const auto& argument: expression.arg_list->arguments) {
-            arguments.emplace_back(generate_expression(context, *argument));
+        const Function_Declaration& declaration = *template_iter->second;
+        Template_Arguments bound;
+        std::string instance_name;
+        if(!bind_template_arguments(context, name, *declaration.template_parameters, arguments, bound, instance_name)) {
+            return nullptr;
         }
 
-        return context.builder.CreateCall(function, arguments);
+        if(auto iter = context.template_instances.find(instance_name); iter != context.template_instances.end()) {
+            return llvm::cast<llvm::Function>(iter->second);
+        }
+
+        Template_Arguments enclosing_arguments = std::exchange(context.template_arguments, bound);
+        llvm::Function* function = declare_function(context, declaration, instance_name);
+        context.template_arguments = std::move(enclosing_arguments);
+        set_instance_linkage(context, *function);
+        context.template_instances.emplace(instance_name, function);
+        context.pending_instantiations.push_back(Pending_Instantiation{&declaration, function, std::move(bound)});
+        return function;
     }
 
-    static llvm::Value* generate_expression(Compiler_Context& context, const Expression& expression) {
-        switch(expression.node_type) {
-            case AST_Node_Type::integer_literal: {
-                return generate_literal_expression(context, static_cast<const Integer_Literal&>(expression));
-            }
+    static llvm::GlobalVariable* instantiate_variable(Compiler_Context& context, const std::string& name, const Template_Argument_List& arguments) {
+        auto template_iter = context.variable_templates.find(name);
+        if(template_iter == context.variable_templates.end()) {
+            emit_compile_error(context, "\"" + name + "\" is not a variable template");
+            return nullptr;
+        }
 
-            case AST_Node_Type::binary_expression: {
-                return generate_binary_expression(context, static_cast<const Binary_Expression&>(expression));
-            }
+        const Variable_Declaration& declaration = *template_iter->second;
+        Template_Arguments bound;
+        std::string instance_name;
+        if(!bind_template_arguments(context, name, *declaration.template_parameters, arguments, bound, instance_name)) {
+            return nullptr;
+        }
 
-            case AST_Node_Type::identifier_expression: {
-                return generate_identifier_expression(context, *static_cast<const Identifier_Expression&>(expression).identifier);
-            }
+        if(auto iter = context.template_instances.find(instance_name); iter != context.template_instances.end()) {
+            return llvm::cast<llvm::GlobalVariable>(iter->second);
+        }
 
-            case AST_Node_Type::function_call_expression: {
-                return generate_function_call_expression(context, static_cast<const Function_Call_Expression&>(expression));
-            }
-            default:
-                return nullptr;
+        // Variable instances are constant-initialized, hence we may define them right away.
+        Template_Arguments enclosing_arguments = std::exchange(context.template_arguments, std::move(bound));
+        llvm::GlobalVariable* variable = define_global_variable(context, declaration, instance_name);
+        context.template_arguments = std::move(enclosing_arguments);
+        if(!variable) {
+            return nullptr;
         }
+
+        set_instance_linkage(context, *variable);
+        context.template_instances.emplace(instance_name, variable);
+        return variable;
     }
 
-    static void generate_statement(Compiler_Context& context, const Statement& statement);
+    // Returns the index of the first declaration of the function or global variable if it is visible
+    // to the unit that is being lowered, otherwise -1.
+    static i64 find_unit_declaration(Compiler_Context& context, const std::string& name, AST_Node_Type const type) {
+        if(!context.unit_declarations) {
+            return -1;
+        }
 
-    static void generate_if_statement(Compiler_Context& context, const If_Statement& statement) {
-        auto condition = generate_expression(context, *statement.condition);
-        auto function = context.builder.GetInsertBlock()->getParent();
+        auto iter = context.unit_declarations->declarations.find(name);
+        if(iter == context.unit_declarations->declarations.end()) {
+            return -1;
+        }
 
-        llvm::BasicBlock* true_block = llvm::BasicBlock::Create(context.handle, "", function);
-        llvm::BasicBlock* false_block = llvm::BasicBlock::Create(context.handle, "", function);
-        llvm::BasicBlock* merge_block = llvm::BasicBlock::Create(context.handle, "", function);
+        i64 const index = iter->second.front();
+        if(index >= context.visible_declarations || context.unit_declarations->nodes[index]->node_type != type) {
+            return -1;
+        }
+        return index;
+    }
 
-        context.builder.CreateCondBr(condition, true_block, merge_block);
-        context.builder.SetInsertPoint(true_block);
-        generate_statement(context, *statement.block);
-        if(!is_block_terminated(true_block)) {
-            context.builder.CreateBr(merge_block);
+    static llvm::Function* find_function(Compiler_Context& context, const std::string& name) {
+        if(llvm::Function* function = context.module->getFunction(name)) {
+            return function;
         }
 
-        context.builder.SetInsertPoint(false_block);
-        if(statement.else_block) {
-            generate_statement(context, *statement.else_block);
-            return;
+        i64 const index = find_unit_declaration(context, name, AST_Node_Type::function_declaration);
+        if(index == -1) {
+            return nullptr;
         }
-        if(!is_block_terminated(false_block)) {
-            context.builder.CreateBr(merge_block);
+        return declare_function(context, static_cast<const Function_Declaration&>(*context.unit_declarations->nodes[index]), name);
+    }
+
+    static llvm::GlobalVariable* find_global_variable(Compiler_Context& context, const std::string& name) {
+        if(llvm::GlobalVariable* variable = context.module->getNamedGlobal(name)) {
+            return variable;
         }
-        context.builder.SetInsertPoint(merge_block);
-        if(statement.else_if) {
-            generate_if_statement(context, *statement.else_if);
+
+        i64 const index = find_unit_declaration(context, name, AST_Node_Type::variable_declaration);
+        if(index == -1) {
+            return nullptr;
+        }
+
+        auto& declaration = static_cast<const Variable_Declaration&>(*context.unit_declarations->nodes[index]);
+        llvm::Type* type = acquire_llvm_type(context, *declaration.type);
+        if(!type) {
+            return nullptr;
+        }
+
+        auto* variable = new llvm::GlobalVariable(*context.module, type, true, llvm::GlobalValue::ExternalLinkage, nullptr, name);
+        if(is_unsigned_type(context, *declaration.type)) {
+            context.unsigned_objects.insert(variable);
         }
+        return variable;
     }
 
-    static void generate_return_statement(Compiler_Context& context, const Return_Statement& statement) {
-        if(!statement.expression) {
-            context.builder.CreateRetVoid();
+    static bool is_sealed(Compiler_Context& context, llvm::BasicBlock* block) {
+        return context.sealed_blocks.count(block);
+    }
+
+    static void write_variable(Variable& variable, llvm::BasicBlock* block, llvm::Value* value) {
+        variable.definitions[block] = value;
+    }
+
+    static llvm::PHINode* create_phi(Variable& variable, llvm::BasicBlock* block) {
+        if(block->empty()) {
+            return llvm::PHINode::Create(variable.type, 0, variable.name, block);
         } else {
-            context.builder.CreateRet(generate_expression(context, *statement.expression));
+            return llvm::PHINode::Create(variable.type, 0, variable.name, &block->front());
         }
     }
 
-    static void generate_variable_declaration(Compiler_Context& context, const Variable_Declaration& declaration) {
-        auto variable = make_variable_alloca(context, declaration);
-        if(declaration.initializer) {
-            context.builder.CreateStore(generate_expression(context, *declaration.initializer), variable);
+    // A phi is trivial if it merges only itself and one other value. Such a phi is replaced by that value,
+    // which may in turn make the phis that use it trivial.
+    static llvm::Value* try_remove_trivial_phi(Compiler_Context& context, llvm::PHINode* phi) {
+        llvm::Value* same = nullptr;
+        for(llvm::Value* operand: phi->incoming_values()) {
+            if(operand == same || operand == phi) {
+                continue;
+            }
+
+            if(same) {
+                return phi;
+            }
+            same = operand;
+        }
+
+        if(!same) {
+            // The phi is unreachable or in the entry block.
+            same = llvm::UndefValue::get(phi->getType());
+        }
+
+        llvm::SmallVector<llvm::WeakVH, 8> users;
+        for(llvm::User* user: phi->users()) {
+            if(user != phi && llvm::isa<llvm::PHINode>(user)) {
+                users.emplace_back(user);
+            }
+        }
+
+        // The removal of the users below may replace same as well.
+        llvm::WeakTrackingVH result = same;
+        phi->replaceAllUsesWith(same);
+        phi->eraseFromParent();
+        for(llvm::WeakVH& user: users) {
+            // Phis in unsealed blocks are still missing their operands.
+            auto user_phi = llvm::dyn_cast_or_null<llvm::PHINode>(static_cast<llvm::Value*>(user));
+            if(user_phi && is_sealed(context, user_phi->getParent())) {
+                try_remove_trivial_phi(context, user_phi);
+            }
         }
+        return result;
     }
 
-    static void generate_statement_list(Compiler_Context& context, const Statement_List& node) {
-        for(const auto& statement: node.statements) {
-            generate_statement(context, *statement);
+    static llvm::Value* read_variable(Compiler_Context& context, Variable& variable, llvm::BasicBlock* block);
+
+    static llvm::Value* add_phi_operands(Compiler_Context& context, Variable& variable, llvm::PHINode* phi) {
+        for(llvm::BasicBlock* predecessor: llvm::predecessors(phi->getParent())) {
+            phi->addIncoming(read_variable(context, variable, predecessor), predecessor);
         }
+        return try_remove_trivial_phi(context, phi);
     }
 
-    static void generate_statement(Compiler_Context& context, const Statement& statement) {
-        switch(statement.node_type) {
-            case AST_Node_Type::if_statement: {
-                return generate_if_statement(context, static_cast<const If_Statement&>(statement));
-            }
+    static llvm::Value* read_variable_recursive(Compiler_Context& context, Variable& variable, llvm::BasicBlock* block) {
+        llvm::Value* value = nullptr;
+        if(!is_sealed(context, block)) {
+            llvm::PHINode* phi = create_phi(variable, block);
+            context.incomplete_phis[block].emplace_back(&variable, phi);
+            value = phi;
+        } else if(llvm::BasicBlock* predecessor = block->getSinglePredecessor()) {
+            value = read_variable(context, variable, predecessor);
+        } else if(llvm::pred_empty(block)) {
+            // Only unreachable code reads variables in blocks without predecessors.
+            value = llvm::UndefValue::get(variable.type);
+        } else {
+            // Write the phi before reading the predecessors to break cycles.
+            llvm::PHINode* phi = create_phi(variable, block);
+            write_variable(variable, block, phi);
+            value = add_phi_operands(context, variable, phi);
+        }
+        write_variable(variable, block, value);
+        return value;
+    }
 
-            case AST_Node_Type::return_statement: {
-                return generate_return_statement(context, static_cast<const Return_Statement&>(statement));
+    static llvm::Value* read_variable(Compiler_Context& context, Variable& variable, llvm::BasicBlock* block) {
+        if(auto iter = variable.definitions.find(block); iter != variable.definitions.end() && iter->second) {
+            return iter->second;
+        }
+        return read_variable_recursive(context, variable, block);
+    }
+
+    // Must be called once all predecessors of the block have been generated.
+    static void seal_block(Compiler_Context& context, llvm::BasicBlock* block) {
+        if(auto iter = context.incomplete_phis.find(block); iter != context.incomplete_phis.end()) {
+            std::vector<std::pair<Variable*, llvm::PHINode*>> phis = std::move(iter->second);
+            context.incomplete_phis.erase(iter);
+            for(auto [variable, phi]: phis) {
+                add_phi_operands(context, *variable, phi);
             }
+        }
+        context.sealed_blocks.insert(block);
+    }
 
-            case AST_Node_Type::declaration_statement: {
-                return generate_variable_declaration(context, *static_cast<const Declaration_Statement&>(statement).var_decl);
+    // Code following a return is unreachable, but it still has to be generated into some block.
+    static void start_unreachable_block(Compiler_Context& context) {
+        llvm::Function* function = context.builder.GetInsertBlock()->getParent();
+        llvm::BasicBlock* block = llvm::BasicBlock::Create(context.handle, "unreachable", function);
+        seal_block(context, block);
+        context.builder.SetInsertPoint(block);
+    }
+
+    // Only values that do not fit in registers, i.e. arrays and slices, need memory. Everything else,
+    // including mutable variables, is kept in SSA form. The language has no means of taking an address yet.
+    static bool requires_stack_slot(llvm::Type* type) {
+        return !type->isSingleValueType();
+    }
+
+    static bool describes_variables(Compiler_Context& context) {
+        return context.debug_builder && context.options.debug_info == Debug_Info_Level::full;
+    }
+
+    // Instructions that are created from here on are attributed to the node.
+    static void set_debug_location(Compiler_Context& context, const AST_Node& node) {
+        if(context.debug_builder) {
+            // Lines and columns of the source info start at 0, those of DWARF at 1.
+            const Source_Info& source_info = node.source_info;
+            context.builder.SetCurrentDebugLocation(llvm::DILocation::get(context.handle, static_cast<unsigned>(source_info.line + 1),
+                                                                          static_cast<unsigned>(source_info.column + 1), context.debug_scopes.back()));
+        }
+    }
+
+    // Variables that are declared within the node are shown by the debugger only within the node.
+    static void push_debug_scope(Compiler_Context& context, const AST_Node& node) {
+        if(describes_variables(context)) {
+            const Source_Info& source_info = node.source_info;
+            context.debug_scopes.push_back(context.debug_builder->createLexicalBlock(context.debug_scopes.back(), context.debug_file,
+                                                                                     static_cast<unsigned>(source_info.line + 1),
+                                                                                     static_cast<unsigned>(source_info.column + 1)));
+        }
+    }
+
+    static void pop_debug_scope(Compiler_Context& context) {
+        if(describes_variables(context)) {
+            context.debug_scopes.pop_back();
+        }
+    }
+
+    // Integer types are signed, unsigned or characters by their first letter. Pointers are spelled
+    // as their pointee followed by `*`. void has no type and is nullptr.
+    static llvm::DIType* get_debug_type(Compiler_Context& context, const std::string& name) {
+        if(auto iter = context.debug_types.find(name); iter != context.debug_types.end()) {
+            return iter->second;
+        }
+
+        llvm::DIType* type = nullptr;
+        if(name.size() != 0 && name.back() == '*') {
+            llvm::DIType* pointee = get_debug_type(context, name.substr(0, name.size() - 1));
+            type = context.debug_builder->createPointerType(pointee, context.module->getDataLayout().getPointerSizeInBits());
+        } else if(auto iter = context.builtin_types.find(name); iter != context.builtin_types.end() && iter->second->isVectorTy()) {
+            // Vectors are spelled as their element type followed by `x` and the number of lanes.
+            llvm::DIType* element_type = get_debug_type(context, name.substr(0, name.find('x')));
+            llvm::Type* vector_type = iter->second;
+            const llvm::DataLayout& layout = context.module->getDataLayout();
+            llvm::Metadata* subrange = context.debug_builder->getOrCreateSubrange(0, get_lane_count(vector_type));
+            type = context.debug_builder->createVectorType(layout.getTypeAllocSizeInBits(vector_type),
+                                                           static_cast<unsigned>(layout.getABITypeAlignment(vector_type) * 8), element_type,
+                                                           context.debug_builder->getOrCreateArray(subrange));
+        } else if(name == "bool") {
+            type = context.debug_builder->createBasicType(name, 8, llvm::dwarf::DW_ATE_boolean);
+        } else if(auto iter = context.builtin_types.find(name); iter != context.builtin_types.end() && name != "void") {
+            unsigned encoding = llvm::dwarf::DW_ATE_UTF;
+            if(name[0] == 'i') {
+                encoding = llvm::dwarf::DW_ATE_signed;
+            } else if(name[0] == 'u') {
+                encoding = llvm::dwarf::DW_ATE_unsigned;
+            } else if(name[0] == 'f') {
+                encoding = llvm::dwarf::DW_ATE_float;
+            } else if(name == "c8") {
+                encoding = llvm::dwarf::DW_ATE_unsigned_char;
             }
+            type = context.debug_builder->createBasicType(name, iter->second->getScalarSizeInBits(), encoding);
+        }
+        context.debug_types.emplace(name, type);
+        return type;
+    }
 
-            case AST_Node_Type::block_statement: {
-                return generate_statement_list(context, *static_cast<const Block_Statement&>(statement).statements);
+    // The type as it is spelled in the source with the template parameters substituted. Empty for template ids.
+    static std::string get_type_spelling(Compiler_Context& context, const Type& type) {
+        if(type.node_type == AST_Node_Type::array_type) {
+            auto& array_type = static_cast<const Array_Type&>(type);
+            std::string const element_type = get_type_spelling(context, *array_type.element_type);
+            if(element_type.size() == 0) {
+                return "";
             }
+            return element_type + '[' + (array_type.size >= 0 ? std::to_string(array_type.size) : "") + ']';
+        }
 
-            default:
-                return;
+        if(type.node_type != AST_Node_Type::qualified_type) {
+            return "";
+        }
+
+        const std::string& name = static_cast<const Qualified_Type&>(type).name;
+        if(auto iter = context.template_arguments.find(name); iter != context.template_arguments.end()) {
+            return iter->second.canonical_name;
         }
+        return name;
     }
 
-    static void generate_function(Compiler_Context& context, const Function_Declaration& node) {
-        std::vector<llvm::Type*> arguments{};
-        for(const auto& parameter: node.parameter_list->params) {
-            arguments.emplace_back(acquire_llvm_type(context, *parameter->type));
+    // Unsigned integers, characters and bool are zero-extended and are divided and compared as unsigned.
+    // Arrays, slices and vectors have the signedness of their elements.
+    static bool is_unsigned_type(Compiler_Context& context, const Type& type) {
+        std::string const spelling = get_type_spelling(context, type);
+        std::string const element = spelling.substr(0, spelling.find('['));
+        if(!context.builtin_types.count(element) || element.back() == '*') {
+            return false;
         }
-        auto function_type = llvm::FunctionType::get(acquire_llvm_type(context, *node.return_type), arguments, false);
-        auto function = llvm::Function::Create(function_type, llvm::Function::ExternalLinkage, node.name->name, context.module);
-        auto block = llvm::BasicBlock::Create(context.handle, "", function);
-        context.builder.SetInsertPoint(block);
-        context.symbol_table.emplace_back();
-        u64 arg_idx = 0;
-        for(auto& arg: function->args()) {
-            arg.setName(node.parameter_list->params[arg_idx++]->identifier->name);
-            llvm::IRBuilder<> param_builder(&function->getEntryBlock(), function->getEntryBlock().begin());
-            auto param_alloca = param_builder.CreateAlloca(arg.getType(), nullptr, arg.getName());
-            context.symbol_table.back()[arg.getName()] = param_alloca;
-            param_builder.CreateStore(&arg, param_alloca);
+        return element[0] == 'u' || element[0] == 'c' || element == "bool";
+    }
+
+    static llvm::DIType* get_debug_type(Compiler_Context& context, const Type& type);
+
+    // Slices are described as a structure of the pointer to their elements and their size.
+    static llvm::DIType* get_debug_type(Compiler_Context& context, const Array_Type& type, const std::string& name) {
+        llvm::Type* llvm_type = acquire_llvm_type(context, type);
+        llvm::DIType* element_type = get_debug_type(context, *type.element_type);
+        if(!llvm_type || !element_type) {
+            return nullptr;
         }
-        generate_statement_list(context, *node.body->statements);
-        context.symbol_table.pop_back();
+
+        const llvm::DataLayout& layout = context.module->getDataLayout();
+        u64 const size = layout.getTypeAllocSizeInBits(llvm_type);
+        auto const alignment = static_cast<unsigned>(layout.getABITypeAlignment(llvm_type) * 8);
+        if(type.size >= 0) {
+            llvm::Metadata* subrange = context.debug_builder->getOrCreateSubrange(0, type.size);
+            return context.debug_builder->createArrayType(size, alignment, element_type, context.debug_builder->getOrCreateArray(subrange));
+        }
+
+        llvm::StructType* slice_type = llvm::cast<llvm::StructType>(llvm_type);
+        const llvm::StructLayout* slice_layout = layout.getStructLayout(slice_type);
+        llvm::DIType* member_types[] = {
+            context.debug_builder->createPointerType(element_type, layout.getPointerSizeInBits()),
+            get_debug_type(context, "i64"),
+        };
+        char const* const member_names[] = {"data", "size"};
+        llvm::Metadata* members[2];
+        for(unsigned i = 0; i < 2; ++i) {
+            llvm::Type* member_type = slice_type->getElementType(i);
+            members[i] = context.debug_builder->createMemberType(context.debug_file, member_names[i], context.debug_file, 0,
+                                                                layout.getTypeAllocSizeInBits(member_type),
+                                                                static_cast<unsigned>(layout.getABITypeAlignment(member_type) * 8),
+                                                                slice_layout->getElementOffsetInBits(i), llvm::DINode::FlagZero, member_types[i]);
+        }
+        return context.debug_builder->createStructType(context.debug_file, name, context.debug_file, 0, size, alignment, llvm::DINode::FlagZero, nullptr,
+                                                       context.debug_builder->getOrCreateArray(members));
     }
 
-    static void generate_node(Compiler_Context& context, const AST_Node& node) {
-        switch(node.node_type) {
-            case AST_Node_Type::function_declaration: {
-                generate_function(context, static_cast<const Function_Declaration&>(node));
-            } break;
+    static llvm::DIType* get_debug_type(Compiler_Context& context, const Type& type) {
+        std::string const name = get_type_spelling(context, type);
+        if(name.size() == 0) {
+            return nullptr;
+        } else if(type.node_type != AST_Node_Type::array_type) {
+            return get_debug_type(context, name);
+        }
 
-            default:
-                return;
+        // Arrays and slices are cached by their spelling like all other types.
+        if(auto iter = context.debug_types.find(name); iter != context.debug_types.end()) {
+            return iter->second;
         }
+
+        llvm::DIType* debug_type = get_debug_type(context, static_cast<const Array_Type&>(type), name);
+        context.debug_types.emplace(name, debug_type);
+        return debug_type;
     }
 
-    void generate(const std::vector<Owning_Ptr<AST_Node>>& nodes, const bool optimize) {
-        Compiler_Context context{};
+    // Adds the variable to the current scope of the debug info. argument_number starts at 1 for parameters
+    // and is 0 for local variables. Variables in stack slots are described by their slot, all other
+    // variables by the values that are stored to them.
+    static void describe_variable(Compiler_Context& context, Variable& variable, const AST_Node& declaration, const Type& type,
+                                  i64 const argument_number) {
+        if(!describes_variables(context)) {
+            return;
+        }
 
-        for(const auto& node: nodes) {
-            generate_node(context, *node);
+        llvm::DIScope* scope = context.debug_scopes.back();
+        unsigned const line = static_cast<unsigned>(declaration.source_info.line + 1);
+        llvm::DIType* debug_type = get_debug_type(context, type);
+        // Optimizations may remove every use of a variable. It is kept in the debug info anyway.
+        bool const preserve = context.options.optimization_level != Optimization_Level::O0;
+        if(argument_number != 0) {
+            variable.debug_variable =
+                context.debug_builder->createParameterVariable(scope, variable.name, static_cast<unsigned>(argument_number), context.debug_file, line, debug_type, preserve);
+        } else {
+            variable.debug_variable = context.debug_builder->createAutoVariable(scope, variable.name, context.debug_file, line, debug_type, preserve);
+        }
+
+        if(variable.stack_slot) {
+            context.debug_builder->insertDeclare(variable.stack_slot, variable.debug_variable, context.debug_builder->createExpression(),
+                                                 context.builder.getCurrentDebugLocation(), context.builder.GetInsertBlock());
+        }
+    }
+
+    static llvm::AllocaInst* make_entry_alloca(Compiler_Context& context, llvm::Type* type, const std::string& name) {
+        // Allocas in the entry block are static and are not repeated in loops.
+        llvm::BasicBlock& entry_block = context.builder.GetInsertBlock()->getParent()->getEntryBlock();
+        llvm::IRBuilder<> entry_builder(&entry_block, entry_block.getFirstInsertionPt());
+        return entry_builder.CreateAlloca(type, nullptr, name);
+    }
+
+    static llvm::AllocaInst* make_variable_alloca(Compiler_Context& context, Variable& variable) {
+        variable.stack_slot = make_entry_alloca(context, variable.type, variable.name);
+        return variable.stack_slot;
+    }
+
+    static Variable* declare_variable(Compiler_Context& context, const std::string& name, llvm::Type* type, bool const is_mutable,
+                                      bool const is_unsigned) {
+        Variable* variable = new Variable{name, type, is_mutable, is_unsigned, nullptr, {}};
+        context.variables.emplace_back(variable);
+        context.symbol_table.back()[name] = variable;
+        return variable;
+    }
+
+    static Variable* find_variable(Compiler_Context& context, const std::string& name) {
+        for(auto scope = context.symbol_table.rbegin(), end = context.symbol_table.rend(); scope != end; ++scope) {
+            if(auto iter = scope->find(name); iter != scope->end()) {
+                return iter->second;
+            }
         }
+        return nullptr;
+    }
 
-        llvm::legacy::PassManager pass_manager{};
-        if(optimize) {
-            llvm::PassBuilder pass_builder;
-            llvm::LoopAnalysisManager loop_analysis_manager(false);
-            llvm::FunctionAnalysisManager function_analysis_manager(false);
-            llvm::CGSCCAnalysisManager CGSCC_analysis_manager(false);
-            llvm::ModuleAnalysisManager module_analysis_manager(false);
-            pass_builder.registerModuleAnalyses(module_analysis_manager);
-            pass_builder.registerCGSCCAnalyses(CGSCC_analysis_manager);
-            pass_builder.registerFunctionAnalyses(function_analysis_manager);
-            pass_builder.registerLoopAnalyses(loop_analysis_manager);
-            pass_builder.crossRegisterProxies(loop_analysis_manager, function_analysis_manager, CGSCC_analysis_manager, module_analysis_manager);
-            llvm::ModulePassManager module_pass_manager = pass_builder.buildPerModuleDefaultPipeline(llvm::PassBuilder::O3, false);
-            module_pass_manager.run(context.module, module_analysis_manager);
-
-            pass_manager.add(llvm::createInstructionCombiningPass());
-            pass_manager.add(llvm::createReassociatePass());
-            pass_manager.add(llvm::createGVNPass());
-            pass_manager.add(llvm::createCFGSimplificationPass());
-        }
-        // TODO: in-memory compilation and output to different files
-        std::error_code file_error_code;
-        llvm::raw_fd_ostream output("output.o", file_error_code, llvm::sys::fs::OF_None);
-        if(context.target_cpu->addPassesToEmitFile(pass_manager, output, nullptr, llvm::CGFT_ObjectFile)) {
-            throw std::runtime_error("Target platform doesn't support object files.");
-        }
-        pass_manager.run(context.module);
-        output.flush();
-
-        context.module.print(llvm::outs(), nullptr);
+    static llvm::Value* load_variable(Compiler_Context& context, Variable& variable) {
+        if(variable.stack_slot) {
+            return context.builder.CreateLoad(variable.type, variable.stack_slot, variable.name);
+        } else {
+            return read_variable(context, variable, context.builder.GetInsertBlock());
+        }
+    }
+
+    static void store_variable(Compiler_Context& context, Variable& variable, llvm::Value* value) {
+        if(variable.stack_slot) {
+            context.builder.CreateStore(value, variable.stack_slot);
+        } else {
+            write_variable(variable, context.builder.GetInsertBlock(), value);
+            if(variable.debug_variable) {
+                // Values that reach a block through phis are not described, so after a merge the debugger
+                // may show the variable as unavailable until its next store.
+                context.debug_builder->insertDbgValueIntrinsic(value, variable.debug_variable, context.debug_builder->createExpression(),
+                                                               context.builder.getCurrentDebugLocation(), context.builder.GetInsertBlock());
+            }
+        }
+    }
+
+    // Implicit conversions between integer types. Integer literals are i32 and have to be brought
+    // to the type of the variable, parameter or return value they initialize. Integers are extended
+    // by their signedness, is_unsigned, and also convert to floating-point types and those to each other,
+    // but never back to integers. Scalars convert to vectors by being splat into every lane, e.g. the 2
+    // in `v * 2`, and vectors convert lane-wise to vectors of the same number of lanes.
+    static llvm::Value* convert_value(Compiler_Context& context, llvm::Value* value, llvm::Type* type, bool const is_unsigned = false) {
+        if(!value || !type || value->getType() == type) {
+            return value;
+        }
+
+        llvm::Type* value_type = value->getType();
+        if(type->isVectorTy() && !value_type->isVectorTy()) {
+            llvm::Value* element = convert_value(context, value, type->getScalarType(), is_unsigned);
+            if(element->getType() != type->getScalarType()) {
+                return value;
+            }
+            return context.builder.CreateVectorSplat(static_cast<unsigned>(get_lane_count(type)), element);
+        }
+
+        if(value_type->isVectorTy() != type->isVectorTy() || (type->isVectorTy() && get_lane_count(value_type) != get_lane_count(type))) {
+            return value;
+        }
+
+        bool const is_signed = !is_unsigned && !value_type->isIntOrIntVectorTy(1);
+        if(value_type->isIntOrIntVectorTy() && type->isIntOrIntVectorTy()) {
+            return context.builder.CreateIntCast(value, type, is_signed);
+        } else if(value_type->isIntOrIntVectorTy() && type->isFPOrFPVectorTy()) {
+            return is_signed ? context.builder.CreateSIToFP(value, type) : context.builder.CreateUIToFP(value, type);
+        } else if(value_type->isFPOrFPVectorTy() && type->isFPOrFPVectorTy()) {
+            return context.builder.CreateFPCast(value, type);
+        }
+        return value;
+    }
+
+    static llvm::Value* generate_expression(Compiler_Context& context, const Expression& expression);
+    static bool is_unsigned(Compiler_Context& context, const Expression& expression);
+
+    static llvm::Value* generate_literal_expression(Compiler_Context& context, const Integer_Literal& expression) {
+        return llvm::ConstantInt::get(llvm::Type::getInt32Ty(context.handle), std::stoull(expression.value));
+    }
+
+    // Float literals are f64 unless they take the floating-point type of what they initialize or of the other operand,
+    // e.g. f32 in `x * 0.5` where x is f32. They are rounded to that type directly.
+    static llvm::Value* generate_float_literal(Compiler_Context& context, const Float_Literal& literal, llvm::Type* type) {
+        llvm::Type* literal_type = type && type->getScalarType()->isFloatingPointTy() ? type->getScalarType() : context.builder.getDoubleTy();
+        return llvm::ConstantFP::get(literal_type, literal.value);
+    }
+
+    // Generates an operand that is combined with or converted to a value of the type.
+    static llvm::Value* generate_operand(Compiler_Context& context, const Expression& expression, llvm::Type* type) {
+        if(expression.node_type == AST_Node_Type::float_literal) {
+            return generate_float_literal(context, static_cast<const Float_Literal&>(expression), type);
+        }
+        return generate_expression(context, expression);
+    }
+
+    static llvm::Value* generate_bool_literal_expression(Compiler_Context& context, const Bool_Literal& expression) {
+        return llvm::ConstantInt::getBool(context.handle, expression.value);
+    }
+
+    static llvm::Value* generate_identifier_expression(Compiler_Context& context, const Identifier_Expression& expression) {
+        const std::string& name = expression.identifier->name;
+        if(expression.template_arguments) {
+            llvm::GlobalVariable* instance = instantiate_variable(context, name, *expression.template_arguments);
+            if(!instance) {
+                return nullptr;
+            }
+            return context.builder.CreateLoad(instance->getValueType(), instance);
+        }
+
+        if(Variable* variable = find_variable(context, name)) {
+            return load_variable(context, *variable);
+        }
+
+        if(llvm::GlobalVariable* variable = find_global_variable(context, name)) {
+            return context.builder.CreateLoad(variable->getValueType(), variable);
+        }
+
+        if(context.variable_templates.count(name)) {
+            emit_compile_error(context, "Variable template \"" + name + "\" used without template arguments");
+        } else {
+            emit_compile_error(context, "Undefined variable: \"" + name + "\" referenced");
+        }
+        return nullptr;
+    }
+
+    // The elements of an array or of a slice. static_length is the number of elements of an array
+    // and -1 for slices, whose length is known only at run time.
+    struct Array_View {
+        llvm::Value* data = nullptr;
+        llvm::Value* length = nullptr;
+        llvm::Type* element_type = nullptr;
+        i64 static_length = -1;
+    };
+
+    static Array_View make_array_view(Compiler_Context& context, llvm::Value* array) {
+        auto* array_type = llvm::cast<llvm::ArrayType>(array->getType()->getPointerElementType());
+        Array_View view;
+        view.element_type = array_type->getElementType();
+        view.static_length = static_cast<i64>(array_type->getNumElements());
+        view.data = context.builder.CreateConstInBoundsGEP2_64(array_type, array, 0, 0);
+        view.length = context.builder.getInt64(static_cast<u64>(view.static_length));
+        return view;
+    }
+
+    static Array_View make_slice_view(Compiler_Context& context, llvm::Value* slice) {
+        Array_View view;
+        view.element_type = slice->getType()->getStructElementType(0)->getPointerElementType();
+        view.data = context.builder.CreateExtractValue(slice, 0);
+        view.length = context.builder.CreateExtractValue(slice, 1);
+        return view;
+    }
+
+    static llvm::Value* generate_element_pointer(Compiler_Context& context, const Index_Expression& expression, llvm::Type*& element_type,
+                                                 bool& is_read_only);
+
+    // Arrays that are held by variables are accessed in place. All other arrays, e.g. those returned by calls,
+    // are copied to a stack slot first. is_read_only is set if the elements are reached through a slice.
+    static bool generate_array_view(Compiler_Context& context, const Expression& expression, Array_View& view, bool& is_read_only) {
+        llvm::Value* value = nullptr;
+        if(expression.node_type == AST_Node_Type::identifier_expression) {
+            auto& identifier = static_cast<const Identifier_Expression&>(expression);
+            const std::string& name = identifier.identifier->name;
+            // Instances of variable templates are copied like any other value.
+            llvm::Value* array = nullptr;
+            if(!identifier.template_arguments) {
+                if(Variable* variable = find_variable(context, name)) {
+                    if(variable->stack_slot && variable->type->isArrayTy()) {
+                        array = variable->stack_slot;
+                    }
+                } else if(llvm::GlobalVariable* global = find_global_variable(context, name); global && global->getValueType()->isArrayTy()) {
+                    array = global;
+                }
+            }
+
+            if(array) {
+                view = make_array_view(context, array);
+                return true;
+            }
+        } else if(expression.node_type == AST_Node_Type::index_expression) {
+            // The rows of multidimensional arrays are accessed in place as well.
+            llvm::Type* element_type = nullptr;
+            llvm::Value* element = generate_element_pointer(context, static_cast<const Index_Expression&>(expression), element_type, is_read_only);
+            if(!element) {
+                return false;
+            }
+
+            if(element_type->isArrayTy()) {
+                view = make_array_view(context, element);
+                return true;
+            }
+            value = context.builder.CreateLoad(element_type, element);
+        }
+
+        if(!value) {
+            value = generate_expression(context, expression);
+            if(!value) {
+                return false;
+            }
+        }
+
+        if(value->getType()->isArrayTy()) {
+            llvm::AllocaInst* copy = make_entry_alloca(context, value->getType(), "array");
+            context.builder.CreateStore(value, copy);
+            view = make_array_view(context, copy);
+            return true;
+        } else if(is_slice_type(value->getType())) {
+            view = make_slice_view(context, value);
+            is_read_only = true;
+            return true;
+        } else {
+            emit_compile_error(context, "Expected an array or a slice");
+            return false;
+        }
+    }
+
+    // Out of bounds accesses and, with Overflow_Policy::trap, overflows trap. The check is weighted as almost never failing,
+    // which moves the trap out of the hot path and lets the optimizer remove the checks of loops that provably stay in bounds,
+    // see optimize_module. The names of the blocks start with name.
+    static void generate_check(Compiler_Context& context, llvm::Value* condition, llvm::StringRef const name) {
+        llvm::Function* function = context.builder.GetInsertBlock()->getParent();
+        llvm::BasicBlock* trap_block = llvm::BasicBlock::Create(context.handle, name + ".fail", function);
+        llvm::BasicBlock* continue_block = llvm::BasicBlock::Create(context.handle, name + ".ok", function);
+        context.builder.CreateCondBr(condition, continue_block, trap_block, llvm::MDBuilder(context.handle).createBranchWeights(2000, 1));
+        // Both blocks have a single predecessor.
+        seal_block(context, trap_block);
+        seal_block(context, continue_block);
+
+        context.builder.SetInsertPoint(trap_block);
+        context.builder.CreateCall(llvm::Intrinsic::getDeclaration(context.module.get(), llvm::Intrinsic::trap));
+        context.builder.CreateUnreachable();
+        context.builder.SetInsertPoint(continue_block);
+    }
+
+    // Indices are i64. Negative indices wrap around to values above any length.
+    static llvm::Value* generate_index(Compiler_Context& context, const Expression& expression) {
+        llvm::Value* index = generate_expression(context, expression);
+        if(!index) {
+            return nullptr;
+        }
+
+        if(!index->getType()->isIntegerTy() || index->getType()->isIntegerTy(1)) {
+            emit_compile_error(context, "Array index is not an integer");
+            return nullptr;
+        }
+        return convert_value(context, index, context.builder.getInt64Ty(), is_unsigned(context, expression));
+    }
+
+    // Constant indices into arrays are checked at compile time, all other indices at run time.
+    static llvm::Value* generate_element_pointer(Compiler_Context& context, const Index_Expression& expression, llvm::Type*& element_type,
+                                                 bool& is_read_only) {
+        Array_View view;
+        if(!generate_array_view(context, *expression.base, view, is_read_only)) {
+            return nullptr;
+        }
+
+        llvm::Value* index = generate_index(context, *expression.index);
+        if(!index) {
+            return nullptr;
+        }
+
+        auto* constant_index = llvm::dyn_cast<llvm::ConstantInt>(index);
+        if(constant_index && view.static_length >= 0) {
+            if(constant_index->getValue().uge(static_cast<u64>(view.static_length))) {
+                emit_compile_error(context, "Index " + std::to_string(constant_index->getSExtValue()) + " is out of bounds of an array of " +
+                                   std::to_string(view.static_length) + " elements");
+                return nullptr;
+            }
+        } else {
+            generate_check(context, context.builder.CreateICmpULT(index, view.length), "bounds");
+        }
+
+        element_type = view.element_type;
+        return context.builder.CreateInBoundsGEP(view.element_type, view.data, index);
+    }
+
+    static llvm::Value* generate_index_expression(Compiler_Context& context, const Index_Expression& expression) {
+        llvm::Type* element_type = nullptr;
+        bool is_read_only = false;
+        llvm::Value* element = generate_element_pointer(context, expression, element_type, is_read_only);
+        if(!element) {
+            return nullptr;
+        }
+        return context.builder.CreateLoad(element_type, element);
+    }
+
+    static llvm::Value* generate_expression_as(Compiler_Context& context, const Expression& expression, llvm::Type* type);
+
+    // The elements take the type of the first element unless the element type is given by the array
+    // that the literal initializes, e.g. `var a: i64[3] = [1, 2, 3];`.
+    static llvm::Value* generate_array_literal(Compiler_Context& context, const Array_Literal& literal, llvm::Type* element_type) {
+        std::vector<llvm::Value*> elements;
+        for(const auto& element_expression: literal.elements) {
+            llvm::Value* element = element_type ? generate_expression_as(context, *element_expression, element_type)
+                                                : generate_expression(context, *element_expression);
+            if(!element) {
+                return nullptr;
+            }
+
+            element_type = element->getType();
+            elements.push_back(element);
+        }
+
+        llvm::Value* array = llvm::UndefValue::get(llvm::ArrayType::get(element_type, elements.size()));
+        for(u64 i = 0; i < elements.size(); ++i) {
+            array = context.builder.CreateInsertValue(array, elements[i], static_cast<unsigned>(i));
+        }
+        return array;
+    }
+
+    // Generates the expression as a value of the type. Arrays convert to slices, which refer to the elements
+    // of the array in place. Array literals take the element type of the array or the slice that they initialize.
+    static llvm::Value* generate_expression_as(Compiler_Context& context, const Expression& expression, llvm::Type* type) {
+        if(!type || !type->isAggregateType()) {
+            llvm::Value* value = generate_operand(context, expression, type);
+            value = value ? convert_value(context, value, type, is_unsigned(context, expression)) : nullptr;
+            if(value && type && value->getType() != type) {
+                emit_compile_error(context, "Value cannot be converted implicitly to the expected type");
+                return nullptr;
+            }
+            return value;
+        }
+
+        bool const is_literal = expression.node_type == AST_Node_Type::array_literal;
+        if(type->isArrayTy()) {
+            llvm::Value* value = nullptr;
+            if(is_literal) {
+                auto& literal = static_cast<const Array_Literal&>(expression);
+                if(literal.elements.size() != type->getArrayNumElements()) {
+                    emit_compile_error(context, "Array literal has " + std::to_string(literal.elements.size()) + " elements, but the array has " +
+                                       std::to_string(type->getArrayNumElements()));
+                    return nullptr;
+                }
+                value = generate_array_literal(context, literal, type->getArrayElementType());
+            } else {
+                value = generate_expression(context, expression);
+            }
+
+            if(value && value->getType() != type) {
+                emit_compile_error(context, "Array cannot be converted to an array of another size or element type");
+                return nullptr;
+            }
+            return value;
+        }
+
+        llvm::Type* element_type = type->getStructElementType(0)->getPointerElementType();
+        Array_View view;
+        bool is_read_only = false;
+        if(is_literal) {
+            llvm::Value* value = generate_array_literal(context, static_cast<const Array_Literal&>(expression), element_type);
+            if(!value) {
+                return nullptr;
+            }
+
+            llvm::AllocaInst* copy = make_entry_alloca(context, value->getType(), "array");
+            context.builder.CreateStore(value, copy);
+            view = make_array_view(context, copy);
+        } else if(!generate_array_view(context, expression, view, is_read_only)) {
+            return nullptr;
+        }
+
+        if(view.element_type != element_type) {
+            emit_compile_error(context, "Slice cannot refer to elements of another type");
+            return nullptr;
+        }
+
+        llvm::Value* slice = llvm::UndefValue::get(type);
+        slice = context.builder.CreateInsertValue(slice, view.data, 0);
+        return context.builder.CreateInsertValue(slice, view.length, 1);
+    }
+
+    // Brings both operands to a common type. Scalars are splat when the other operand is a vector and integers
+    // are converted when the other operand is floating-point. Otherwise the wider of the two types is taken.
+    // The common type is unsigned if the operand whose type it is is unsigned. Unsigned wins on equal widths,
+    // the same as in the constant evaluator, e.g. `a < b` of an i32 and a u32 compares them as u32.
+    static bool unify_operand_types(Compiler_Context& context, llvm::Value*& lhs, llvm::Value*& rhs, bool const lhs_unsigned, bool const rhs_unsigned,
+                                    bool& is_unsigned) {
+        llvm::Type* lhs_type = lhs->getType();
+        llvm::Type* rhs_type = rhs->getType();
+        bool convert_lhs = false;
+        if(lhs_type->isVectorTy() != rhs_type->isVectorTy()) {
+            convert_lhs = rhs_type->isVectorTy();
+        } else if(lhs_type->isFPOrFPVectorTy() != rhs_type->isFPOrFPVectorTy()) {
+            convert_lhs = rhs_type->isFPOrFPVectorTy();
+        } else if(lhs_type->getPrimitiveSizeInBits() == rhs_type->getPrimitiveSizeInBits()) {
+            convert_lhs = rhs_unsigned;
+        } else {
+            convert_lhs = lhs_type->getPrimitiveSizeInBits() < rhs_type->getPrimitiveSizeInBits();
+        }
+
+        if(convert_lhs) {
+            lhs = convert_value(context, lhs, rhs_type, lhs_unsigned);
+            is_unsigned = rhs_unsigned;
+        } else {
+            rhs = convert_value(context, rhs, lhs_type, rhs_unsigned);
+            is_unsigned = lhs_unsigned;
+        }
+
+        if(lhs->getType() != rhs->getType()) {
+            emit_compile_error(context, lhs->getType()->isVectorTy() || rhs->getType()->isVectorTy()
+                                            ? "Vectors of different element types or numbers of lanes cannot be combined"
+                                            : "Operands have incompatible types");
+            return false;
+        }
+        return true;
+    }
+
+    static bool overflows(Operator const op, const llvm::APInt& lhs, const llvm::APInt& rhs, bool const is_unsigned) {
+        bool overflow = false;
+        if(op == Operator::binary_add) {
+            is_unsigned ? lhs.uadd_ov(rhs, overflow) : lhs.sadd_ov(rhs, overflow);
+        } else if(op == Operator::binary_sub) {
+            is_unsigned ? lhs.usub_ov(rhs, overflow) : lhs.ssub_ov(rhs, overflow);
+        } else {
+            is_unsigned ? lhs.umul_ov(rhs, overflow) : lhs.smul_ov(rhs, overflow);
+        }
+        return overflow;
+    }
+
+    // Integer addition, subtraction and multiplication by the overflow policy. Overflows of constants are found at compile time.
+    static llvm::Value* generate_integer_arithmetic(Compiler_Context& context, Operator const op, llvm::Value* lhs, llvm::Value* rhs, bool const is_unsigned) {
+        llvm::Instruction::BinaryOps const opcode =
+            op == Operator::binary_add ? llvm::Instruction::Add : op == Operator::binary_sub ? llvm::Instruction::Sub : llvm::Instruction::Mul;
+        if(context.options.overflow == Overflow_Policy::trap) {
+            auto* const lhs_constant = llvm::dyn_cast<llvm::ConstantInt>(lhs);
+            auto* const rhs_constant = llvm::dyn_cast<llvm::ConstantInt>(rhs);
+            if(lhs_constant && rhs_constant) {
+                if(overflows(op, lhs_constant->getValue(), rhs_constant->getValue(), is_unsigned)) {
+                    emit_compile_error(context, "Integer overflow in constant expression");
+                    return nullptr;
+                }
+            } else if(!llvm::isa<llvm::Constant>(lhs) || !llvm::isa<llvm::Constant>(rhs)) {
+                static constexpr llvm::Intrinsic::ID intrinsics[3][2] = {
+                    {llvm::Intrinsic::sadd_with_overflow, llvm::Intrinsic::uadd_with_overflow},
+                    {llvm::Intrinsic::ssub_with_overflow, llvm::Intrinsic::usub_with_overflow},
+                    {llvm::Intrinsic::smul_with_overflow, llvm::Intrinsic::umul_with_overflow},
+                };
+                llvm::Intrinsic::ID const intrinsic = intrinsics[op == Operator::binary_add ? 0 : op == Operator::binary_sub ? 1 : 2][is_unsigned];
+                llvm::Value* result =
+                    context.builder.CreateCall(llvm::Intrinsic::getDeclaration(context.module.get(), intrinsic, {lhs->getType()}), {lhs, rhs});
+                llvm::Value* overflow = context.builder.CreateExtractValue(result, 1);
+                if(overflow->getType()->isVectorTy()) {
+                    overflow = context.builder.CreateOrReduce(overflow);
+                }
+                generate_check(context, context.builder.CreateNot(overflow), "overflow");
+                return context.builder.CreateExtractValue(result, 0);
+            }
+        }
+
+        llvm::Value* value = context.builder.CreateBinOp(opcode, lhs, rhs);
+        // Constants are folded and wrap around.
+        if(auto* instruction = llvm::dyn_cast<llvm::BinaryOperator>(value); instruction && context.options.overflow == Overflow_Policy::undefined) {
+            instruction->setHasNoUnsignedWrap(is_unsigned);
+            instruction->setHasNoSignedWrap(!is_unsigned);
+        }
+        return value;
+    }
+
+    // Vectors are combined lane by lane. Their comparisons result in a mask, i.e. a vector of bools.
+    // lhs_unsigned and rhs_unsigned are the signedness of the operands, is_unsigned becomes that of the result.
+    static llvm::Value* generate_arithmetic(Compiler_Context& context, Operator const op, llvm::Value* lhs, llvm::Value* rhs, bool const lhs_unsigned,
+                                            bool const rhs_unsigned, bool& is_unsigned) {
+        if(!lhs || !rhs) {
+            return nullptr;
+        }
+
+        if(lhs->getType()->isAggregateType() || rhs->getType()->isAggregateType()) {
+            emit_compile_error(context, "Arrays and slices cannot be operands of arithmetic or comparisons");
+            return nullptr;
+        }
+
+        bool operands_unsigned = false;
+        if(!unify_operand_types(context, lhs, rhs, lhs_unsigned, rhs_unsigned, operands_unsigned)) {
+            return nullptr;
+        }
+
+        // Comparisons result in bools, which are unsigned.
+        is_unsigned = operands_unsigned || op == Operator::binary_eq || op == Operator::binary_neq || op == Operator::binary_lt ||
+                      op == Operator::binary_gt || op == Operator::binary_leq || op == Operator::binary_geq;
+        bool const is_float = lhs->getType()->isFPOrFPVectorTy();
+        switch(op) {
+            case Operator::binary_add: {
+                return is_float ? context.builder.CreateFAdd(lhs, rhs) : generate_integer_arithmetic(context, op, lhs, rhs, operands_unsigned);
+            }
+
+            case Operator::binary_sub: {
+                return is_float ? context.builder.CreateFSub(lhs, rhs) : generate_integer_arithmetic(context, op, lhs, rhs, operands_unsigned);
+            }
+
+            case Operator::binary_mul: {
+                return is_float ? context.builder.CreateFMul(lhs, rhs) : generate_integer_arithmetic(context, op, lhs, rhs, operands_unsigned);
+            }
+
+            case Operator::binary_div: {
+                if(is_float) {
+                    return context.builder.CreateFDiv(lhs, rhs);
+                }
+                return operands_unsigned ? context.builder.CreateUDiv(lhs, rhs) : context.builder.CreateSDiv(lhs, rhs);
+            }
+
+            // Comparisons with NaN are false, except for `!=`.
+            case Operator::binary_eq: {
+                return is_float ? context.builder.CreateFCmpOEQ(lhs, rhs) : context.builder.CreateICmpEQ(lhs, rhs);
+            }
+
+            case Operator::binary_neq: {
+                return is_float ? context.builder.CreateFCmpUNE(lhs, rhs) : context.builder.CreateICmpNE(lhs, rhs);
+            }
+
+            case Operator::binary_lt: {
+                if(is_float) {
+                    return context.builder.CreateFCmpOLT(lhs, rhs);
+                }
+                return operands_unsigned ? context.builder.CreateICmpULT(lhs, rhs) : context.builder.CreateICmpSLT(lhs, rhs);
+            }
+
+            case Operator::binary_gt: {
+                if(is_float) {
+                    return context.builder.CreateFCmpOGT(lhs, rhs);
+                }
+                return operands_unsigned ? context.builder.CreateICmpUGT(lhs, rhs) : context.builder.CreateICmpSGT(lhs, rhs);
+            }
+
+            case Operator::binary_leq: {
+                if(is_float) {
+                    return context.builder.CreateFCmpOLE(lhs, rhs);
+                }
+                return operands_unsigned ? context.builder.CreateICmpULE(lhs, rhs) : context.builder.CreateICmpSLE(lhs, rhs);
+            }
+
+            case Operator::binary_geq: {
+                if(is_float) {
+                    return context.builder.CreateFCmpOGE(lhs, rhs);
+                }
+                return operands_unsigned ? context.builder.CreateICmpUGE(lhs, rhs) : context.builder.CreateICmpSGE(lhs, rhs);
+            }
+
+            default:
+                return nullptr;
+        }
+    }
+
+    static llvm::Value* generate_condition(Compiler_Context& context, const Expression& expression);
+
+    // `a || b` and `a && b` evaluate b only when a does not decide the result.
+    static llvm::Value* generate_logical_expression(Compiler_Context& context, const Binary_Expression& expression) {
+        llvm::Value* lhs = generate_condition(context, *expression.lhs);
+        if(!lhs) {
+            return nullptr;
+        }
+
+        bool const is_or = expression.op == Operator::binary_or;
+        llvm::Function* function = context.builder.GetInsertBlock()->getParent();
+        llvm::BasicBlock* lhs_block = context.builder.GetInsertBlock();
+        llvm::BasicBlock* rhs_block = llvm::BasicBlock::Create(context.handle, is_or ? "or.rhs" : "and.rhs", function);
+        llvm::BasicBlock* merge_block = llvm::BasicBlock::Create(context.handle, is_or ? "or.end" : "and.end");
+        if(is_or) {
+            context.builder.CreateCondBr(lhs, merge_block, rhs_block);
+        } else {
+            context.builder.CreateCondBr(lhs, rhs_block, merge_block);
+        }
+        seal_block(context, rhs_block);
+
+        context.builder.SetInsertPoint(rhs_block);
+        llvm::Value* rhs = generate_condition(context, *expression.rhs);
+        if(!rhs) {
+            return nullptr;
+        }
+        // The rhs may have introduced blocks of its own.
+        llvm::BasicBlock* rhs_end_block = context.builder.GetInsertBlock();
+        context.builder.CreateBr(merge_block);
+
+        merge_block->insertInto(function);
+        seal_block(context, merge_block);
+        context.builder.SetInsertPoint(merge_block);
+        llvm::PHINode* result = context.builder.CreatePHI(context.builder.getInt1Ty(), 2);
+        result->addIncoming(context.builder.getInt1(is_or), lhs_block);
+        result->addIncoming(rhs, rhs_end_block);
+        return result;
+    }
+
+    static llvm::Value* generate_binary_expression(Compiler_Context& context, const Binary_Expression& expression) {
+        if(expression.op == Operator::binary_or || expression.op == Operator::binary_and) {
+            return generate_logical_expression(context, expression);
+        }
+
+        llvm::Value* lhs = nullptr;
+        llvm::Value* rhs = nullptr;
+        if(expression.lhs->node_type == AST_Node_Type::float_literal) {
+            // Literals have no side effects, so the other operand may be generated first.
+            rhs = generate_expression(context, *expression.rhs);
+            lhs = generate_operand(context, *expression.lhs, rhs ? rhs->getType() : nullptr);
+        } else {
+            lhs = generate_expression(context, *expression.lhs);
+            rhs = generate_operand(context, *expression.rhs, lhs ? lhs->getType() : nullptr);
+        }
+
+        if(!lhs || !rhs) {
+            return nullptr;
+        }
+
+        bool result_unsigned = false;
+        llvm::Value* result = generate_arithmetic(context, expression.op, lhs, rhs, is_unsigned(context, *expression.lhs),
+                                                  is_unsigned(context, *expression.rhs), result_unsigned);
+        context.unsigned_results[&expression] = result_unsigned;
+        return result;
+    }
+
+    // Elements are stored to in place. Slices are read-only views, so only the elements of arrays
+    // that mutable variables hold may be assigned.
+    static llvm::Value* generate_element_assignment(Compiler_Context& context, const Assignment_Expression& expression) {
+        llvm::Type* element_type = nullptr;
+        bool is_read_only = false;
+        llvm::Value* element = generate_element_pointer(context, *expression.element, element_type, is_read_only);
+        if(!element) {
+            return nullptr;
+        }
+
+        if(is_read_only) {
+            emit_compile_error(context, "Cannot assign to an element of a slice");
+            return nullptr;
+        }
+
+        llvm::Value* value = nullptr;
+        if(expression.op == Operator::assign) {
+            value = generate_expression_as(context, *expression.value, element_type);
+        } else {
+            value = generate_operand(context, *expression.value, element_type);
+            if(!value) {
+                return nullptr;
+            }
+
+            llvm::Value* current = context.builder.CreateLoad(element_type, element);
+            bool result_unsigned = false;
+            value = generate_arithmetic(context, expression.op, current, value, is_unsigned(context, *expression.element),
+                                        is_unsigned(context, *expression.value), result_unsigned);
+            value = convert_value(context, value, element_type, result_unsigned);
+        }
+
+        if(!value) {
+            return nullptr;
+        }
+
+        context.builder.CreateStore(value, element);
+        return value;
+    }
+
+    static llvm::Value* generate_assignment_expression(Compiler_Context& context, const Assignment_Expression& expression) {
+        const std::string& name = expression.identifier->name;
+        Variable* variable = find_variable(context, name);
+        if(!variable) {
+            if(find_global_variable(context, name)) {
+                emit_compile_error(context, "Cannot assign to global variable \"" + name + "\"");
+            } else {
+                emit_compile_error(context, "Undefined variable: \"" + name + "\" referenced");
+            }
+            return nullptr;
+        }
+
+        if(!variable->is_mutable) {
+            emit_compile_error(context, "Cannot assign to immutable variable \"" + name + "\"");
+            return nullptr;
+        }
+
+        if(expression.element) {
+            return generate_element_assignment(context, expression);
+        }
+
+        llvm::Value* value = nullptr;
+        if(expression.op == Operator::assign) {
+            value = generate_expression_as(context, *expression.value, variable->type);
+        } else {
+            value = generate_operand(context, *expression.value, variable->type);
+            if(!value) {
+                return nullptr;
+            }
+
+            bool result_unsigned = false;
+            value = generate_arithmetic(context, expression.op, load_variable(context, *variable), value, variable->is_unsigned,
+                                        is_unsigned(context, *expression.value), result_unsigned);
+            value = convert_value(context, value, variable->type, result_unsigned);
+        }
+
+        if(!value) {
+            return nullptr;
+        }
+
+        store_variable(context, *variable, value);
+        return value;
+    }
+
+    static llvm::Constant* make_constant(const Constant_Value& value, llvm::Type* type) {
+        return llvm::ConstantInt::get(type, static_cast<u64>(value.value), value.is_signed);
+    }
+
+    // Evaluates a call to a pure function at compile time. Returns nullptr when the call
+    // cannot be evaluated, e.g. because an argument is not a constant.
+    static llvm::Constant* try_evaluate_call(Compiler_Context& context, const Function_Call_Expression& expression, llvm::Function* function) {
+        llvm::Type* return_type = function->getReturnType();
+        if(!context.options.evaluate_constant_calls || !return_type->isIntegerTy() || !context.evaluator.is_pure(expression.identifier->name)) {
+            return nullptr;
+        }
+
+        anton::Expected<Constant_Value, Evaluation_Error> result = context.evaluator.evaluate(expression);
+        if(!result) {
+            return nullptr;
+        }
+        return make_constant(result.value(), return_type);
+    }
+
+    // `size(a)` is the number of elements of an array or a slice as i64.
+    static llvm::Value* generate_size_call(Compiler_Context& context, const Function_Call_Expression& expression, llvm::Type*) {
+        Array_View view;
+        bool is_read_only = false;
+        if(!generate_array_view(context, *expression.arg_list->arguments[0], view, is_read_only)) {
+            return nullptr;
+        }
+        return view.length;
+    }
+
+    // `splat<V>(x)` is the vector of type V with x in every lane.
+    static llvm::Value* generate_splat_call(Compiler_Context& context, const Function_Call_Expression& expression, llvm::Type* vector_type) {
+        llvm::Value* value = generate_expression(context, *expression.arg_list->arguments[0]);
+        if(!value) {
+            return nullptr;
+        }
+
+        llvm::Value* vector =
+            value->getType()->isVectorTy() ? value : convert_value(context, value, vector_type, is_unsigned(context, *expression.arg_list->arguments[0]));
+        if(vector->getType() != vector_type) {
+            emit_compile_error(context, "splat expects a scalar that converts to the lanes of the vector");
+            return nullptr;
+        }
+        return vector;
+    }
+
+    static llvm::Value* generate_vector_argument(Compiler_Context& context, const Function_Call_Expression& expression, u64 const index) {
+        llvm::Value* value = generate_expression(context, *expression.arg_list->arguments[index]);
+        if(value && !value->getType()->isVectorTy()) {
+            emit_compile_error(context, expression.identifier->name + " expects a vector as argument " + std::to_string(index + 1));
+            return nullptr;
+        }
+        return value;
+    }
+
+    // Masks are vectors of bools, e.g. the results of comparisons of vectors, with a lane for every lane of the vector
+    // they apply to. A single bool applies to every lane.
+    static llvm::Value* convert_mask(Compiler_Context& context, const Function_Call_Expression& expression, llvm::Value* mask, llvm::Type* type) {
+        if(!mask) {
+            return nullptr;
+        }
+
+        llvm::Type* mask_type = context.builder.getInt1Ty();
+        if(type->isVectorTy()) {
+            mask_type = llvm::VectorType::get(mask_type, static_cast<unsigned>(get_lane_count(type)));
+        }
+
+        if(mask->getType()->isIntOrIntVectorTy(1)) {
+            mask = convert_value(context, mask, mask_type);
+        }
+
+        if(mask->getType() != mask_type) {
+            emit_compile_error(context, expression.identifier->name + " expects a bool or a mask with one lane for every lane of the vector");
+            return nullptr;
+        }
+        return mask;
+    }
+
+    // `shuffle(a, [i, ...])` picks the lanes of a by their constant indices. `shuffle(a, b, [i, ...])` picks them from a
+    // followed by b, i.e. the index of the first lane of b is the number of lanes of a. The result has a lane for every index.
+    static llvm::Value* generate_shuffle_call(Compiler_Context& context, const Function_Call_Expression& expression, llvm::Type*) {
+        const auto& arguments = expression.arg_list->arguments;
+        if(arguments.back()->node_type != AST_Node_Type::array_literal) {
+            emit_compile_error(context, "shuffle expects the indices of the lanes as an array literal, e.g. [3, 2, 1, 0]");
+            return nullptr;
+        }
+
+        llvm::Value* lhs = generate_vector_argument(context, expression, 0);
+        if(!lhs) {
+            return nullptr;
+        }
+
+        llvm::Value* rhs = llvm::UndefValue::get(lhs->getType());
+        if(arguments.size() == 3) {
+            rhs = generate_vector_argument(context, expression, 1);
+            if(!rhs) {
+                return nullptr;
+            }
+
+            if(rhs->getType() != lhs->getType()) {
+                emit_compile_error(context, "Vectors of different element types or numbers of lanes cannot be shuffled together");
+                return nullptr;
+            }
+        }
+
+        u64 const source_lanes = static_cast<u64>(get_lane_count(lhs->getType())) * (arguments.size() - 1);
+        std::vector<llvm::Constant*> indices;
+        for(const auto& element: static_cast<const Array_Literal&>(*arguments.back()).elements) {
+            auto* index = llvm::dyn_cast_or_null<llvm::ConstantInt>(generate_expression(context, *element));
+            if(!index || index->getValue().uge(source_lanes)) {
+                emit_compile_error(context, "Indices of the lanes of shuffle have to be constants from 0 to " + std::to_string(source_lanes - 1));
+                return nullptr;
+            }
+            indices.push_back(context.builder.getInt32(static_cast<unsigned>(index->getZExtValue())));
+        }
+
+        if(indices.empty()) {
+            emit_compile_error(context, "shuffle expects the index of at least one lane");
+            return nullptr;
+        }
+        return context.builder.CreateShuffleVector(lhs, rhs, llvm::ConstantVector::get(indices));
+    }
+
+    // `select(mask, a, b)` takes the lanes of a where the mask is true and those of b elsewhere.
+    static llvm::Value* generate_select_call(Compiler_Context& context, const Function_Call_Expression& expression, llvm::Type*) {
+        const auto& arguments = expression.arg_list->arguments;
+        llvm::Value* mask = generate_expression(context, *arguments[0]);
+        llvm::Value* lhs = generate_expression(context, *arguments[1]);
+        llvm::Value* rhs = generate_expression(context, *arguments[2]);
+        bool result_unsigned = false;
+        if(!mask || !lhs || !rhs ||
+           !unify_operand_types(context, lhs, rhs, is_unsigned(context, *arguments[1]), is_unsigned(context, *arguments[2]), result_unsigned)) {
+            return nullptr;
+        }
+
+        mask = convert_mask(context, expression, mask, lhs->getType());
+        if(!mask) {
+            return nullptr;
+        }
+        return context.builder.CreateSelect(mask, lhs, rhs);
+    }
+
+    // Vectors are stored to the elements of arrays in place, which, like elements that are assigned,
+    // have to be held by mutable variables.
+    static bool generate_writable_array_view(Compiler_Context& context, const Expression& expression, Array_View& view) {
+        const Expression* root = &expression;
+        while(root->node_type == AST_Node_Type::index_expression) {
+            root = static_cast<const Index_Expression*>(root)->base.get();
+        }
+
+        if(root->node_type != AST_Node_Type::identifier_expression || static_cast<const Identifier_Expression*>(root)->template_arguments) {
+            emit_compile_error(context, "Vectors can only be stored to arrays that variables hold");
+            return false;
+        }
+
+        const std::string& name = static_cast<const Identifier_Expression*>(root)->identifier->name;
+        Variable* variable = find_variable(context, name);
+        if(!variable) {
+            if(find_global_variable(context, name)) {
+                emit_compile_error(context, "Cannot assign to global variable \"" + name + "\"");
+            } else {
+                emit_compile_error(context, "Undefined variable: \"" + name + "\" referenced");
+            }
+            return false;
+        }
+
+        if(!variable->is_mutable) {
+            emit_compile_error(context, "Cannot assign to immutable variable \"" + name + "\"");
+            return false;
+        }
+
+        bool is_read_only = false;
+        if(!generate_array_view(context, expression, view, is_read_only)) {
+            return false;
+        }
+
+        if(is_read_only) {
+            emit_compile_error(context, "Cannot store to the elements of a slice");
+            return false;
+        }
+        return true;
+    }
+
+    // The lanes of vectors are loaded from and stored to consecutive elements, starting at the index.
+    static bool check_lane_type(Compiler_Context& context, const Function_Call_Expression& expression, const Array_View& view, llvm::Type* vector_type) {
+        if(view.element_type != vector_type->getScalarType()) {
+            emit_compile_error(context, expression.identifier->name + " expects elements of the same type as the lanes of the vector");
+            return false;
+        }
+        return true;
+    }
+
+    // Loads and stores of whole vectors check that every lane is in bounds. Constant indices into arrays are
+    // checked at compile time, all other indices at run time.
+    static bool generate_lanes_check(Compiler_Context& context, const Array_View& view, llvm::Value* index, i64 const lanes) {
+        auto* constant_index = llvm::dyn_cast<llvm::ConstantInt>(index);
+        if(constant_index && view.static_length >= 0) {
+            if(view.static_length < lanes || constant_index->getValue().ugt(static_cast<u64>(view.static_length - lanes))) {
+                emit_compile_error(context, "Lanes " + std::to_string(constant_index->getSExtValue()) + " to " +
+                                   std::to_string(constant_index->getSExtValue() + lanes - 1) + " are out of bounds of an array of " +
+                                   std::to_string(view.static_length) + " elements");
+                return false;
+            }
+            return true;
+        }
+
+        // The last lane, index + lanes - 1, could wrap around. The index is compared to the length minus the lanes
+        // instead, which does not wrap once the length is known to be at least the number of lanes.
+        llvm::Value* lane_count = context.builder.getInt64(static_cast<u64>(lanes));
+        llvm::Value* fits = context.builder.CreateICmpULE(lane_count, view.length);
+        llvm::Value* in_bounds = context.builder.CreateICmpULE(index, context.builder.CreateSub(view.length, lane_count));
+        generate_check(context, context.builder.CreateAnd(fits, in_bounds), "bounds");
+        return true;
+    }
+
+    // The elements only guarantee the alignment of a single lane.
+    static unsigned get_lane_alignment(Compiler_Context& context, const Array_View& view) {
+        return static_cast<unsigned>(context.module->getDataLayout().getABITypeAlignment(view.element_type));
+    }
+
+    // `load<V>(a, i)` is the vector of type V with the elements i to i + lanes - 1 of the array or the slice a.
+    static llvm::Value* generate_load_call(Compiler_Context& context, const Function_Call_Expression& expression, llvm::Type* vector_type) {
+        Array_View view;
+        bool is_read_only = false;
+        if(!generate_array_view(context, *expression.arg_list->arguments[0], view, is_read_only) || !check_lane_type(context, expression, view, vector_type)) {
+            return nullptr;
+        }
+
+        llvm::Value* index = generate_index(context, *expression.arg_list->arguments[1]);
+        if(!index || !generate_lanes_check(context, view, index, get_lane_count(vector_type))) {
+            return nullptr;
+        }
+
+        llvm::Value* element = context.builder.CreateInBoundsGEP(view.element_type, view.data, index);
+        llvm::Value* pointer = context.builder.CreateBitCast(element, vector_type->getPointerTo());
+        llvm::LoadInst* load = context.builder.CreateLoad(vector_type, pointer);
+        load->setAlignment(llvm::Align(get_lane_alignment(context, view)));
+        return load;
+    }
+
+    // `store(a, i, v)` stores the lanes of v to the elements i to i + lanes - 1 of the array a.
+    static llvm::Value* generate_store_call(Compiler_Context& context, const Function_Call_Expression& expression, llvm::Type*) {
+        Array_View view;
+        if(!generate_writable_array_view(context, *expression.arg_list->arguments[0], view)) {
+            return nullptr;
+        }
+
+        llvm::Value* index = generate_index(context, *expression.arg_list->arguments[1]);
+        llvm::Value* vector = generate_vector_argument(context, expression, 2);
+        if(!index || !vector || !check_lane_type(context, expression, view, vector->getType()) ||
+           !generate_lanes_check(context, view, index, get_lane_count(vector->getType()))) {
+            return nullptr;
+        }
+
+        llvm::Value* element = context.builder.CreateInBoundsGEP(view.element_type, view.data, index);
+        llvm::Value* pointer = context.builder.CreateBitCast(element, vector->getType()->getPointerTo());
+        llvm::StoreInst* store = context.builder.CreateStore(vector, pointer);
+        store->setAlignment(llvm::Align(get_lane_alignment(context, view)));
+        return vector;
+    }
+
+    // Masked loads and stores access only the lanes that the mask selects. Lanes that would be out of bounds are
+    // not selected either, so that the remainder of a loop is handled by the mask `true` instead of a scalar loop.
+    // The index is not checked, the address of the first lane may therefore be outside of the elements.
+    static llvm::Value* generate_masked_lanes_pointer(Compiler_Context& context, const Array_View& view, llvm::Value* index, llvm::Value*& mask) {
+        unsigned const lanes = static_cast<unsigned>(get_lane_count(mask->getType()));
+        std::vector<llvm::Constant*> offsets;
+        for(unsigned i = 0; i < lanes; ++i) {
+            offsets.push_back(context.builder.getInt64(i));
+        }
+
+        llvm::Value* lane_indices = context.builder.CreateAdd(context.builder.CreateVectorSplat(lanes, index), llvm::ConstantVector::get(offsets));
+        llvm::Value* in_bounds = context.builder.CreateICmpULT(lane_indices, context.builder.CreateVectorSplat(lanes, view.length));
+        mask = context.builder.CreateAnd(mask, in_bounds);
+        return context.builder.CreateGEP(view.element_type, view.data, index);
+    }
+
+    // `masked_load<V>(a, i, mask)` loads the selected lanes like load and sets all other lanes to 0.
+    // `masked_load<V>(a, i, mask, fallback)` takes the other lanes from fallback instead.
+    static llvm::Value* generate_masked_load_call(Compiler_Context& context, const Function_Call_Expression& expression, llvm::Type* vector_type) {
+        const auto& arguments = expression.arg_list->arguments;
+        Array_View view;
+        bool is_read_only = false;
+        if(!generate_array_view(context, *arguments[0], view, is_read_only) || !check_lane_type(context, expression, view, vector_type)) {
+            return nullptr;
+        }
+
+        llvm::Value* index = generate_index(context, *arguments[1]);
+        llvm::Value* mask = convert_mask(context, expression, generate_expression(context, *arguments[2]), vector_type);
+        if(!index || !mask) {
+            return nullptr;
+        }
+
+        llvm::Value* fallback = llvm::Constant::getNullValue(vector_type);
+        if(arguments.size() == 4) {
+            fallback = generate_expression_as(context, *arguments[3], vector_type);
+            if(!fallback) {
+                return nullptr;
+            }
+        }
+
+        llvm::Value* element = generate_masked_lanes_pointer(context, view, index, mask);
+        llvm::Value* pointer = context.builder.CreateBitCast(element, vector_type->getPointerTo());
+        llvm::Function* masked_load = llvm::Intrinsic::getDeclaration(context.module.get(), llvm::Intrinsic::masked_load, {vector_type, pointer->getType()});
+        return context.builder.CreateCall(masked_load, {pointer, context.builder.getInt32(get_lane_alignment(context, view)), mask, fallback});
+    }
+
+    // `masked_store(a, i, v, mask)` stores the lanes of v that the mask selects like store.
+    static llvm::Value* generate_masked_store_call(Compiler_Context& context, const Function_Call_Expression& expression, llvm::Type*) {
+        const auto& arguments = expression.arg_list->arguments;
+        Array_View view;
+        if(!generate_writable_array_view(context, *arguments[0], view)) {
+            return nullptr;
+        }
+
+        llvm::Value* index = generate_index(context, *arguments[1]);
+        llvm::Value* vector = generate_vector_argument(context, expression, 2);
+        if(!index || !vector || !check_lane_type(context, expression, view, vector->getType())) {
+            return nullptr;
+        }
+
+        llvm::Value* mask = convert_mask(context, expression, generate_expression(context, *arguments[3]), vector->getType());
+        if(!mask) {
+            return nullptr;
+        }
+
+        llvm::Value* element = generate_masked_lanes_pointer(context, view, index, mask);
+        llvm::Value* pointer = context.builder.CreateBitCast(element, vector->getType()->getPointerTo());
+        llvm::Function* masked_store =
+            llvm::Intrinsic::getDeclaration(context.module.get(), llvm::Intrinsic::masked_store, {vector->getType(), pointer->getType()});
+        context.builder.CreateCall(masked_store, {vector, pointer, context.builder.getInt32(get_lane_alignment(context, view)), mask});
+        return vector;
+    }
+
+    // `reduce_add(v)`, `reduce_mul(v)`, `reduce_min(v)` and `reduce_max(v)` combine the lanes of v into a scalar.
+    // The lanes of floats are added and multiplied in an unspecified order, which lets them be combined pairwise in registers.
+    static llvm::Value* generate_reduction_call(Compiler_Context& context, const Function_Call_Expression& expression, llvm::Type*) {
+        llvm::Value* vector = generate_vector_argument(context, expression, 0);
+        if(!vector) {
+            return nullptr;
+        }
+
+        llvm::Type* element_type = vector->getType()->getScalarType();
+        if(element_type->isIntegerTy(1)) {
+            emit_compile_error(context, expression.identifier->name + " expects a vector of numbers, masks are reduced with any or all");
+            return nullptr;
+        }
+
+        const std::string& name = expression.identifier->name;
+        bool const is_float = element_type->isFloatingPointTy();
+        bool const is_signed = !is_unsigned(context, *expression.arg_list->arguments[0]);
+        llvm::Value* result = nullptr;
+        if(name == "reduce_add") {
+            result = is_float ? context.builder.CreateFAddReduce(llvm::ConstantFP::getNegativeZero(element_type), vector)
+                              : context.builder.CreateAddReduce(vector);
+        } else if(name == "reduce_mul") {
+            result = is_float ? context.builder.CreateFMulReduce(llvm::ConstantFP::get(element_type, 1.0), vector) : context.builder.CreateMulReduce(vector);
+        } else if(name == "reduce_min") {
+            result = is_float ? context.builder.CreateFPMinReduce(vector) : context.builder.CreateIntMinReduce(vector, is_signed);
+        } else {
+            result = is_float ? context.builder.CreateFPMaxReduce(vector) : context.builder.CreateIntMaxReduce(vector, is_signed);
+        }
+
+        if(is_float) {
+            llvm::cast<llvm::Instruction>(result)->setHasAllowReassoc(true);
+        }
+        return result;
+    }
+
+    // `any(mask)` and `all(mask)` are true if any or all lanes of the mask are true.
+    static llvm::Value* generate_mask_reduction_call(Compiler_Context& context, const Function_Call_Expression& expression, llvm::Type*) {
+        llvm::Value* mask = generate_vector_argument(context, expression, 0);
+        if(!mask) {
+            return nullptr;
+        }
+
+        if(!mask->getType()->isIntOrIntVectorTy(1)) {
+            emit_compile_error(context, expression.identifier->name + " expects a mask, e.g. the result of a comparison of vectors");
+            return nullptr;
+        }
+        return expression.identifier->name == "any" ? context.builder.CreateOrReduce(mask) : context.builder.CreateAndReduce(mask);
+    }
+
+    struct Builtin_Function {
+        std::string_view name;
+        // How the builtin is called, for the messages of wrong calls.
+        std::string_view usage;
+        u64 min_arguments;
+        u64 max_arguments;
+        // Whether the vector type is the template argument, e.g. `splat<f32x8>(x)`.
+        bool takes_vector_type;
+        // The argument whose signedness the result has. -1 if the result has that of the vector type or is signed.
+        i64 signedness_argument;
+        llvm::Value* (*generate)(Compiler_Context& context, const Function_Call_Expression& expression, llvm::Type* vector_type);
+    };
+
+    static constexpr Builtin_Function builtin_functions[] = {
+        {"size", "size(a)", 1, 1, false, -1, generate_size_call},
+        {"splat", "splat<V>(x)", 1, 1, true, -1, generate_splat_call},
+        {"shuffle", "shuffle(a, [i, ...]) or shuffle(a, b, [i, ...])", 2, 3, false, 0, generate_shuffle_call},
+        {"select", "select(mask, a, b)", 3, 3, false, 1, generate_select_call},
+        {"load", "load<V>(a, i)", 2, 2, true, -1, generate_load_call},
+        {"store", "store(a, i, v)", 3, 3, false, 2, generate_store_call},
+        {"masked_load", "masked_load<V>(a, i, mask) or masked_load<V>(a, i, mask, fallback)", 3, 4, true, -1, generate_masked_load_call},
+        {"masked_store", "masked_store(a, i, v, mask)", 4, 4, false, 2, generate_masked_store_call},
+        {"reduce_add", "reduce_add(v)", 1, 1, false, 0, generate_reduction_call},
+        {"reduce_mul", "reduce_mul(v)", 1, 1, false, 0, generate_reduction_call},
+        {"reduce_min", "reduce_min(v)", 1, 1, false, 0, generate_reduction_call},
+        {"reduce_max", "reduce_max(v)", 1, 1, false, 0, generate_reduction_call},
+        {"any", "any(mask)", 1, 1, false, -1, generate_mask_reduction_call},
+        {"all", "all(mask)", 1, 1, false, -1, generate_mask_reduction_call},
+    };
+
+    // Builtins are called like functions. Functions and function templates of the same name take precedence.
+    static const Builtin_Function* find_builtin_function(Compiler_Context& context, const std::string& name) {
+        for(const Builtin_Function& builtin: builtin_functions) {
+            if(builtin.name == name) {
+                bool const is_declared = context.function_templates.count(name) || find_function(context, name);
+                return is_declared ? nullptr : &builtin;
+            }
+        }
+        return nullptr;
+    }
+
+    static llvm::Value* generate_builtin_call(Compiler_Context& context, const Function_Call_Expression& expression, const Builtin_Function& builtin) {
+        u64 const argument_count = expression.arg_list->arguments.size();
+        u64 const template_argument_count = expression.template_arguments ? expression.template_arguments->arguments.size() : 0;
+        if(argument_count < builtin.min_arguments || argument_count > builtin.max_arguments || template_argument_count != (builtin.takes_vector_type ? 1 : 0)) {
+            emit_compile_error(context, std::string(builtin.name) + " is called as " + std::string(builtin.usage));
+            return nullptr;
+        }
+
+        llvm::Type* vector_type = nullptr;
+        if(builtin.takes_vector_type) {
+            Template_Argument argument;
+            if(!resolve_template_argument(context, *expression.template_arguments->arguments[0], argument)) {
+                return nullptr;
+            }
+
+            if(!argument.type->isVectorTy()) {
+                emit_compile_error(context, std::string(builtin.name) + " expects a vector type, e.g. f32x8, as its template argument");
+                return nullptr;
+            }
+            vector_type = argument.type;
+        }
+        return builtin.generate(context, expression, vector_type);
+    }
+
+    // Whether the value of the expression is an unsigned integer or a vector of them. Literals are signed. The expression
+    // must have been generated, so that the functions and instances that it refers to have been declared.
+    static bool is_unsigned(Compiler_Context& context, const Expression& expression) {
+        switch(expression.node_type) {
+            case AST_Node_Type::bool_literal: {
+                return true;
+            }
+
+            case AST_Node_Type::identifier_expression: {
+                auto& identifier = static_cast<const Identifier_Expression&>(expression);
+                const std::string& name = identifier.identifier->name;
+                if(identifier.template_arguments) {
+                    return context.unsigned_objects.count(instantiate_variable(context, name, *identifier.template_arguments));
+                } else if(Variable* variable = find_variable(context, name)) {
+                    return variable->is_unsigned;
+                } else {
+                    return context.unsigned_objects.count(find_global_variable(context, name));
+                }
+            }
+
+            case AST_Node_Type::binary_expression: {
+                auto iter = context.unsigned_results.find(&expression);
+                return iter != context.unsigned_results.end() && iter->second;
+            }
+
+            case AST_Node_Type::index_expression: {
+                return is_unsigned(context, *static_cast<const Index_Expression&>(expression).base);
+            }
+
+            case AST_Node_Type::array_literal: {
+                auto& literal = static_cast<const Array_Literal&>(expression);
+                return literal.elements.size() != 0 && is_unsigned(context, *literal.elements[0]);
+            }
+
+            case AST_Node_Type::assignment_expression: {
+                auto& assignment = static_cast<const Assignment_Expression&>(expression);
+                if(assignment.element) {
+                    return is_unsigned(context, *assignment.element);
+                }
+                Variable* variable = find_variable(context, assignment.identifier->name);
+                return variable && variable->is_unsigned;
+            }
+
+            case AST_Node_Type::function_call_expression: {
+                auto& call = static_cast<const Function_Call_Expression&>(expression);
+                const std::string& name = call.identifier->name;
+                if(const Builtin_Function* builtin = find_builtin_function(context, name)) {
+                    if(builtin->takes_vector_type && call.template_arguments && call.template_arguments->arguments.size() != 0) {
+                        return is_unsigned_type(context, *call.template_arguments->arguments[0]);
+                    }
+
+                    u64 const argument = static_cast<u64>(builtin->signedness_argument);
+                    return builtin->signedness_argument >= 0 && argument < call.arg_list->arguments.size() &&
+                           is_unsigned(context, *call.arg_list->arguments[argument]);
+                } else if(call.template_arguments) {
+                    return context.unsigned_objects.count(instantiate_function(context, name, *call.template_arguments));
+                } else {
+                    return context.unsigned_objects.count(find_function(context, name));
+                }
+            }
+
+            default:
+                return false;
+        }
+    }
+
+    static llvm::Value* generate_function_call_expression(Compiler_Context& context, const Function_Call_Expression& expression) {
+        const std::string& name = expression.identifier->name;
+        if(const Builtin_Function* builtin = find_builtin_function(context, name)) {
+            return generate_builtin_call(context, expression, *builtin);
+        }
+
+        llvm::Function* function = nullptr;
+        if(expression.template_arguments) {
+            function = instantiate_function(context, name, *expression.template_arguments);
+            if(!function) {
+                return nullptr;
+            }
+        } else if(context.function_templates.count(name)) {
+            emit_compile_error(context, "Function template \"" + name + "\" called without template arguments");
+            return nullptr;
+        } else {
+            function = find_function(context, name);
+            if(!function) {
+                emit_compile_error(context, "Undefined function: \"" + name + "\" referenced");
+                return nullptr;
+            }
+
+            if(llvm::Constant* result = try_evaluate_call(context, expression, function)) {
+                return result;
+            }
+        }
+
+        llvm::FunctionType* function_type = function->getFunctionType();
+        if(function_type->getNumParams() != expression.arg_list->arguments.size()) {
+            emit_compile_error(context, "Wrong number of arguments in call to \"" + name + "\"");
+            return nullptr;
+        }
+
+        std::vector<llvm::Value*> arguments{};
+        for(u64 i = 0; i < expression.arg_list->arguments.size(); ++i) {
+            llvm::Value* argument = generate_expression_as(context, *expression.arg_list->arguments[i], function_type->getParamType(i));
+            if(!argument) {
+                return nullptr;
+            }
+            arguments.emplace_back(argument);
+        }
+
+        return context.builder.CreateCall(function, arguments);
+    }
+
+    static llvm::Value* generate_expression_node(Compiler_Context& context, const Expression& expression) {
+        switch(expression.node_type) {
+            case AST_Node_Type::integer_literal: {
+                return generate_literal_expression(context, static_cast<const Integer_Literal&>(expression));
+            }
+
+            case AST_Node_Type::float_literal: {
+                return generate_float_literal(context, static_cast<const Float_Literal&>(expression), nullptr);
+            }
+
+            case AST_Node_Type::binary_expression: {
+                return generate_binary_expression(context, static_cast<const Binary_Expression&>(expression));
+            }
+
+            case AST_Node_Type::index_expression: {
+                return generate_index_expression(context, static_cast<const Index_Expression&>(expression));
+            }
+
+            case AST_Node_Type::array_literal: {
+                return generate_array_literal(context, static_cast<const Array_Literal&>(expression), nullptr);
+            }
+
+            case AST_Node_Type::assignment_expression: {
+                return generate_assignment_expression(context, static_cast<const Assignment_Expression&>(expression));
+            }
+
+            case AST_Node_Type::bool_literal: {
+                return generate_bool_literal_expression(context, static_cast<const Bool_Literal&>(expression));
+            }
+
+            case AST_Node_Type::identifier_expression: {
+                return generate_identifier_expression(context, static_cast<const Identifier_Expression&>(expression));
+            }
+
+            case AST_Node_Type::function_call_expression: {
+                return generate_function_call_expression(context, static_cast<const Function_Call_Expression&>(expression));
+            }
+            default:
+                return nullptr;
+        }
+    }
+
+    static llvm::Value* generate_expression(Compiler_Context& context, const Expression& expression) {
+        // Initializers of global variables are constant folded outside of any function and have no location.
+        if(!context.debug_builder || context.debug_scopes.empty()) {
+            return generate_expression_node(context, expression);
+        }
+
+        // The instructions that combine the operands are attributed to the expression, not to its last operand.
+        llvm::DebugLoc const enclosing_location = context.builder.getCurrentDebugLocation();
+        set_debug_location(context, expression);
+        llvm::Value* value = generate_expression_node(context, expression);
+        context.builder.SetCurrentDebugLocation(enclosing_location);
+        return value;
+    }
+
+    static void generate_statement(Compiler_Context& context, const Statement& statement);
+    static void generate_statement_list(Compiler_Context& context, const Statement_List& node);
+
+    static llvm::Value* generate_condition(Compiler_Context& context, const Expression& expression) {
+        llvm::Value* condition = generate_expression(context, expression);
+        if(condition && condition->getType()->isAggregateType()) {
+            emit_compile_error(context, "Arrays and slices cannot be used as conditions");
+            return nullptr;
+        }
+
+        if(condition && condition->getType()->isVectorTy()) {
+            emit_compile_error(context, "Vectors cannot be used as conditions, reduce them with any or all");
+            return nullptr;
+        }
+
+        if(condition && !condition->getType()->isIntegerTy(1)) {
+            condition = context.builder.CreateICmpNE(condition, llvm::Constant::getNullValue(condition->getType()));
+        }
+        return condition;
+    }
+
+    static void generate_if_statement(Compiler_Context& context, const If_Statement& statement) {
+        auto condition = generate_condition(context, *statement.condition);
+        if(!condition) {
+            return;
+        }
+
+        auto function = context.builder.GetInsertBlock()->getParent();
+        llvm::BasicBlock* true_block = llvm::BasicBlock::Create(context.handle, "if.then", function);
+        llvm::BasicBlock* merge_block = llvm::BasicBlock::Create(context.handle, "if.end");
+        llvm::BasicBlock* false_block = merge_block;
+        if(statement.else_block || statement.else_if) {
+            false_block = llvm::BasicBlock::Create(context.handle, "if.else", function);
+        }
+
+        context.builder.CreateCondBr(condition, true_block, false_block);
+        // Both branches have a single predecessor.
+        seal_block(context, true_block);
+        if(false_block != merge_block) {
+            seal_block(context, false_block);
+        }
+
+        context.builder.SetInsertPoint(true_block);
+        generate_statement(context, *statement.block);
+        if(!is_block_terminated(context.builder.GetInsertBlock())) {
+            context.builder.CreateBr(merge_block);
+        }
+
+        if(false_block != merge_block) {
+            context.builder.SetInsertPoint(false_block);
+            if(statement.else_block) {
+                generate_statement(context, *statement.else_block);
+            } else {
+                generate_if_statement(context, *statement.else_if);
+            }
+
+            if(!is_block_terminated(context.builder.GetInsertBlock())) {
+                context.builder.CreateBr(merge_block);
+            }
+        }
+
+        merge_block->insertInto(function);
+        seal_block(context, merge_block);
+        context.builder.SetInsertPoint(merge_block);
+    }
+
+    static bool parse_loop_count(const Attribute_Argument& argument, u64& out) {
+        if(argument.value.size() == 0 || argument.value.size() > 9 ||
+           !std::all_of(argument.value.begin(), argument.value.end(), [](char const c) { return c >= '0' && c <= '9'; })) {
+            return false;
+        }
+
+        out = std::stoul(argument.value);
+        return out != 0;
+    }
+
+    static llvm::Metadata* make_loop_property(Compiler_Context& context, const char* name, llvm::Constant* value = nullptr) {
+        llvm::SmallVector<llvm::Metadata*, 2> operands{llvm::MDString::get(context.handle, name)};
+        if(value) {
+            operands.push_back(llvm::ConstantAsMetadata::get(value));
+        }
+        return llvm::MDNode::get(context.handle, operands);
+    }
+
+    // Translates loop attributes into `!llvm.loop` metadata:
+    //   #[vectorize], #[vectorize(8)], #[vectorize(width=8, interleave=2)], #[vectorize(disable)]
+    //   #[unroll], #[unroll(4)], #[unroll(full)], #[unroll(disable)]
+    // Returns nullptr if the loop has no attributes or an attribute is invalid.
+    static llvm::MDNode* make_loop_metadata(Compiler_Context& context, const Attribute_List* attributes) {
+        if(!attributes || attributes->attributes.size() == 0) {
+            return nullptr;
+        }
+
+        // The first operand is the loop id itself. It makes the node unique to this loop.
+        llvm::SmallVector<llvm::Metadata*, 4> operands{nullptr};
+        for(const auto& attribute: attributes->attributes) {
+            if(attribute->name == "vectorize") {
+                bool enable = true;
+                for(const Attribute_Argument& argument: attribute->arguments) {
+                    u64 count = 0;
+                    if(argument.key.size() == 0 && argument.value == "disable") {
+                        enable = false;
+                    } else if((argument.key.size() == 0 || argument.key == "width") && parse_loop_count(argument, count)) {
+                        operands.push_back(make_loop_property(context, "llvm.loop.vectorize.width", context.builder.getInt32(count)));
+                    } else if(argument.key == "interleave" && parse_loop_count(argument, count)) {
+                        operands.push_back(make_loop_property(context, "llvm.loop.interleave.count", context.builder.getInt32(count)));
+                    } else {
+                        emit_compile_error(context, "Invalid argument \"" + argument.value + "\" of attribute \"vectorize\"");
+                        return nullptr;
+                    }
+                }
+                operands.push_back(make_loop_property(context, "llvm.loop.vectorize.enable", context.builder.getInt1(enable)));
+            } else if(attribute->name == "unroll") {
+                if(attribute->arguments.size() == 0) {
+                    operands.push_back(make_loop_property(context, "llvm.loop.unroll.enable"));
+                    continue;
+                }
+
+                const Attribute_Argument& argument = attribute->arguments[0];
+                u64 count = 0;
+                if(attribute->arguments.size() == 1 && argument.key.size() == 0 && argument.value == "full") {
+                    operands.push_back(make_loop_property(context, "llvm.loop.unroll.full"));
+                } else if(attribute->arguments.size() == 1 && argument.key.size() == 0 && argument.value == "disable") {
+                    operands.push_back(make_loop_property(context, "llvm.loop.unroll.disable"));
+                } else if(attribute->arguments.size() == 1 && argument.key.size() == 0 && parse_loop_count(argument, count)) {
+                    operands.push_back(make_loop_property(context, "llvm.loop.unroll.count", context.builder.getInt32(count)));
+                } else {
+                    emit_compile_error(context, "Invalid arguments of attribute \"unroll\"");
+                    return nullptr;
+                }
+            } else {
+                emit_compile_error(context, "Unknown loop attribute \"" + attribute->name + "\"");
+                return nullptr;
+            }
+        }
+
+        llvm::MDNode* loop_id = llvm::MDNode::getDistinct(context.handle, operands);
+        loop_id->replaceOperandWith(0, loop_id);
+        return loop_id;
+    }
+
+    // Loops are generated in rotated form with a dedicated preheader and exit, which is the
+    // canonical form the loop passes expect and saves them from having to rotate the loop:
+    //
+    //         br cond, loop.preheader, loop.end    ; guard, omitted by do-while
+    //     loop.preheader:
+    //         br loop.body
+    //     loop.body:
+    //         <body>
+    //         <post expression>
+    //         br cond, loop.body, loop.exit         ; latch, carries !llvm.loop
+    //     loop.exit:
+    //         br loop.end
+    //     loop.end:
+    //
+    // A missing condition is an infinite loop.
+    template<typename Generate_Body>
+    static void generate_loop(Compiler_Context& context, const Expression* condition, const Expression* post_expr, const Attribute_List* attributes,
+                              bool const test_before_first_iteration, Generate_Body&& generate_body) {
+        llvm::MDNode* loop_metadata = make_loop_metadata(context, attributes);
+        llvm::Function* function = context.builder.GetInsertBlock()->getParent();
+        llvm::BasicBlock* preheader_block = llvm::BasicBlock::Create(context.handle, "loop.preheader", function);
+        llvm::BasicBlock* body_block = llvm::BasicBlock::Create(context.handle, "loop.body");
+        llvm::BasicBlock* exit_block = llvm::BasicBlock::Create(context.handle, "loop.exit");
+        llvm::BasicBlock* end_block = llvm::BasicBlock::Create(context.handle, "loop.end");
+
+        if(condition && test_before_first_iteration) {
+            // A condition that could not be generated has already reported its error. Branch on false instead
+            // so that the loop stays well-formed, every block ends up in the function and generation continues.
+            llvm::Value* guard = generate_condition(context, *condition);
+            if(!guard) {
+                guard = context.builder.getFalse();
+            }
+            context.builder.CreateCondBr(guard, preheader_block, end_block);
+        } else {
+            context.builder.CreateBr(preheader_block);
+        }
+        seal_block(context, preheader_block);
+
+        context.builder.SetInsertPoint(preheader_block);
+        context.builder.CreateBr(body_block);
+
+        // The body stays unsealed until the latch has been generated.
+        body_block->insertInto(function);
+        context.builder.SetInsertPoint(body_block);
+        generate_body();
+        if(post_expr) {
+            generate_expression(context, *post_expr);
+        }
+
+        llvm::BranchInst* latch = nullptr;
+        if(condition) {
+            llvm::Value* back_condition = generate_condition(context, *condition);
+            if(!back_condition) {
+                back_condition = context.builder.getFalse();
+            }
+            latch = context.builder.CreateCondBr(back_condition, body_block, exit_block);
+        } else {
+            latch = context.builder.CreateBr(body_block);
+        }
+
+        if(loop_metadata) {
+            latch->setMetadata(llvm::LLVMContext::MD_loop, loop_metadata);
+        }
+        seal_block(context, body_block);
+
+        if(condition) {
+            exit_block->insertInto(function);
+            seal_block(context, exit_block);
+            context.builder.SetInsertPoint(exit_block);
+            context.builder.CreateBr(end_block);
+        } else {
+            delete exit_block;
+        }
+
+        end_block->insertInto(function);
+        seal_block(context, end_block);
+        context.builder.SetInsertPoint(end_block);
+    }
+
+    static void generate_for_statement(Compiler_Context& context, const For_Statement& statement) {
+        // Variables declared by the init statement are visible only within the loop.
+        context.symbol_table.emplace_back();
+        push_debug_scope(context, statement);
+        if(statement.init) {
+            generate_statement(context, *statement.init);
+        }
+
+        generate_loop(context, statement.condition.get(), statement.post_expr.get(), statement.attributes.get(), true, [&context, &statement]() {
+            context.symbol_table.emplace_back();
+            generate_statement_list(context, *statement.statements);
+            context.symbol_table.pop_back();
+        });
+        pop_debug_scope(context);
+        context.symbol_table.pop_back();
+    }
+
+    static void generate_while_statement(Compiler_Context& context, const While_Statement& statement) {
+        generate_loop(context, statement.condition.get(), nullptr, statement.attributes.get(), true,
+                      [&context, &statement]() { generate_statement(context, *statement.block); });
+    }
+
+    static void generate_do_while_statement(Compiler_Context& context, const Do_While_Statement& statement) {
+        generate_loop(context, statement.condition.get(), nullptr, statement.attributes.get(), false,
+                      [&context, &statement]() { generate_statement(context, *statement.block); });
+    }
+
+    // Catches the common case of a slice that would outlive the array it refers to.
+    static bool refers_to_local_array(Compiler_Context& context, const Expression& expression) {
+        if(expression.node_type == AST_Node_Type::identifier_expression) {
+            Variable* variable = find_variable(context, static_cast<const Identifier_Expression&>(expression).identifier->name);
+            return variable && variable->type->isArrayTy();
+        } else {
+            return expression.node_type == AST_Node_Type::array_literal;
+        }
+    }
+
+    static void generate_return_statement(Compiler_Context& context, const Return_Statement& statement) {
+        if(!statement.expression) {
+            context.builder.CreateRetVoid();
+        } else {
+            llvm::Type* return_type = context.builder.GetInsertBlock()->getParent()->getReturnType();
+            if(is_slice_type(return_type) && refers_to_local_array(context, *statement.expression)) {
+                emit_compile_error(context, "Cannot return a slice of a local array");
+                return;
+            }
+
+            llvm::Value* value = generate_expression_as(context, *statement.expression, return_type);
+            if(!value) {
+                return;
+            }
+            context.builder.CreateRet(value);
+        }
+        start_unreachable_block(context);
+    }
+
+    static void generate_variable_declaration(Compiler_Context& context, const Variable_Declaration& declaration) {
+        const std::string& name = declaration.identifier->name;
+        llvm::Type* type = acquire_llvm_type(context, *declaration.type);
+        if(!type) {
+            emit_compile_error(context, "Unknown type of variable \"" + name + "\"");
+            return;
+        }
+
+        // The initializer is generated before the variable is declared, so it refers to any shadowed variable.
+        llvm::Value* value = llvm::Constant::getNullValue(type);
+        if(declaration.initializer) {
+            value = generate_expression_as(context, *declaration.initializer, type);
+            if(!value) {
+                return;
+            }
+        }
+
+        Variable* variable = declare_variable(context, name, type, declaration.is_mutable, is_unsigned_type(context, *declaration.type));
+        if(requires_stack_slot(type)) {
+            make_variable_alloca(context, *variable);
+        } else if(!llvm::isa<llvm::Constant>(value) && !value->hasName()) {
+            value->setName(name);
+        }
+        describe_variable(context, *variable, declaration, *declaration.type, 0);
+        store_variable(context, *variable, value);
+    }
+
+    static void generate_statement_list(Compiler_Context& context, const Statement_List& node) {
+        for(const auto& statement: node.statements) {
+            generate_statement(context, *statement);
+        }
+    }
+
+    static void generate_block_statement(Compiler_Context& context, const Block_Statement& statement) {
+        context.symbol_table.emplace_back();
+        push_debug_scope(context, statement);
+        generate_statement_list(context, *statement.statements);
+        pop_debug_scope(context);
+        context.symbol_table.pop_back();
+    }
+
+    static void generate_statement(Compiler_Context& context, const Statement& statement) {
+        set_debug_location(context, statement);
+        switch(statement.node_type) {
+            case AST_Node_Type::if_statement: {
+                return generate_if_statement(context, static_cast<const If_Statement&>(statement));
+            }
+
+            case AST_Node_Type::for_statement: {
+                return generate_for_statement(context, static_cast<const For_Statement&>(statement));
+            }
+
+            case AST_Node_Type::while_statement: {
+                return generate_while_statement(context, static_cast<const While_Statement&>(statement));
+            }
+
+            case AST_Node_Type::do_while_statement: {
+                return generate_do_while_statement(context, static_cast<const Do_While_Statement&>(statement));
+            }
+
+            case AST_Node_Type::return_statement: {
+                return generate_return_statement(context, static_cast<const Return_Statement&>(statement));
+            }
+
+            case AST_Node_Type::declaration_statement: {
+                return generate_variable_declaration(context, *static_cast<const Declaration_Statement&>(statement).var_decl);
+            }
+
+            case AST_Node_Type::block_statement: {
+                return generate_block_statement(context, static_cast<const Block_Statement&>(statement));
+            }
+
+            case AST_Node_Type::expression_statement: {
+                generate_expression(context, *static_cast<const Expression_Statement&>(statement).expr);
+                return;
+            }
+
+            default:
+                return;
+        }
+    }
+
+    // Literals and arithmetic on them are folded by the builder.
+    static bool is_constant_expression(const Expression& expression) {
+        switch(expression.node_type) {
+            case AST_Node_Type::integer_literal:
+            case AST_Node_Type::float_literal:
+            case AST_Node_Type::bool_literal: {
+                return true;
+            }
+
+            case AST_Node_Type::binary_expression: {
+                auto& binary_expression = static_cast<const Binary_Expression&>(expression);
+                return is_constant_expression(*binary_expression.lhs) && is_constant_expression(*binary_expression.rhs);
+            }
+
+            default:
+                return false;
+        }
+    }
+
+    // Global initializers must be constants. Anything that the builder cannot fold
+    // is handed over to the compile-time evaluator.
+    static llvm::Constant* generate_constant_initializer(Compiler_Context& context, const Expression& expression, llvm::Type* type) {
+        if(expression.node_type == AST_Node_Type::array_literal) {
+            auto& literal = static_cast<const Array_Literal&>(expression);
+            if(!type->isArrayTy() || literal.elements.size() != type->getArrayNumElements()) {
+                return nullptr;
+            }
+
+            std::vector<llvm::Constant*> elements;
+            for(const auto& element: literal.elements) {
+                llvm::Constant* value = generate_constant_initializer(context, *element, type->getArrayElementType());
+                if(!value) {
+                    return nullptr;
+                }
+                elements.push_back(value);
+            }
+            return llvm::ConstantArray::get(llvm::cast<llvm::ArrayType>(type), elements);
+        }
+
+        if(!is_constant_expression(expression)) {
+            if(!type->isIntegerTy()) {
+                return nullptr;
+            }
+
+            anton::Expected<Constant_Value, Evaluation_Error> result = context.evaluator.evaluate(expression);
+            if(!result) {
+                emit_compile_error(context, "Could not evaluate initializer at compile time: " + result.error().message);
+                return nullptr;
+            }
+            return make_constant(result.value(), type);
+        }
+
+        // Without an insertion point the builder's folder produces constants and never emits instructions.
+        llvm::IRBuilderBase::InsertPointGuard guard(context.builder);
+        context.builder.ClearInsertionPoint();
+        auto value = llvm::dyn_cast_or_null<llvm::Constant>(generate_operand(context, expression, type));
+        if(!value) {
+            return nullptr;
+        }
+
+        bool const is_signed = !is_unsigned(context, expression) && !value->getType()->isIntegerTy(1);
+        if(value->getType() == type) {
+            return value;
+        } else if(value->getType()->isIntegerTy() && type->isIntegerTy()) {
+            return llvm::ConstantExpr::getIntegerCast(value, type, is_signed);
+        } else if(value->getType()->isIntegerTy() && type->isFloatingPointTy()) {
+            return is_signed ? llvm::ConstantExpr::getSIToFP(value, type) : llvm::ConstantExpr::getUIToFP(value, type);
+        } else if(value->getType()->isFloatingPointTy() && type->isFloatingPointTy()) {
+            return llvm::ConstantExpr::getFPCast(value, type);
+        } else {
+            return nullptr;
+        }
+    }
+
+    static llvm::GlobalVariable* define_global_variable(Compiler_Context& context, const Variable_Declaration& declaration, const std::string& name) {
+        llvm::Type* type = acquire_llvm_type(context, *declaration.type);
+        if(!type) {
+            emit_compile_error(context, "Unknown type of global variable \"" + name + "\"");
+            return nullptr;
+        }
+
+        llvm::Constant* initializer = nullptr;
+        if(declaration.initializer) {
+            initializer = generate_constant_initializer(context, *declaration.initializer, type);
+            if(!initializer) {
+                emit_compile_error(context, "Initializer of global variable \"" + name + "\" is not a constant expression");
+                return nullptr;
+            }
+        } else {
+            initializer = llvm::Constant::getNullValue(type);
+        }
+
+        // Objects are immutable by default.
+        auto* variable = new llvm::GlobalVariable(*context.module, type, true, llvm::GlobalValue::ExternalLinkage, initializer, name);
+        if(is_unsigned_type(context, *declaration.type)) {
+            context.unsigned_objects.insert(variable);
+        }
+        if(describes_variables(context)) {
+            variable->addDebugInfo(context.debug_builder->createGlobalVariableExpression(context.debug_file, name, llvm::StringRef(), context.debug_file,
+                                                                                        static_cast<unsigned>(declaration.source_info.line + 1),
+                                                                                        get_debug_type(context, *declaration.type), false));
+        }
+        return variable;
+    }
+
+    static llvm::DISubroutineType* get_debug_function_type(Compiler_Context& context, const Function_Declaration& node) {
+        std::vector<llvm::Metadata*> types;
+        if(describes_variables(context)) {
+            types.push_back(get_debug_type(context, *node.return_type));
+            for(const auto& parameter: node.parameter_list->params) {
+                types.push_back(get_debug_type(context, *parameter->type));
+            }
+        }
+        return context.debug_builder->createSubroutineType(context.debug_builder->getOrCreateTypeArray(types));
+    }
+
+    // Describes the function in the debug info and attributes its prologue to its declaration.
+    static void begin_debug_function(Compiler_Context& context, const Function_Declaration& node, llvm::Function* function) {
+        if(!context.debug_builder) {
+            return;
+        }
+
+        unsigned const line = static_cast<unsigned>(node.source_info.line + 1);
+        llvm::DISubprogram::DISPFlags flags = llvm::DISubprogram::SPFlagDefinition;
+        if(context.options.optimization_level != Optimization_Level::O0) {
+            flags |= llvm::DISubprogram::SPFlagOptimized;
+        }
+        if(function->hasLocalLinkage()) {
+            flags |= llvm::DISubprogram::SPFlagLocalToUnit;
+        }
+        // Instances are named after their canonical name, e.g. `pow<i64>`.
+        llvm::DISubprogram* subprogram = context.debug_builder->createFunction(
+            context.debug_file, function->getName(), llvm::StringRef(), context.debug_file, line, get_debug_function_type(context, node), line,
+            llvm::DINode::FlagPrototyped, flags);
+        function->setSubprogram(subprogram);
+        context.debug_scopes.push_back(subprogram);
+        set_debug_location(context, node);
+    }
+
+    // `#[fast_math]` makes every assumption, `#[fast_math(associative, contract)]` the given ones.
+    static bool parse_fast_math_attribute(Compiler_Context& context, const Attribute& attribute, Fast_Math_Options& options) {
+        if(attribute.arguments.size() == 0) {
+            options.fast = true;
+            return true;
+        }
+
+        for(const Attribute_Argument& argument: attribute.arguments) {
+            if(argument.key.size() == 0 && argument.value == "associative") {
+                options.associative = true;
+            } else if(argument.key.size() == 0 && argument.value == "no_signed_zeros") {
+                options.no_signed_zeros = true;
+            } else if(argument.key.size() == 0 && argument.value == "reciprocal") {
+                options.reciprocal = true;
+            } else if(argument.key.size() == 0 && argument.value == "contract") {
+                options.contract = true;
+            } else {
+                emit_compile_error(context, "Unknown argument \"" + (argument.key.size() != 0 ? argument.key : argument.value) +
+                                   "\" of attribute \"fast_math\", expected associative, no_signed_zeros, reciprocal or contract");
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // The builder attaches the flags to the floating-point operations of the function. The backend reads
+    // the assumptions that it has options for from the attributes of the function.
+    static void apply_fast_math(Compiler_Context& context, const Fast_Math_Options& options, llvm::Function* function) {
+        llvm::FastMathFlags flags;
+        if(options.fast) {
+            flags.setFast();
+            function->addFnAttr("unsafe-fp-math", "true");
+            function->addFnAttr("no-nans-fp-math", "true");
+            function->addFnAttr("no-infs-fp-math", "true");
+        }
+        if(options.associative) {
+            flags.setAllowReassoc();
+        }
+        if(options.no_signed_zeros) {
+            flags.setNoSignedZeros();
+        }
+        if(options.reciprocal) {
+            flags.setAllowReciprocal();
+        }
+        if(options.contract) {
+            flags.setAllowContract(true);
+        }
+
+        if(flags.noSignedZeros()) {
+            function->addFnAttr("no-signed-zeros-fp-math", "true");
+        }
+        context.builder.setFastMathFlags(flags);
+    }
+
+    // Applies the attributes of the function and sets the fast-math flags of the builder for its body:
+    //   #[fast_math], #[fast_math(...)] add to the assumptions of the options
+    //   #[xray_always], #[xray_never] select it for instrumentation, with -fxray-instrument only
+    // Invalid attributes are errors.
+    static void apply_function_attributes(Compiler_Context& context, const Function_Declaration& node, llvm::Function* function) {
+        context.builder.clearFastMathFlags();
+        Fast_Math_Options fast_math = context.options.fast_math;
+        llvm::StringRef instrument;
+        if(node.attributes) {
+            for(const auto& attribute: node.attributes->attributes) {
+                if(attribute->name == "fast_math") {
+                    if(!parse_fast_math_attribute(context, *attribute, fast_math)) {
+                        return;
+                    }
+                    continue;
+                }
+
+                if(attribute->name != "xray_always" && attribute->name != "xray_never") {
+                    emit_compile_error(context, "Unknown function attribute \"" + attribute->name + "\"");
+                    return;
+                }
+
+                if(attribute->arguments.size() != 0) {
+                    emit_compile_error(context, "Attribute \"" + attribute->name + "\" takes no arguments");
+                    return;
+                }
+
+                llvm::StringRef const kind = attribute->name == "xray_always" ? "xray-always" : "xray-never";
+                if(!instrument.empty() && instrument != kind) {
+                    emit_compile_error(context, "Conflicting attributes \"xray_always\" and \"xray_never\" on function \"" + function->getName().str() + "\"");
+                    return;
+                }
+                instrument = kind;
+            }
+        }
+
+        apply_fast_math(context, fast_math, function);
+        if(!context.options.xray_instrument) {
+            return;
+        }
+
+        if(!instrument.empty()) {
+            function->addFnAttr("function-instrument", instrument);
+        } else {
+            // The backend counts the machine instructions of the function against the threshold.
+            function->addFnAttr("xray-instruction-threshold", std::to_string(context.options.xray_instruction_threshold));
+        }
+    }
+
+    static void generate_function_body(Compiler_Context& context, const Function_Declaration& node, llvm::Function* function) {
+        apply_function_attributes(context, node, function);
+        auto block = llvm::BasicBlock::Create(context.handle, "", function);
+        context.builder.SetInsertPoint(block);
+        begin_debug_function(context, node, function);
+        // The entry block has no predecessors.
+        seal_block(context, block);
+        context.symbol_table.emplace_back();
+        u64 arg_idx = 0;
+        for(auto& arg: function->args()) {
+            const Function_Parameter& parameter = *node.parameter_list->params[arg_idx++];
+            arg.setName(parameter.identifier->name);
+            Variable* variable = declare_variable(context, parameter.identifier->name, arg.getType(), false, is_unsigned_type(context, *parameter.type));
+            if(requires_stack_slot(arg.getType())) {
+                make_variable_alloca(context, *variable);
+            }
+            describe_variable(context, *variable, parameter, *parameter.type, arg_idx);
+            store_variable(context, *variable, &arg);
+        }
+        generate_statement_list(context, *node.body->statements);
+
+        llvm::BasicBlock* last_block = context.builder.GetInsertBlock();
+        if(last_block != block && last_block->empty() && llvm::pred_empty(last_block)) {
+            last_block->eraseFromParent();
+        } else if(!is_block_terminated(last_block)) {
+            if(function->getReturnType()->isVoidTy()) {
+                context.builder.CreateRetVoid();
+            } else {
+                // Flowing off the end of a non-void function.
+                context.builder.CreateUnreachable();
+            }
+        }
+
+        context.builder.ClearInsertionPoint();
+        // Locations must not leak into the next function, which has a subprogram of its own.
+        context.builder.SetCurrentDebugLocation(llvm::DebugLoc());
+        context.debug_scopes.clear();
+        context.symbol_table.pop_back();
+        context.variables.clear();
+        context.sealed_blocks.clear();
+        context.incomplete_phis.clear();
+    }
+
+    // A function may be declared any number of times before or after its definition.
+    static void generate_function(Compiler_Context& context, const Function_Declaration& node) {
+        const std::string& name = node.name->name;
+        llvm::Function* function = find_function(context, name);
+        if(!function) {
+            function = declare_function(context, node, name);
+        } else if(function->getFunctionType() != get_function_type(context, node)) {
+            emit_compile_error(context, "Conflicting declarations of function \"" + name + "\"");
+            return;
+        } else if(node.body && !function->isDeclaration()) {
+            emit_compile_error(context, "Redefinition of function \"" + name + "\"");
+            return;
+        }
+
+        if(node.body) {
+            generate_function_body(context, node, function);
+        }
+    }
+
+    static void register_template(Compiler_Context& context, const AST_Node& node) {
+        switch(node.node_type) {
+            case AST_Node_Type::function_declaration: {
+                auto& declaration = static_cast<const Function_Declaration&>(node);
+                if(declaration.template_parameters) {
+                    const std::string& name = declaration.name->name;
+                    if(!declaration.body) {
+                        emit_compile_error(context, "Function template \"" + name + "\" must be defined where it is declared");
+                    } else if(!context.function_templates.emplace(name, &declaration).second) {
+                        emit_compile_error(context, "Redefinition of function template \"" + name + "\"");
+                    }
+                }
+            } break;
+
+            case AST_Node_Type::variable_declaration: {
+                auto& declaration = static_cast<const Variable_Declaration&>(node);
+                if(declaration.template_parameters) {
+                    const std::string& name = declaration.identifier->name;
+                    if(!context.variable_templates.emplace(name, &declaration).second) {
+                        emit_compile_error(context, "Redefinition of variable template \"" + name + "\"");
+                    }
+                }
+            } break;
+
+            default:
+                return;
+        }
+    }
+
+    static const std::string& get_declaration_name(const Declaration& node) {
+        if(node.node_type == AST_Node_Type::function_declaration) {
+            return static_cast<const Function_Declaration&>(node).name->name;
+        } else {
+            return static_cast<const Variable_Declaration&>(node).identifier->name;
+        }
+    }
+
+    static void generate_node(Compiler_Context& context, const AST_Node& node) {
+        switch(node.node_type) {
+            case AST_Node_Type::function_declaration: {
+                auto& declaration = static_cast<const Function_Declaration&>(node);
+                if(!declaration.template_parameters) {
+                    generate_function(context, declaration);
+                }
+            } break;
+
+            case AST_Node_Type::variable_declaration: {
+                auto& declaration = static_cast<const Variable_Declaration&>(node);
+                if(!declaration.template_parameters) {
+                    define_global_variable(context, declaration, declaration.identifier->name);
+                }
+            } break;
+
+            default:
+                return;
+        }
+    }
+
+    static void generate_pending_instantiations(Compiler_Context& context) {
+        // Instances are lowered after all declarations, hence they see every function and global variable.
+        if(context.unit_declarations) {
+            context.visible_declarations = static_cast<i64>(context.unit_declarations->nodes.size());
+        }
+
+        // Lowering an instance may request further instances, therefore we cannot use iterators.
+        for(u64 i = 0; i < context.pending_instantiations.size(); ++i) {
+            Pending_Instantiation instantiation = std::move(context.pending_instantiations[i]);
+            llvm::StringRef const name = instantiation.function->getName();
+            Time_Scope const scope("Instantiate template", std::string_view(name.data(), name.size()));
+            context.template_arguments = std::move(instantiation.arguments);
+            generate_function_body(context, *instantiation.declaration, instantiation.function);
+        }
+        context.template_arguments.clear();
+        context.pending_instantiations.clear();
+    }
+
+    // Splits the module into one partition per code generation thread and runs instruction selection
+    // and emission of every partition in parallel, each in a context of its own. Partition i is written
+    // to buffers[i]. Together the partitions define the same symbols as the unsplit module would.
+    static bool emit_partitioned_code(Compiler_Context& context, llvm::CodeGenFileType const file_type, std::vector<Output_Buffer>& buffers) {
+        // Target machines are not thread-safe, every partition needs its own. They are created up front
+        // so that a failure is reported here instead of handing a null machine to the code generator.
+        std::vector<std::unique_ptr<llvm::TargetMachine>> target_machines;
+        for(i64 i = 0; i < context.options.codegen_threads; ++i) {
+            anton::Expected<std::unique_ptr<llvm::TargetMachine>, std::string> result = Backend_Session::get().create_target_machine(context.target);
+            if(!result) {
+                emit_compile_error(context, "Could not set up the backend: " + result.error());
+                return false;
+            }
+            target_machines.push_back(std::move(result.value()));
+        }
+
+        buffers.resize(context.options.codegen_threads);
+        std::vector<std::unique_ptr<llvm::raw_svector_ostream>> outputs;
+        std::vector<llvm::raw_pwrite_stream*> streams;
+        for(Output_Buffer& buffer: buffers) {
+            outputs.push_back(std::make_unique<llvm::raw_svector_ostream>(buffer));
+            streams.push_back(outputs.back().get());
+        }
+
+        // The factory is called once per partition, possibly from the worker threads.
+        std::atomic<i64> next_target_machine = 0;
+        auto make_target_machine = [&target_machines, &next_target_machine]() -> std::unique_ptr<llvm::TargetMachine> {
+            return std::move(target_machines[next_target_machine++]);
+        };
+        context.module = llvm::splitCodeGen(std::move(context.module), streams, {}, make_target_machine, file_type);
+        return true;
+    }
+
+    static bool emit_code(Compiler_Context& context, std::vector<Output_Buffer>& buffers) {
+        Time_Scope const scope("Emit code");
+        Output_Kind kind = context.options.output_kind;
+        bool const thin_lto = context.options.lto == LTO_Mode::thin;
+        if(thin_lto && kind == Output_Kind::object) {
+            kind = Output_Kind::llvm_bitcode;
+        } else if(thin_lto && kind == Output_Kind::assembly) {
+            kind = Output_Kind::llvm_ir;
+        }
+
+        if(kind == Output_Kind::llvm_ir || kind == Output_Kind::llvm_bitcode) {
+            buffers.resize(1);
+            llvm::raw_svector_ostream output(buffers[0]);
+            if(kind == Output_Kind::llvm_ir) {
+                context.module->print(output, nullptr);
+            } else if(thin_lto) {
+                // The thin link decides on imports from the summary alone. The hash of the module lets the
+                // link step reuse the code of modules whose imports did not change.
+                llvm::legacy::PassManager pass_manager;
+                pass_manager.add(llvm::createBitcodeWriterPass(output, false, true, true));
+                pass_manager.run(*context.module);
+            } else {
+                llvm::WriteBitcodeToFile(*context.module, output);
+            }
+            return true;
+        }
+
+        llvm::CodeGenFileType const file_type = kind == Output_Kind::assembly ? llvm::CGFT_AssemblyFile : llvm::CGFT_ObjectFile;
+        if(context.options.codegen_threads > 1) {
+            return emit_partitioned_code(context, file_type, buffers);
+        }
+
+        buffers.resize(1);
+        llvm::raw_svector_ostream output(buffers[0]);
+        llvm::legacy::PassManager pass_manager;
+        if(context.target_machine.addPassesToEmitFile(pass_manager, output, nullptr, file_type)) {
+            emit_compile_error(context, "The target cannot emit " + std::string(kind == Output_Kind::assembly ? "assembly" : "object files"));
+            return false;
+        }
+        pass_manager.run(*context.module);
+        return true;
+    }
+
+    static llvm::CodeGenOpt::Level get_codegen_level(Optimization_Level const level) {
+        switch(level) {
+            case Optimization_Level::O0:
+                return llvm::CodeGenOpt::None;
+            case Optimization_Level::O1:
+                return llvm::CodeGenOpt::Less;
+            case Optimization_Level::O3:
+                return llvm::CodeGenOpt::Aggressive;
+            default:
+                return llvm::CodeGenOpt::Default;
+        }
+    }
+
+    // The instrumentation references the profile runtime only on targets where the linker driver
+    // does not do so. Referencing it from every instrumented module lets the runtime be linked as
+    // a plain static library on every target.
+    static void add_profile_runtime_reference(llvm::Module& module) {
+        llvm::LLVMContext& llvm_context = module.getContext();
+        llvm::Type* const int_type = llvm::Type::getInt32Ty(llvm_context);
+        llvm::Constant* const runtime = module.getOrInsertGlobal(llvm::getInstrProfRuntimeHookVarName(), int_type);
+        llvm::Function* const user = llvm::Function::Create(llvm::FunctionType::get(int_type, false), llvm::GlobalValue::LinkOnceODRLinkage,
+                                                            llvm::getInstrProfRuntimeHookVarUseFuncName(), module);
+        user->setVisibility(llvm::GlobalValue::HiddenVisibility);
+        user->addFnAttr(llvm::Attribute::NoInline);
+        llvm::IRBuilder<> builder(llvm::BasicBlock::Create(llvm_context, "", user));
+        builder.CreateRet(builder.CreateLoad(int_type, runtime));
+        llvm::appendToUsed(module, {user});
+    }
+
+    // Runs the new pass manager pipeline of the optimization level. -O0 runs no passes at all.
+    static void optimize_module(Compiler_Context& context) {
+        llvm::PassBuilder::OptimizationLevel level;
+        switch(context.options.optimization_level) {
+            case Optimization_Level::O0:
+                return;
+            case Optimization_Level::O1:
+                level = llvm::PassBuilder::O1;
+                break;
+            case Optimization_Level::O2:
+                level = llvm::PassBuilder::O2;
+                break;
+            case Optimization_Level::O3:
+                level = llvm::PassBuilder::O3;
+                break;
+            case Optimization_Level::Os:
+                level = llvm::PassBuilder::Os;
+                break;
+            case Optimization_Level::Oz:
+                level = llvm::PassBuilder::Oz;
+                break;
+        }
+
+        Time_Scope const scope("Optimize module");
+        // Same vectorizer defaults as clang: enabled from -O2 on, the loop vectorizer not at -Oz.
+        llvm::PipelineTuningOptions tuning_options;
+        Optimization_Level const optimization_level = context.options.optimization_level;
+        tuning_options.LoopVectorization = optimization_level != Optimization_Level::O1 && optimization_level != Optimization_Level::Oz;
+        tuning_options.SLPVectorization = optimization_level != Optimization_Level::O1;
+
+        llvm::Optional<llvm::PGOOptions> pgo_options;
+        if(context.options.profile_mode == Profile_Mode::generate) {
+            pgo_options = llvm::PGOOptions(context.options.profile_path, "", "", llvm::PGOOptions::IRInstr);
+        } else if(context.options.profile_mode == Profile_Mode::use) {
+            pgo_options = llvm::PGOOptions(context.options.profile_path, "", "", llvm::PGOOptions::IRUse);
+        }
+
+        if(context.options.profile_mode == Profile_Mode::generate) {
+            add_profile_runtime_reference(*context.module);
+        }
+
+        // With the target machine the passes get the cost model of the target instead of a generic one.
+        llvm::PassInstrumentationCallbacks instrumentation;
+        register_pass_timing(instrumentation);
+        llvm::PassBuilder pass_builder(&context.target_machine, tuning_options, pgo_options, &instrumentation);
+        if(context.options.profile_mode == Profile_Mode::use) {
+            // Outlines the blocks that the profile shows to be cold, so that hot code is packed more densely.
+            pass_builder.registerOptimizerLastEPCallback([](llvm::ModulePassManager& pass_manager, llvm::PassBuilder::OptimizationLevel) {
+                pass_manager.addPass(llvm::HotColdSplittingPass());
+            });
+        }
+        if(level == llvm::PassBuilder::O2 || level == llvm::PassBuilder::O3) {
+            // Splits loops whose induction variable indexes arrays into a main loop, in which every index is provably
+            // in bounds and which runs without bounds checks, and pre- and post-loops for the remaining iterations.
+            // Bounds checks that became loop invariant, e.g. because the loop reads a prefix of a slice, are hoisted
+            // out of the loop. Checks that are implied by the loop condition are removed by the default pipeline already.
+            pass_builder.registerLateLoopOptimizationsEPCallback([](llvm::LoopPassManager& pass_manager, llvm::PassBuilder::OptimizationLevel) {
+                pass_manager.addPass(llvm::IRCEPass());
+                pass_manager.addPass(llvm::SimpleLoopUnswitchPass());
+            });
+        }
+        llvm::LoopAnalysisManager loop_analysis_manager(false);
+        llvm::FunctionAnalysisManager function_analysis_manager(false);
+        llvm::CGSCCAnalysisManager CGSCC_analysis_manager(false);
+        llvm::ModuleAnalysisManager module_analysis_manager(false);
+        pass_builder.registerModuleAnalyses(module_analysis_manager);
+        pass_builder.registerCGSCCAnalyses(CGSCC_analysis_manager);
+        pass_builder.registerFunctionAnalyses(function_analysis_manager);
+        pass_builder.registerLoopAnalyses(loop_analysis_manager);
+        pass_builder.crossRegisterProxies(loop_analysis_manager, function_analysis_manager, CGSCC_analysis_manager, module_analysis_manager);
+        // The pre-link pipeline leaves out the passes that the link step runs once functions have been imported.
+        llvm::ModulePassManager module_pass_manager = context.options.lto == LTO_Mode::thin ? pass_builder.buildThinLTOPreLinkDefaultPipeline(level, false)
+                                                                                            : pass_builder.buildPerModuleDefaultPipeline(level, false);
+        module_pass_manager.run(*context.module, module_analysis_manager);
+    }
+
+    Target_Description make_target_description(const Codegen_Options& options) {
+        Target_Description target = options.target;
+        target.optimization = get_codegen_level(options.optimization_level);
+        return target;
+    }
+
+    anton::Expected<std::string, std::string> describe_output_options(const Codegen_Options& options) {
+        Target_Description const target = make_target_description(options);
+        anton::Expected<llvm::TargetMachine*, std::string> target_machine = Backend_Session::get().get_target_machine(target);
+        if(!target_machine) {
+            return {anton::expected_error, std::move(target_machine.error())};
+        }
+
+        std::string description;
+        llvm::raw_string_ostream output(description);
+        llvm::TargetMachine& machine = *target_machine.value();
+        output << "triple=" << machine.getTargetTriple().str() << ";cpu=" << machine.getTargetCPU() << ";features=" << machine.getTargetFeatureString()
+               << ";global-isel=" << target.global_isel << ";level=" << static_cast<i64>(options.optimization_level)
+               << ";template-comdat=" << options.deduplicate_instantiations << ";constant-evaluation=" << options.evaluate_constant_calls
+               << ";constexpr-steps=" << options.evaluation_limits.max_steps << ";constexpr-memory=" << options.evaluation_limits.max_memory
+               << ";codegen-threads=" << options.codegen_threads << ";output=" << static_cast<i64>(options.output_kind)
+               << ";lto=" << static_cast<i64>(options.lto) << ";profile=" << static_cast<i64>(options.profile_mode)
+               << ";debug=" << static_cast<i64>(options.debug_info) << ";remarks=" << options.remarks.enabled() << ";xray=" << options.xray_instrument;
+        if(options.xray_instrument) {
+            output << ";xray-threshold=" << options.xray_instruction_threshold;
+        }
+        const Fast_Math_Options& fast_math = options.fast_math;
+        output << ";fast-math=" << fast_math.fast << fast_math.associative << fast_math.no_signed_zeros << fast_math.reciprocal << fast_math.contract;
+        output << ";overflow=" << static_cast<i64>(options.overflow);
+        if(options.profile_mode == Profile_Mode::generate) {
+            // The path is embedded in the objects.
+            output << ";profile-path=" << options.profile_path;
+        } else if(options.profile_mode == Profile_Mode::use) {
+            llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> profile = llvm::MemoryBuffer::getFile(options.profile_path);
+            if(!profile) {
+                return {anton::expected_error, "could not read profile '" + options.profile_path + "'"};
+            }
+            output << ";profile-hash=" << llvm::toHex(llvm::SHA1::hash(llvm::arrayRefFromStringRef(profile.get()->getBuffer())));
+        }
+        return {anton::expected_value, std::move(output.str())};
+    }
+
+    static llvm::DICompileUnit::DebugEmissionKind get_debug_emission_kind(Debug_Info_Level const level) {
+        switch(level) {
+            case Debug_Info_Level::full:
+                return llvm::DICompileUnit::FullDebug;
+            case Debug_Info_Level::line_tables_only:
+                return llvm::DICompileUnit::LineTablesOnly;
+            default:
+                // Only the locations of the remarks.
+                return llvm::DICompileUnit::NoDebug;
+        }
+    }
+
+    // Creates the compile unit of the module if the options ask for debug info. The source is named
+    // by its absolute path, so that the debug info does not depend on the working directory.
+    static void start_debug_info(Compiler_Context& context, std::string_view const source_path) {
+        if(context.options.debug_info == Debug_Info_Level::none && !context.options.remarks.enabled()) {
+            return;
+        }
+
+        std::filesystem::path const path = std::filesystem::absolute(std::filesystem::path(source_path));
+        context.debug_builder = std::make_unique<llvm::DIBuilder>(*context.module);
+        context.debug_file = context.debug_builder->createFile(path.filename().string(), path.parent_path().string());
+        llvm::DICompileUnit::DebugEmissionKind const kind = get_debug_emission_kind(context.options.debug_info);
+        bool const optimized = context.options.optimization_level != Optimization_Level::O0;
+        context.debug_builder->createCompileUnit(llvm::dwarf::DW_LANG_C99, context.debug_file, "tildac", optimized, "", 0, "", kind);
+        if(kind != llvm::DICompileUnit::NoDebug) {
+            context.module->addModuleFlag(llvm::Module::Warning, "Dwarf Version", 4);
+        }
+        context.module->addModuleFlag(llvm::Module::Warning, "Debug Info Version", llvm::DEBUG_METADATA_VERSION);
+    }
+
+    // Opens the file that the remarks of the passes are recorded into. Returns false if it could not be opened.
+    static bool start_remark_record(Compiler_Context& context) {
+        const std::string& path = context.options.remarks.record_path;
+        if(path.empty()) {
+            return true;
+        }
+
+        llvm::Expected<std::unique_ptr<llvm::ToolOutputFile>> record = llvm::setupOptimizationRemarks(context.handle, path, "", "yaml", false);
+        if(!record) {
+            emit_compile_error(context, "Could not record the optimization remarks into '" + path + "': " + llvm::toString(record.takeError()));
+            return false;
+        }
+        context.remark_record = std::move(record.get());
+        return true;
+    }
+
+    // The debug info has to be complete before the optimizer transforms it.
+    static void finish_debug_info(Compiler_Context& context) {
+        if(context.debug_builder) {
+            context.debug_builder->finalize();
+        }
+    }
+
+    // A module is optimized and emitted only if the program has no errors and the module is valid.
+    static bool check_generated_module(Compiler_Context& context) {
+        if(context.error_count != 0) {
+            return false;
+        }
+
+        if(llvm::verifyModule(*context.module, &llvm::errs())) {
+            emit_compile_error(context, "Generated an invalid module");
+            return false;
+        }
+        return true;
+    }
+
+    // Lowers all declarations into the module of the context and optimizes it.
+    // Returns false if the program has errors.
+    static bool generate_and_optimize(Compiler_Context& context, const std::vector<Owning_Ptr<Declaration>>& nodes) {
+        // Templates may be used before they are declared.
+        for(const auto& node: nodes) {
+            register_template(context, *node);
+        }
+
+        for(const auto& node: nodes) {
+            Time_Scope const scope("Generate declaration", get_declaration_name(*node));
+            generate_node(context, *node);
+        }
+        generate_pending_instantiations(context);
+
+        finish_debug_info(context);
+        if(!check_generated_module(context)) {
+            return false;
+        }
+
+        record_module_size(Module_Stage::generated, *context.module);
+        optimize_module(context);
+        record_module_size(Module_Stage::optimized, *context.module);
+        return true;
+    }
+
+    // The targets that the XRay runtime supports.
+    static bool check_xray_support(const Codegen_Options& options, const llvm::TargetMachine& target_machine) {
+        if(!options.xray_instrument) {
+            return true;
+        }
+
+        const llvm::Triple& triple = target_machine.getTargetTriple();
+        bool supported = triple.getArch() == llvm::Triple::x86_64 && (triple.isOSLinux() || triple.isOSFreeBSD() || triple.isOSNetBSD() ||
+                                                                      triple.isOSOpenBSD() || triple.isMacOSX());
+        if(triple.isOSLinux()) {
+            switch(triple.getArch()) {
+                case llvm::Triple::arm:
+                case llvm::Triple::aarch64:
+                case llvm::Triple::ppc64le:
+                case llvm::Triple::mips:
+                case llvm::Triple::mipsel:
+                case llvm::Triple::mips64:
+                case llvm::Triple::mips64el:
+                    supported = true;
+                    break;
+
+                default:
+                    break;
+            }
+        }
+
+        if(!supported) {
+            emit_compile_error("XRay does not support the target " + triple.str());
+        }
+        return supported;
+    }
+
+    Generated_Module generate_module(const std::vector<Owning_Ptr<Declaration>>& nodes, const Codegen_Options& options) {
+        Target_Description const target = make_target_description(options);
+        anton::Expected<llvm::TargetMachine*, std::string> target_machine = Backend_Session::get().get_target_machine(target);
+        if(!target_machine) {
+            emit_compile_error("Could not set up the backend: " + target_machine.error());
+            return {};
+        }
+
+        Compiler_Context context{nodes, options, target, *target_machine.value()};
+        if(!generate_and_optimize(context, nodes)) {
+            return {};
+        }
+        return {std::move(context.owned_handle), std::move(context.module)};
+    }
+
+    bool generate(const std::vector<Owning_Ptr<Declaration>>& nodes, std::string_view const source_path, const Codegen_Options& options,
+                  std::vector<Output_Buffer>& buffers) {
+        Target_Description const target = make_target_description(options);
+        anton::Expected<llvm::TargetMachine*, std::string> target_machine = Backend_Session::get().get_target_machine(target);
+        if(!target_machine) {
+            emit_compile_error("Could not set up the backend: " + target_machine.error());
+            return false;
+        }
+
+        if(!check_xray_support(options, *target_machine.value())) {
+            return false;
+        }
+
+        Compiler_Context context{nodes, options, target, *target_machine.value()};
+        context.module->setModuleIdentifier(llvm::StringRef(source_path.data(), source_path.size()));
+        context.module->setSourceFileName(llvm::StringRef(source_path.data(), source_path.size()));
+        start_debug_info(context, source_path);
+        if(!start_remark_record(context)) {
+            return false;
+        }
+
+        if(!generate_and_optimize(context, nodes) || !emit_code(context, buffers)) {
+            return false;
+        }
+
+        if(context.remark_record) {
+            context.remark_record->keep();
+        }
+        return true;
+    }
+
+    Unit_Declarations::Unit_Declarations(const std::vector<Owning_Ptr<Declaration>>& nodes, const Evaluation_Limits& limits,
+                                         Overflow_Policy const overflow)
+        : nodes(nodes), evaluator(nodes, limits, overflow) {
+        for(i64 i = 0; i < static_cast<i64>(nodes.size()); ++i) {
+            const Declaration& node = *nodes[i];
+            if(node.node_type == AST_Node_Type::function_declaration) {
+                auto& declaration = static_cast<const Function_Declaration&>(node);
+                if(declaration.template_parameters) {
+                    templates.push_back(i);
+                } else {
+                    declarations[declaration.name->name].push_back(i);
+                    if(declaration.body) {
+                        function_units.push_back(i);
+                    }
+                }
+            } else if(node.node_type == AST_Node_Type::variable_declaration) {
+                auto& declaration = static_cast<const Variable_Declaration&>(node);
+                if(declaration.template_parameters) {
+                    templates.push_back(i);
+                } else {
+                    declarations[declaration.identifier->name].push_back(i);
+                }
+            }
+        }
+    }
+
+    // A full compilation reports conflicts at the later of two declarations. A unit only lowers its
+    // own definition, hence it checks the definition against every other declaration of the function.
+    static bool check_unit_declarations(Compiler_Context& context, i64 const unit) {
+        const std::vector<Owning_Ptr<Declaration>>& nodes = context.unit_declarations->nodes;
+        auto& definition = static_cast<const Function_Declaration&>(*nodes[unit]);
+        const std::string& name = definition.name->name;
+        llvm::FunctionType* function_type = get_function_type(context, definition);
+        for(i64 const index: context.unit_declarations->declarations.at(name)) {
+            if(index == unit || nodes[index]->node_type != AST_Node_Type::function_declaration) {
+                continue;
+            }
+
+            auto& declaration = static_cast<const Function_Declaration&>(*nodes[index]);
+            if(get_function_type(context, declaration) != function_type) {
+                emit_compile_error(context, "Conflicting declarations of function \"" + name + "\"");
+                return false;
+            } else if(index < unit && declaration.body) {
+                emit_compile_error(context, "Redefinition of function \"" + name + "\"");
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool generate_unit(Unit_Declarations& declarations, i64 const unit, std::string_view const source_path, const Codegen_Options& options,
+                       Output_Buffer& buffer) {
+        Target_Description const target = make_target_description(options);
+        anton::Expected<llvm::TargetMachine*, std::string> target_machine = Backend_Session::get().get_target_machine(target);
+        if(!target_machine) {
+            emit_compile_error("Could not set up the backend: " + target_machine.error());
+            return false;
+        }
+
+        if(!check_xray_support(options, *target_machine.value())) {
+            return false;
+        }
+
+        Codegen_Options unit_options = options;
+        unit_options.codegen_threads = 1;
+        Compiler_Context context{declarations.nodes, unit_options, target, *target_machine.value(), &declarations.evaluator};
+        context.unit_declarations = &declarations;
+        context.module->setModuleIdentifier(llvm::StringRef(source_path.data(), source_path.size()));
+        context.module->setSourceFileName(llvm::StringRef(source_path.data(), source_path.size()));
+        start_debug_info(context, source_path);
+        for(i64 const index: declarations.templates) {
+            register_template(context, *declarations.nodes[index]);
+        }
+
+        if(unit == global_variables_unit) {
+            for(const auto& node: declarations.nodes) {
+                if(node->node_type == AST_Node_Type::variable_declaration) {
+                    Time_Scope const scope("Generate declaration", get_declaration_name(*node));
+                    generate_node(context, *node);
+                }
+            }
+        } else {
+            Time_Scope const scope("Generate declaration", get_declaration_name(*declarations.nodes[unit]));
+            // The function may call itself and every function that is declared before it.
+            context.visible_declarations = unit + 1;
+            if(check_unit_declarations(context, unit)) {
+                generate_function(context, static_cast<const Function_Declaration&>(*declarations.nodes[unit]));
+            }
+        }
+        generate_pending_instantiations(context);
+        finish_debug_info(context);
+        if(!check_generated_module(context)) {
+            return false;
+        }
+
+        record_module_size(Module_Stage::generated, *context.module);
+        optimize_module(context);
+        record_module_size(Module_Stage::optimized, *context.module);
+
+        std::vector<Output_Buffer> buffers;
+        if(!emit_code(context, buffers)) {
+            return false;
+        }
+        buffer = std::move(buffers[0]);
+        return true;
     }
 } // namespace tildac
\ No newline at end of file
@@ -3,9 +3,190 @@
 
 #include <tildac/utility.hpp>
 #include <tildac/ast.hpp>
+#include <tildac/backend.hpp>
+#include <tildac/constant_evaluation.hpp>
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 namespace tildac {
-    void generate(const std::vector<Owning_Ptr<AST_Node>>& nodes, const bool optimize);
+    enum struct Optimization_Level {
+        // No optimization and the fast instruction selector.
+        O0,
+        O1,
+        O2,
+        O3,
+        // O2 that avoids transformations that grow the code.
+        Os,
+        // Os that also gives up speed for size.
+        Oz,
+    };
+
+    enum struct Output_Kind {
+        object,
+        assembly,
+        // Textual IR.
+        llvm_ir,
+        llvm_bitcode,
+    };
+
+    enum struct LTO_Mode {
+        none,
+        // Objects are bitcode with a summary of the module, which link_thin optimizes and compiles
+        // together with the other modules of the program.
+        thin,
+    };
+
+    enum struct Profile_Mode {
+        none,
+        // Count the executions of blocks. Programs must be linked with the profile runtime.
+        generate,
+        // Annotate branch weights and function entry counts from an indexed profile.
+        use,
+    };
+
+    enum struct Debug_Info_Level {
+        none,
+        // The locations of the instructions and the functions that contain them, which is all that
+        // profilers and symbolizers need.
+        line_tables_only,
+        // Also the types, parameters and local variables.
+        full,
+    };
+
+    // Optimization remarks tell which transformations the passes applied or missed and why. The patterns
+    // are regular expressions that select the passes by name. Empty patterns select none.
+    struct Remark_Options {
+        // -Rpass, transformations that were applied.
+        std::string passed;
+        // -Rpass-missed, transformations that were not applied.
+        std::string missed;
+        // -Rpass-analysis, the reasons for the decisions.
+        std::string analysis;
+        // Records the remarks of all passes in YAML into this file. Empty records none.
+        std::string record_path;
+
+        [[nodiscard]] bool enabled() const {
+            return !passed.empty() || !missed.empty() || !analysis.empty() || !record_path.empty();
+        }
+    };
+
+    // Assumptions about floating-point arithmetic beyond IEEE 754 that the optimizer may make, e.g. to vectorize
+    // reductions or to fuse multiplications and additions into FMA instructions. Functions marked `#[fast_math]`
+    // make all of them, functions marked e.g. `#[fast_math(contract)]` make the given ones in addition to these.
+    struct Fast_Math_Options {
+        // -ffast-math, all of the below. Also that no values are NaN or infinite and that functions may be approximated.
+        bool fast = false;
+        // -fassociative-math, operations may be reassociated, e.g. to sum up the elements of an array in several lanes.
+        bool associative = false;
+        // -fno-signed-zeros, the sign of zero may be ignored.
+        bool no_signed_zeros = false;
+        // -freciprocal-math, divisions may be replaced by multiplications with the reciprocal.
+        bool reciprocal = false;
+        // -ffp-contract=fast, a multiplication and an addition may be fused and rounded once.
+        bool contract = false;
+    };
+
+    struct Codegen_Options {
+        // The default triple is the host. The code generation level is derived from optimization_level.
+        Target_Description target;
+        Optimization_Level optimization_level = Optimization_Level::O2;
+        // Emit template instances as linkonce_odr (placed in a comdat where the object format supports it)
+        // so that the linker keeps a single copy of every instance across translation units.
+        // Otherwise each object file gets its own internal copy.
+        bool deduplicate_instantiations = true;
+        // Replace calls to pure functions with constant arguments by their results.
+        bool evaluate_constant_calls = true;
+        // Budget of the compile-time evaluator for a single call or global initializer.
+        Evaluation_Limits evaluation_limits;
+        // Number of threads that run instruction selection and emission. With more than one thread
+        // the module is split into that many partitions, each emitted into a buffer of its own.
+        i64 codegen_threads = 1;
+        Output_Kind output_kind = Output_Kind::object;
+        // With thin LTO the module only runs the pre-link pipeline. Objects are emitted as bitcode and
+        // assembly as textual IR, leaving code generation to the link step.
+        LTO_Mode lto = LTO_Mode::none;
+        // Requires optimizations. With generate, profile_path is the raw profile that programs write by default.
+        // With use, it is the indexed profile that guides inlining, block layout and hot/cold splitting.
+        Profile_Mode profile_mode = Profile_Mode::none;
+        std::string profile_path;
+        // Debug info refers to the source by its absolute path. Modules that are only run by the JIT carry none.
+        Debug_Info_Level debug_info = Debug_Info_Level::none;
+        // Remarks refer to the source by the locations of the instructions, which modules carry without debug info
+        // when remarks are enabled. Remarks of the JIT refer to functions only.
+        Remark_Options remarks;
+        // Emits XRay sleds, which the XRay runtime patches into calls of its handlers while the program runs.
+        // Functions marked `#[xray_always]` are instrumented and functions marked `#[xray_never]` are not.
+        // Other functions are instrumented if they contain a loop or at least xray_instruction_threshold
+        // machine instructions. Programs must be linked with the XRay runtime, e.g. by `clang -fxray-instrument`.
+        bool xray_instrument = false;
+        i64 xray_instruction_threshold = 200;
+        Fast_Math_Options fast_math;
+        // Integers are signed or unsigned by the first letter of their type. Their addition, subtraction and multiplication
+        // carry the nsw or nuw flag with Overflow_Policy::undefined and check for overflow with Overflow_Policy::trap.
+        Overflow_Policy overflow = Overflow_Policy::wrap;
+    };
+
+    using Output_Buffer = llvm::SmallVector<char, 0>;
+
+    // An optimized module together with the context that owns its types and constants.
+    struct Generated_Module {
+        // Destroyed after the module.
+        std::unique_ptr<llvm::LLVMContext> context;
+        std::unique_ptr<llvm::Module> module;
+    };
+
+    // The target of the options with the code generation level that corresponds to the optimization level.
+    [[nodiscard]] Target_Description make_target_description(const Codegen_Options& options);
+
+    // Every option that affects the output, with the cpu and the features of `native` resolved to those of
+    // the host. Equal sources compiled with equal descriptions produce equal output.
+    [[nodiscard]] anton::Expected<std::string, std::string> describe_output_options(const Codegen_Options& options);
+
+    // Lowers and optimizes the declarations without emitting any code.
+    // The module is nullptr if the program has errors or the backend for the target could not be set up.
+    [[nodiscard]] Generated_Module generate_module(const std::vector<Owning_Ptr<Declaration>>& nodes, const Codegen_Options& options);
+
+    // Lowers, optimizes and emits the declarations into memory. Objects and assembly are emitted into
+    // one buffer per code generation thread, IR and bitcode always into a single buffer.
+    // source_path becomes the source file name of the module. With thin LTO it also distinguishes
+    // the internal symbols of different modules.
+    // Returns false if the program has errors or no output could be produced.
+    [[nodiscard]] bool generate(const std::vector<Owning_Ptr<Declaration>>& nodes, std::string_view source_path, const Codegen_Options& options,
+                                std::vector<Output_Buffer>& buffers);
+
+    // Unit of the global variables, which are all lowered together.
+    constexpr i64 global_variables_unit = -1;
+
+    // The declarations of a file indexed for lowering it one unit at a time. A unit is a single function
+    // definition or all global variables of the file. Functions and global variables of other units are
+    // only declared in the module of a unit, so that units may be compiled and cached independently
+    // at the cost of inlining across units. Template instances are emitted by every unit that uses them.
+    struct Unit_Declarations {
+        const std::vector<Owning_Ptr<Declaration>>& nodes;
+        // Shared by all units, so that the results of evaluations are computed once per file.
+        Constant_Evaluator evaluator;
+        // Indices of all declarations of every non-templated function and global variable by name.
+        std::unordered_map<std::string, std::vector<i64>> declarations;
+        // Indices of the templated declarations.
+        std::vector<i64> templates;
+        // Indices of the function definitions in the order of the file.
+        std::vector<i64> function_units;
+
+        Unit_Declarations(const std::vector<Owning_Ptr<Declaration>>& nodes, const Evaluation_Limits& limits, Overflow_Policy overflow);
+    };
+
+    // Lowers, optimizes and emits a single unit into an object. unit is the index of a function definition
+    // or global_variables_unit. Returns false if the unit has errors or no object could be produced.
+    [[nodiscard]] bool generate_unit(Unit_Declarations& declarations, i64 unit, std::string_view source_path, const Codegen_Options& options,
+                                     Output_Buffer& buffer);
 } // namespace tildac
 
 #endif //CRUST_CODEGEN_HPP
@@ -0,0 +1,686 @@
+#include <tildac/constant_evaluation.hpp>
+
+#include <algorithm>
+#include <limits>
+
+namespace tildac {
+    struct Builtin_Integer_Type {
+        std::string_view name;
+        i64 width;
+        bool is_signed;
+    };
+
+    static constexpr Builtin_Integer_Type builtin_integer_types[] = {
+        {"bool", 1, false}, {"i8", 8, true},   {"i16", 16, true},  {"i32", 32, true}, {"i64", 64, true},  {"u8", 8, false},
+        {"u16", 16, false}, {"u32", 32, false}, {"u64", 64, false}, {"c8", 8, false},  {"c16", 16, false}, {"c32", 32, false},
+    };
+
+    static Constant_Value make_value(u64 bits, i64 const width, bool const is_signed) {
+        if(width < 64) {
+            u64 const mask = (u64(1) << width) - 1;
+            bits &= mask;
+            if(is_signed && ((bits >> (width - 1)) & 1)) {
+                bits |= ~mask;
+            }
+        }
+        return Constant_Value{static_cast<i64>(bits), width, is_signed};
+    }
+
+    static Constant_Value make_bool(bool const value) {
+        return Constant_Value{value, 1, false};
+    }
+
+    static u64 apply_wrapping(Operator const op, u64 const a, u64 const b) {
+        return op == Operator::binary_add ? a + b : op == Operator::binary_sub ? a - b : a * b;
+    }
+
+    // Whether the exact result of adding, subtracting or multiplying the operands, which are extended
+    // to 64 bits from the width, does not fit into the type.
+    static bool overflows(Operator const op, u64 const a, u64 const b, i64 const width, bool const is_signed) {
+        u64 const result = apply_wrapping(op, a, b);
+        if(width < 64) {
+            // Types narrower than 64 bits are at most 32 bits wide, so the exact result fits into 64 bits.
+            return static_cast<u64>(make_value(result, width, is_signed).value) != result;
+        }
+
+        i64 const x = static_cast<i64>(a);
+        i64 const y = static_cast<i64>(b);
+        i64 const r = static_cast<i64>(result);
+        switch(op) {
+            case Operator::binary_add:
+                return is_signed ? ((x ^ r) & (y ^ r)) < 0 : result < a;
+            case Operator::binary_sub:
+                return is_signed ? ((x ^ y) & (x ^ r)) < 0 : a < b;
+            default:
+                if(a == 0) {
+                    return false;
+                }
+                return is_signed ? (x == -1 && y == std::numeric_limits<i64>::min()) || r / x != y : result / a != b;
+        }
+    }
+
+    Constant_Evaluator::Constant_Evaluator(const std::vector<Owning_Ptr<Declaration>>& declarations, Evaluation_Limits const limits,
+                                           Overflow_Policy const overflow)
+        : _limits(limits), _overflow(overflow) {
+        for(const auto& declaration: declarations) {
+            if(declaration->node_type == AST_Node_Type::function_declaration) {
+                auto& function = static_cast<const Function_Declaration&>(*declaration);
+                // Functions without a definition are never pure.
+                if(!function.template_parameters && function.body) {
+                    _functions.emplace(function.name->name, &function);
+                }
+            } else if(declaration->node_type == AST_Node_Type::variable_declaration) {
+                auto& variable = static_cast<const Variable_Declaration&>(*declaration);
+                if(!variable.template_parameters) {
+                    _globals.emplace(variable.identifier->name, &variable);
+                }
+            }
+        }
+    }
+
+    bool Constant_Evaluator::is_pure(const std::string& function) {
+        if(auto iter = _purity.find(function); iter != _purity.end()) {
+            // Recursive calls do not make a function impure.
+            return iter->second != Purity::impure;
+        }
+
+        auto iter = _functions.find(function);
+        if(iter == _functions.end()) {
+            return false;
+        }
+
+        _purity[function] = Purity::in_progress;
+        bool const pure = calls_only_pure_functions(*iter->second->body->statements);
+        _purity[function] = pure ? Purity::pure : Purity::impure;
+        return pure;
+    }
+
+    anton::Expected<Constant_Value, Evaluation_Error> Constant_Evaluator::evaluate(const Expression& expression) {
+        _steps = 0;
+        _memory = 0;
+        _frames.clear();
+        _globals_in_progress.clear();
+        Constant_Value value;
+        if(evaluate_expression(expression, value)) {
+            return {anton::expected_value, value};
+        } else {
+            return {anton::expected_error, Evaluation_Error{std::move(_error)}};
+        }
+    }
+
+    bool Constant_Evaluator::fail(std::string message) {
+        _error = std::move(message);
+        return false;
+    }
+
+    bool Constant_Evaluator::step() {
+        _steps += 1;
+        if(_steps > _limits.max_steps) {
+            return fail("evaluation exceeded the limit of " + std::to_string(_limits.max_steps) + " steps");
+        }
+        return true;
+    }
+
+    bool Constant_Evaluator::allocate(i64 const bytes) {
+        _memory += bytes;
+        if(_memory > _limits.max_memory) {
+            return fail("evaluation exceeded the limit of " + std::to_string(_limits.max_memory) + " bytes of memory");
+        }
+        return true;
+    }
+
+    bool Constant_Evaluator::calls_only_pure_functions(const AST_Node& node) {
+        switch(node.node_type) {
+            case AST_Node_Type::function_call_expression: {
+                auto& call = static_cast<const Function_Call_Expression&>(node);
+                if(call.template_arguments || !is_pure(call.identifier->name)) {
+                    return false;
+                }
+
+                return std::all_of(call.arg_list->arguments.begin(), call.arg_list->arguments.end(),
+                                   [this](const Owning_Ptr<Expression>& argument) { return calls_only_pure_functions(*argument); });
+            }
+
+            case AST_Node_Type::binary_expression: {
+                auto& expression = static_cast<const Binary_Expression&>(node);
+                return calls_only_pure_functions(*expression.lhs) && calls_only_pure_functions(*expression.rhs);
+            }
+
+            case AST_Node_Type::index_expression: {
+                auto& expression = static_cast<const Index_Expression&>(node);
+                return calls_only_pure_functions(*expression.base) && calls_only_pure_functions(*expression.index);
+            }
+
+            case AST_Node_Type::array_literal: {
+                auto& literal = static_cast<const Array_Literal&>(node);
+                return std::all_of(literal.elements.begin(), literal.elements.end(),
+                                   [this](const Owning_Ptr<Expression>& element) { return calls_only_pure_functions(*element); });
+            }
+
+            case AST_Node_Type::assignment_expression: {
+                auto& expression = static_cast<const Assignment_Expression&>(node);
+                return (!expression.element || calls_only_pure_functions(*expression.element)) && calls_only_pure_functions(*expression.value);
+            }
+
+            case AST_Node_Type::statement_list: {
+                auto& list = static_cast<const Statement_List&>(node);
+                return std::all_of(list.statements.begin(), list.statements.end(),
+                                   [this](const Owning_Ptr<Statement>& statement) { return calls_only_pure_functions(*statement); });
+            }
+
+            case AST_Node_Type::block_statement: {
+                return calls_only_pure_functions(*static_cast<const Block_Statement&>(node).statements);
+            }
+
+            case AST_Node_Type::if_statement: {
+                auto& statement = static_cast<const If_Statement&>(node);
+                return calls_only_pure_functions(*statement.condition) && calls_only_pure_functions(*statement.block) &&
+                       (!statement.else_block || calls_only_pure_functions(*statement.else_block)) &&
+                       (!statement.else_if || calls_only_pure_functions(*statement.else_if));
+            }
+
+            case AST_Node_Type::for_statement: {
+                auto& statement = static_cast<const For_Statement&>(node);
+                return (!statement.init || calls_only_pure_functions(*statement.init)) &&
+                       (!statement.condition || calls_only_pure_functions(*statement.condition)) &&
+                       (!statement.post_expr || calls_only_pure_functions(*statement.post_expr)) && calls_only_pure_functions(*statement.statements);
+            }
+
+            case AST_Node_Type::while_statement: {
+                auto& statement = static_cast<const While_Statement&>(node);
+                return calls_only_pure_functions(*statement.condition) && calls_only_pure_functions(*statement.block);
+            }
+
+            case AST_Node_Type::do_while_statement: {
+                auto& statement = static_cast<const Do_While_Statement&>(node);
+                return calls_only_pure_functions(*statement.condition) && calls_only_pure_functions(*statement.block);
+            }
+
+            case AST_Node_Type::return_statement: {
+                auto& statement = static_cast<const Return_Statement&>(node);
+                return !statement.expression || calls_only_pure_functions(*statement.expression);
+            }
+
+            case AST_Node_Type::declaration_statement: {
+                auto& declaration = *static_cast<const Declaration_Statement&>(node).var_decl;
+                return !declaration.initializer || calls_only_pure_functions(*declaration.initializer);
+            }
+
+            case AST_Node_Type::expression_statement: {
+                return calls_only_pure_functions(*static_cast<const Expression_Statement&>(node).expr);
+            }
+
+            default:
+                return true;
+        }
+    }
+
+    // Converts the value to the type as an implicit conversion would.
+    bool Constant_Evaluator::convert(const Type& type, Constant_Value& value) {
+        if(type.node_type != AST_Node_Type::qualified_type) {
+            return fail("only builtin types may be evaluated at compile time");
+        }
+
+        const std::string& name = static_cast<const Qualified_Type&>(type).name;
+        for(const Builtin_Integer_Type& builtin: builtin_integer_types) {
+            if(builtin.name == name) {
+                value = make_value(value.value, builtin.width, builtin.is_signed);
+                return true;
+            }
+        }
+        return fail("values of type \"" + name + "\" may not be evaluated at compile time");
+    }
+
+    bool Constant_Evaluator::evaluate_global(const std::string& name, Constant_Value& out) {
+        if(auto iter = _global_values.find(name); iter != _global_values.end()) {
+            out = iter->second;
+            return true;
+        }
+
+        auto iter = _globals.find(name);
+        if(iter == _globals.end()) {
+            return fail("\"" + name + "\" is not a constant");
+        }
+
+        if(std::find(_globals_in_progress.begin(), _globals_in_progress.end(), name) != _globals_in_progress.end()) {
+            return fail("initializer of \"" + name + "\" depends on itself");
+        }
+
+        const Variable_Declaration& declaration = *iter->second;
+        _globals_in_progress.push_back(name);
+        Constant_Value value = make_value(0, 64, true);
+        if(declaration.initializer && !evaluate_expression(*declaration.initializer, value)) {
+            return false;
+        }
+        _globals_in_progress.pop_back();
+
+        if(!convert(*declaration.type, value)) {
+            return false;
+        }
+
+        _global_values.emplace(name, value);
+        out = value;
+        return true;
+    }
+
+    bool Constant_Evaluator::evaluate_expression(const Expression& expression, Constant_Value& out) {
+        if(!step()) {
+            return false;
+        }
+
+        switch(expression.node_type) {
+            case AST_Node_Type::integer_literal: {
+                // Integer literals have type i32, the same as in codegen.
+                out = make_value(std::stoull(static_cast<const Integer_Literal&>(expression).value), 32, true);
+                return true;
+            }
+
+            case AST_Node_Type::bool_literal: {
+                out = make_bool(static_cast<const Bool_Literal&>(expression).value);
+                return true;
+            }
+
+            case AST_Node_Type::identifier_expression: {
+                auto& identifier = static_cast<const Identifier_Expression&>(expression);
+                if(identifier.template_arguments) {
+                    return fail("variable templates may not be evaluated at compile time");
+                }
+
+                const std::string& name = identifier.identifier->name;
+                if(Constant_Value* local = find_local(name)) {
+                    out = *local;
+                    return true;
+                }
+                return evaluate_global(name, out);
+            }
+
+            case AST_Node_Type::binary_expression: {
+                return evaluate_binary_expression(static_cast<const Binary_Expression&>(expression), out);
+            }
+
+            case AST_Node_Type::assignment_expression: {
+                return evaluate_assignment(static_cast<const Assignment_Expression&>(expression), out);
+            }
+
+            case AST_Node_Type::function_call_expression: {
+                return evaluate_call(static_cast<const Function_Call_Expression&>(expression), out);
+            }
+
+            default:
+                return fail("expression may not be evaluated at compile time");
+        }
+    }
+
+    bool Constant_Evaluator::evaluate_binary_expression(const Binary_Expression& expression, Constant_Value& out) {
+        if(expression.op == Operator::binary_or || expression.op == Operator::binary_and) {
+            bool lhs;
+            if(!evaluate_condition(*expression.lhs, lhs)) {
+                return false;
+            }
+
+            // Short-circuit the same way the generated code would.
+            if(lhs == (expression.op == Operator::binary_or)) {
+                out = make_bool(lhs);
+                return true;
+            }
+
+            bool rhs;
+            if(!evaluate_condition(*expression.rhs, rhs)) {
+                return false;
+            }
+            out = make_bool(rhs);
+            return true;
+        }
+
+        Constant_Value lhs;
+        Constant_Value rhs;
+        if(!evaluate_expression(*expression.lhs, lhs) || !evaluate_expression(*expression.rhs, rhs)) {
+            return false;
+        }
+        return apply_arithmetic(expression.op, lhs, rhs, out);
+    }
+
+    bool Constant_Evaluator::evaluate_assignment(const Assignment_Expression& expression, Constant_Value& out) {
+        if(expression.element) {
+            return fail("arrays may not be evaluated at compile time");
+        }
+
+        Constant_Value value;
+        if(!evaluate_expression(*expression.value, value)) {
+            return false;
+        }
+
+        // Codegen rejects assignments to globals and immutable variables, so we only have to find the local.
+        Constant_Value* variable = find_local(expression.identifier->name);
+        if(!variable) {
+            return fail("only local variables may be assigned at compile time");
+        }
+
+        if(expression.op != Operator::assign && !apply_arithmetic(expression.op, *variable, value, value)) {
+            return false;
+        }
+
+        *variable = make_value(value.value, variable->width, variable->is_signed);
+        out = *variable;
+        return true;
+    }
+
+    bool Constant_Evaluator::apply_arithmetic(Operator const op, Constant_Value const lhs, Constant_Value const rhs, Constant_Value& out) {
+        // Both operands are brought to the wider of the two types. Unsigned wins on equal widths.
+        i64 const width = max(lhs.width, rhs.width);
+        bool const is_signed = lhs.width == rhs.width ? lhs.is_signed && rhs.is_signed : (lhs.width > rhs.width ? lhs.is_signed : rhs.is_signed);
+        u64 const a = static_cast<u64>(make_value(lhs.value, width, is_signed).value);
+        u64 const b = static_cast<u64>(make_value(rhs.value, width, is_signed).value);
+        switch(op) {
+            case Operator::binary_eq: {
+                out = make_bool(a == b);
+                return true;
+            }
+
+            case Operator::binary_neq: {
+                out = make_bool(a != b);
+                return true;
+            }
+
+            case Operator::binary_lt: {
+                out = make_bool(is_signed ? static_cast<i64>(a) < static_cast<i64>(b) : a < b);
+                return true;
+            }
+
+            case Operator::binary_gt: {
+                out = make_bool(is_signed ? static_cast<i64>(a) > static_cast<i64>(b) : a > b);
+                return true;
+            }
+
+            case Operator::binary_leq: {
+                out = make_bool(is_signed ? static_cast<i64>(a) <= static_cast<i64>(b) : a <= b);
+                return true;
+            }
+
+            case Operator::binary_geq: {
+                out = make_bool(is_signed ? static_cast<i64>(a) >= static_cast<i64>(b) : a >= b);
+                return true;
+            }
+
+            case Operator::binary_add:
+            case Operator::binary_sub:
+            case Operator::binary_mul: {
+                if(_overflow == Overflow_Policy::trap && overflows(op, a, b, width, is_signed)) {
+                    return fail("integer overflow");
+                }
+                out = make_value(apply_wrapping(op, a, b), width, is_signed);
+                return true;
+            }
+
+            case Operator::binary_div: {
+                if(b == 0) {
+                    return fail("division by zero");
+                }
+
+                if(is_signed) {
+                    i64 const min_value = make_value(u64(1) << (width - 1), width, true).value;
+                    if(static_cast<i64>(a) == min_value && static_cast<i64>(b) == -1) {
+                        return fail("signed division overflow");
+                    }
+                    out = make_value(static_cast<u64>(static_cast<i64>(a) / static_cast<i64>(b)), width, true);
+                } else {
+                    out = make_value(a / b, width, false);
+                }
+                return true;
+            }
+
+            default:
+                return fail("operator may not be evaluated at compile time");
+        }
+    }
+
+    Constant_Value* Constant_Evaluator::find_local(const std::string& name) {
+        if(_frames.empty()) {
+            return nullptr;
+        }
+
+        std::vector<Scope>& scopes = _frames.back().scopes;
+        for(auto scope = scopes.rbegin(), end = scopes.rend(); scope != end; ++scope) {
+            if(auto iter = scope->find(name); iter != scope->end()) {
+                return &iter->second;
+            }
+        }
+        return nullptr;
+    }
+
+    bool Constant_Evaluator::evaluate_call(const Function_Call_Expression& expression, Constant_Value& out) {
+        const std::string& name = expression.identifier->name;
+        if(expression.template_arguments) {
+            return fail("function templates may not be evaluated at compile time");
+        }
+
+        if(!is_pure(name)) {
+            return fail("\"" + name + "\" is not a pure function");
+        }
+
+        const Function_Declaration& function = *_functions.at(name);
+        const auto& parameters = function.parameter_list->params;
+        const auto& arguments = expression.arg_list->arguments;
+        if(parameters.size() != arguments.size()) {
+            return fail("wrong number of arguments in call to \"" + name + "\"");
+        }
+
+        // Arguments are evaluated in the caller's frame.
+        Scope parameter_scope;
+        for(u64 i = 0; i < arguments.size(); ++i) {
+            Constant_Value argument;
+            if(!evaluate_expression(*arguments[i], argument) || !convert(*parameters[i]->type, argument)) {
+                return false;
+            }
+            parameter_scope[parameters[i]->identifier->name] = argument;
+        }
+
+        if(static_cast<i64>(_frames.size()) >= _limits.max_call_depth) {
+            return fail("evaluation exceeded the limit of " + std::to_string(_limits.max_call_depth) + " nested calls");
+        }
+
+        i64 const memory = _memory;
+        if(!allocate(sizeof(Frame) + sizeof(Constant_Value) * static_cast<i64>(arguments.size()))) {
+            return false;
+        }
+
+        _frames.emplace_back();
+        _frames.back().scopes.push_back(std::move(parameter_scope));
+        Completion completion = Completion::normal;
+        bool const success = execute_statement_list(*function.body->statements, completion);
+        Constant_Value const return_value = _frames.back().return_value;
+        _frames.pop_back();
+        _memory = memory;
+        if(!success) {
+            return false;
+        }
+
+        if(completion != Completion::returned) {
+            return fail("\"" + name + "\" does not return a value");
+        }
+
+        out = return_value;
+        return convert(*function.return_type, out);
+    }
+
+    bool Constant_Evaluator::evaluate_condition(const Expression& expression, bool& out) {
+        Constant_Value value;
+        if(!evaluate_expression(expression, value)) {
+            return false;
+        }
+        out = value.value != 0;
+        return true;
+    }
+
+    bool Constant_Evaluator::execute_statement_list(const Statement_List& statements, Completion& completion) {
+        for(const auto& statement: statements.statements) {
+            if(!execute_statement(*statement, completion)) {
+                return false;
+            }
+
+            if(completion == Completion::returned) {
+                return true;
+            }
+        }
+        return true;
+    }
+
+    bool Constant_Evaluator::execute_statement(const Statement& statement, Completion& completion) {
+        if(!step()) {
+            return false;
+        }
+
+        switch(statement.node_type) {
+            case AST_Node_Type::block_statement: {
+                i64 const memory = push_scope();
+                bool const success = execute_statement_list(*static_cast<const Block_Statement&>(statement).statements, completion);
+                pop_scope(memory);
+                return success;
+            }
+
+            case AST_Node_Type::if_statement: {
+                return execute_if_statement(static_cast<const If_Statement&>(statement), completion);
+            }
+
+            case AST_Node_Type::for_statement: {
+                auto& node = static_cast<const For_Statement&>(statement);
+                // Variables declared by the init statement live in a scope enclosing the loop.
+                i64 const init_memory = push_scope();
+                bool const success = execute_for_statement(node, completion);
+                pop_scope(init_memory);
+                return success;
+            }
+
+            case AST_Node_Type::while_statement: {
+                auto& node = static_cast<const While_Statement&>(statement);
+                while(true) {
+                    bool condition;
+                    if(!evaluate_condition(*node.condition, condition)) {
+                        return false;
+                    }
+
+                    if(!condition) {
+                        return true;
+                    }
+
+                    if(!execute_statement(*node.block, completion) || completion == Completion::returned) {
+                        return completion == Completion::returned;
+                    }
+                }
+            }
+
+            case AST_Node_Type::do_while_statement: {
+                auto& node = static_cast<const Do_While_Statement&>(statement);
+                while(true) {
+                    if(!execute_statement(*node.block, completion) || completion == Completion::returned) {
+                        return completion == Completion::returned;
+                    }
+
+                    bool condition;
+                    if(!evaluate_condition(*node.condition, condition)) {
+                        return false;
+                    }
+
+                    if(!condition) {
+                        return true;
+                    }
+                }
+            }
+
+            case AST_Node_Type::return_statement: {
+                auto& node = static_cast<const Return_Statement&>(statement);
+                if(!node.expression) {
+                    return fail("function does not return a value");
+                }
+
+                // Nested calls push frames, so the slot of this frame may only be looked up afterwards.
+                Constant_Value return_value;
+                if(!evaluate_expression(*node.expression, return_value)) {
+                    return false;
+                }
+                _frames.back().return_value = return_value;
+                completion = Completion::returned;
+                return true;
+            }
+
+            case AST_Node_Type::declaration_statement: {
+                auto& declaration = *static_cast<const Declaration_Statement&>(statement).var_decl;
+                Constant_Value value = make_value(0, 64, true);
+                if(declaration.initializer && !evaluate_expression(*declaration.initializer, value)) {
+                    return false;
+                }
+
+                if(!convert(*declaration.type, value) || !allocate(sizeof(Constant_Value))) {
+                    return false;
+                }
+                _frames.back().scopes.back()[declaration.identifier->name] = value;
+                return true;
+            }
+
+            case AST_Node_Type::expression_statement: {
+                Constant_Value value;
+                return evaluate_expression(*static_cast<const Expression_Statement&>(statement).expr, value);
+            }
+
+            default:
+                return fail("statement may not be evaluated at compile time");
+        }
+    }
+
+    bool Constant_Evaluator::execute_if_statement(const If_Statement& statement, Completion& completion) {
+        bool condition;
+        if(!evaluate_condition(*statement.condition, condition)) {
+            return false;
+        }
+
+        if(condition) {
+            return execute_statement(*statement.block, completion);
+        } else if(statement.else_if) {
+            return execute_if_statement(*statement.else_if, completion);
+        } else if(statement.else_block) {
+            return execute_statement(*statement.else_block, completion);
+        } else {
+            return true;
+        }
+    }
+
+    bool Constant_Evaluator::execute_for_statement(const For_Statement& statement, Completion& completion) {
+        if(statement.init && !execute_statement(*statement.init, completion)) {
+            return false;
+        }
+
+        while(true) {
+            bool condition = true;
+            if(statement.condition && !evaluate_condition(*statement.condition, condition)) {
+                return false;
+            }
+
+            if(!condition) {
+                return true;
+            }
+
+            i64 const memory = push_scope();
+            bool const success = execute_statement_list(*statement.statements, completion);
+            pop_scope(memory);
+            if(!success || completion == Completion::returned) {
+                return success;
+            }
+
+            Constant_Value post;
+            if(statement.post_expr && !evaluate_expression(*statement.post_expr, post)) {
+                return false;
+            }
+        }
+    }
+
+    // Returns the amount of memory in use before the scope was entered.
+    i64 Constant_Evaluator::push_scope() {
+        _frames.back().scopes.emplace_back();
+        return _memory;
+    }
+
+    void Constant_Evaluator::pop_scope(i64 const memory) {
+        _frames.back().scopes.pop_back();
+        _memory = memory;
+    }
+} // namespace tildac
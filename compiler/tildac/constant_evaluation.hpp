@@ -0,0 +1,102 @@
+#pragma once
+
+#include <anton/expected.hpp>
+#include <tildac/ast.hpp>
+#include <tildac/types.hpp>
+#include <tildac/utility.hpp>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace tildac {
+    struct Constant_Value {
+        // The bits of the value sign- or zero-extended to 64 bits.
+        i64 value;
+        // Width of the type in bits. bool is 1 bit wide.
+        i64 width;
+        bool is_signed;
+    };
+
+    struct Evaluation_Error {
+        std::string message;
+    };
+
+    struct Evaluation_Limits {
+        // Maximum number of statements and expressions visited by a single evaluation.
+        i64 max_steps = 1000000;
+        // Maximum number of bytes of call frames and local variables alive at the same time.
+        i64 max_memory = 1 << 20;
+        // Maximum number of nested calls. The evaluator recurses on the native stack, which would
+        // overflow long before deep recursion exhausted the memory limit.
+        i64 max_call_depth = 256;
+    };
+
+    // What integer addition, subtraction and multiplication do when the result does not fit into the type.
+    enum struct Overflow_Policy {
+        // The result wraps around.
+        wrap,
+        // The program traps. Evaluations at compile time fail instead.
+        trap,
+        // Overflow never happens, which lets the optimizer e.g. widen induction variables.
+        // Evaluations at compile time and the bytecode interpreter wrap around.
+        undefined,
+    };
+
+    // Evaluates calls to side-effect-free functions and initializers of global variables
+    // during compilation by walking the AST.
+    class Constant_Evaluator {
+    public:
+        Constant_Evaluator(const std::vector<Owning_Ptr<Declaration>>& declarations, Evaluation_Limits limits, Overflow_Policy overflow);
+
+        // A function is pure if it is a non-templated function defined in this translation unit
+        // that calls only pure functions. The language has no other means of causing side effects.
+        [[nodiscard]] bool is_pure(const std::string& function);
+
+        // Evaluates an expression that does not refer to any local variables.
+        [[nodiscard]] anton::Expected<Constant_Value, Evaluation_Error> evaluate(const Expression& expression);
+
+    private:
+        enum struct Purity { in_progress, pure, impure };
+        enum struct Completion { normal, returned };
+
+        using Scope = std::unordered_map<std::string, Constant_Value>;
+
+        struct Frame {
+            std::vector<Scope> scopes;
+            Constant_Value return_value;
+        };
+
+        std::unordered_map<std::string, const Function_Declaration*> _functions;
+        std::unordered_map<std::string, const Variable_Declaration*> _globals;
+        std::unordered_map<std::string, Purity> _purity;
+        std::unordered_map<std::string, Constant_Value> _global_values;
+        std::vector<std::string> _globals_in_progress;
+        std::vector<Frame> _frames;
+        Evaluation_Limits _limits;
+        Overflow_Policy _overflow;
+        i64 _steps = 0;
+        i64 _memory = 0;
+        std::string _error;
+
+        bool fail(std::string message);
+        bool step();
+        bool allocate(i64 bytes);
+        bool calls_only_pure_functions(const AST_Node& node);
+        bool convert(const Type& type, Constant_Value& value);
+        bool evaluate_global(const std::string& name, Constant_Value& out);
+        bool evaluate_expression(const Expression& expression, Constant_Value& out);
+        bool evaluate_binary_expression(const Binary_Expression& expression, Constant_Value& out);
+        bool evaluate_assignment(const Assignment_Expression& expression, Constant_Value& out);
+        bool apply_arithmetic(Operator op, Constant_Value lhs, Constant_Value rhs, Constant_Value& out);
+        Constant_Value* find_local(const std::string& name);
+        bool evaluate_call(const Function_Call_Expression& expression, Constant_Value& out);
+        bool evaluate_condition(const Expression& expression, bool& out);
+        bool execute_statement_list(const Statement_List& statements, Completion& completion);
+        bool execute_statement(const Statement& statement, Completion& completion);
+        bool execute_if_statement(const If_Statement& statement, Completion& completion);
+        bool execute_for_statement(const For_Statement& statement, Completion& completion);
+        i64 push_scope();
+        void pop_scope(i64 memory);
+    };
+} // namespace tildac
@@ -0,0 +1,485 @@
+#include <tildac/incremental.hpp>
+
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Object/ArchiveWriter.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/SHA1.h>
+#include <llvm/Target/TargetMachine.h>
+
+#include <algorithm>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace tildac {
+    struct Fingerprint_Context {
+        const Unit_Declarations& declarations;
+        bool evaluate_constant_calls;
+        // With debug info the object records the location of every node.
+        bool write_locations;
+        std::unordered_map<std::string, i64> function_templates;
+        std::unordered_map<std::string, i64> variable_templates;
+        // Everything the unit depends on besides its own declarations. Ordered, so that the fingerprint
+        // does not depend on the order in which the dependencies are discovered.
+        std::set<std::string> dependencies;
+        // Declarations whose contents have been added, keyed by twice their index plus whether they were
+        // added for the evaluator.
+        std::unordered_set<i64> added_declarations;
+
+        Fingerprint_Context(const Unit_Declarations& declarations, bool const evaluate_constant_calls, bool const write_locations)
+            : declarations(declarations), evaluate_constant_calls(evaluate_constant_calls), write_locations(write_locations) {
+            for(i64 const index: declarations.templates) {
+                const Declaration& node = *declarations.nodes[index];
+                if(node.node_type == AST_Node_Type::function_declaration) {
+                    function_templates.emplace(static_cast<const Function_Declaration&>(node).name->name, index);
+                } else {
+                    variable_templates.emplace(static_cast<const Variable_Declaration&>(node).identifier->name, index);
+                }
+            }
+        }
+    };
+
+    // Names are prefixed by their size, so that no two different sequences of names write the same text.
+    static void write_name(std::string& out, const std::string& name) {
+        out += std::to_string(name.size());
+        out += ':';
+        out += name;
+        out += ' ';
+    }
+
+    static void write_number(std::string& out, i64 const number) {
+        out += std::to_string(number);
+        out += ' ';
+    }
+
+    static void write_node(Fingerprint_Context& context, std::string& out, const AST_Node* node, i64 visible, bool evaluated);
+
+    // Writes the parameter and return types that the function is declared with. Types have no dependencies.
+    static void write_signature(Fingerprint_Context& context, std::string& out, const Function_Declaration& declaration) {
+        write_number(out, declaration.parameter_list->get_parameter_count());
+        for(const auto& parameter: declaration.parameter_list->params) {
+            write_node(context, out, parameter->type.get(), 0, false);
+        }
+        write_node(context, out, declaration.return_type.get(), 0, false);
+    }
+
+    // Adds a declaration of the file with everything that it depends on. Dependencies of the declarations
+    // of other units are visible regardless of their position, as they are for template instances and
+    // for the evaluator.
+    static void add_declaration(Fingerprint_Context& context, i64 const index, bool const evaluated) {
+        if(!context.added_declarations.insert(index * 2 + evaluated).second) {
+            return;
+        }
+
+        std::string contents = evaluated ? "evaluated " : "declaration ";
+        write_node(context, contents, context.declarations.nodes[index].get(), static_cast<i64>(context.declarations.nodes.size()), evaluated);
+        context.dependencies.insert(std::move(contents));
+    }
+
+    // Returns the index of the first declaration of the non-templated function or global variable, or -1.
+    static i64 find_first_declaration(Fingerprint_Context& context, const std::string& name, AST_Node_Type const type) {
+        auto iter = context.declarations.declarations.find(name);
+        if(iter == context.declarations.declarations.end() || context.declarations.nodes[iter->second.front()]->node_type != type) {
+            return -1;
+        }
+        return iter->second.front();
+    }
+
+    // The evaluator only fails on arguments that refer to local variables.
+    static bool is_evaluable(Fingerprint_Context& context, const Expression& expression) {
+        switch(expression.node_type) {
+            case AST_Node_Type::integer_literal:
+            case AST_Node_Type::bool_literal: {
+                return true;
+            }
+
+            case AST_Node_Type::binary_expression: {
+                auto& binary_expression = static_cast<const Binary_Expression&>(expression);
+                return is_evaluable(context, *binary_expression.lhs) && is_evaluable(context, *binary_expression.rhs);
+            }
+
+            case AST_Node_Type::identifier_expression: {
+                auto& identifier_expression = static_cast<const Identifier_Expression&>(expression);
+                return !identifier_expression.template_arguments &&
+                       find_first_declaration(context, identifier_expression.identifier->name, AST_Node_Type::variable_declaration) != -1;
+            }
+
+            case AST_Node_Type::function_call_expression: {
+                auto& call = static_cast<const Function_Call_Expression&>(expression);
+                return !call.template_arguments && std::all_of(call.arg_list->arguments.begin(), call.arg_list->arguments.end(),
+                                                               [&context](const Owning_Ptr<Expression>& argument) { return is_evaluable(context, *argument); });
+            }
+
+            default:
+                return false;
+        }
+    }
+
+    static void add_function_dependency(Fingerprint_Context& context, const Function_Call_Expression& call, i64 const visible, bool const evaluated) {
+        const std::string& name = call.identifier->name;
+        if(call.template_arguments) {
+            auto iter = context.function_templates.find(name);
+            if(iter != context.function_templates.end()) {
+                add_declaration(context, iter->second, false);
+            } else {
+                context.dependencies.insert("no function template " + name);
+            }
+            return;
+        }
+
+        if(context.function_templates.count(name)) {
+            context.dependencies.insert("function template " + name);
+            return;
+        }
+
+        i64 const first_declaration = find_first_declaration(context, name, AST_Node_Type::function_declaration);
+        if(first_declaration == -1 || first_declaration >= visible) {
+            context.dependencies.insert("undefined function " + name);
+            return;
+        }
+
+        std::string signature = "function ";
+        write_name(signature, name);
+        write_signature(context, signature, static_cast<const Function_Declaration&>(*context.declarations.nodes[first_declaration]));
+        context.dependencies.insert(std::move(signature));
+
+        // The result of a call that the evaluator computes depends on the definition of the function,
+        // which is the first one in the file.
+        if(evaluated || (context.evaluate_constant_calls && is_evaluable(context, call))) {
+            for(i64 const index: context.declarations.declarations.at(name)) {
+                const Declaration& node = *context.declarations.nodes[index];
+                if(node.node_type == AST_Node_Type::function_declaration && static_cast<const Function_Declaration&>(node).body) {
+                    add_declaration(context, index, true);
+                    break;
+                }
+            }
+        }
+    }
+
+    static void add_variable_dependency(Fingerprint_Context& context, const std::string& name, bool const is_template, i64 const visible,
+                                        bool const evaluated) {
+        if(is_template) {
+            auto iter = context.variable_templates.find(name);
+            if(iter != context.variable_templates.end()) {
+                // Instances are initialized by the evaluator.
+                add_declaration(context, iter->second, true);
+            } else {
+                context.dependencies.insert("no variable template " + name);
+            }
+            return;
+        }
+
+        // Names of local variables are not distinguished from those of global variables, which at most
+        // adds a dependency on a global variable that the unit does not use.
+        i64 const first_declaration = find_first_declaration(context, name, AST_Node_Type::variable_declaration);
+        if(first_declaration == -1) {
+            return;
+        }
+
+        if(evaluated) {
+            add_declaration(context, first_declaration, true);
+        } else if(first_declaration < visible) {
+            std::string type = "global ";
+            write_name(type, name);
+            write_node(context, type, static_cast<const Variable_Declaration&>(*context.declarations.nodes[first_declaration]).type.get(), visible, false);
+            context.dependencies.insert(std::move(type));
+        } else {
+            context.dependencies.insert("undefined global " + name);
+        }
+    }
+
+    // Writes the node and its children. visible is the number of declarations that the code may refer to,
+    // evaluated whether the code may be run by the evaluator.
+    static void write_node(Fingerprint_Context& context, std::string& out, const AST_Node* node, i64 const visible, bool const evaluated) {
+        if(!node) {
+            out += "- ";
+            return;
+        }
+
+        write_number(out, static_cast<i64>(node->node_type));
+        if(context.write_locations) {
+            write_number(out, node->source_info.line);
+            write_number(out, node->source_info.column);
+        }
+        switch(node->node_type) {
+            case AST_Node_Type::identifier: {
+                write_name(out, static_cast<const Identifier&>(*node).name);
+            } break;
+
+            case AST_Node_Type::attribute: {
+                auto& attribute = static_cast<const Attribute&>(*node);
+                write_name(out, attribute.name);
+                write_number(out, static_cast<i64>(attribute.arguments.size()));
+                for(const Attribute_Argument& argument: attribute.arguments) {
+                    write_name(out, argument.key);
+                    write_name(out, argument.value);
+                }
+            } break;
+
+            case AST_Node_Type::attribute_list: {
+                auto& list = static_cast<const Attribute_List&>(*node);
+                write_number(out, static_cast<i64>(list.attributes.size()));
+                for(const auto& attribute: list.attributes) {
+                    write_node(context, out, attribute.get(), visible, evaluated);
+                }
+            } break;
+
+            case AST_Node_Type::qualified_type: {
+                write_name(out, static_cast<const Qualified_Type&>(*node).name);
+            } break;
+
+            case AST_Node_Type::template_id: {
+                auto& type = static_cast<const Template_ID&>(*node);
+                write_node(context, out, type.qualified_type.get(), visible, evaluated);
+                write_number(out, static_cast<i64>(type.nested_types.size()));
+                for(const auto& nested_type: type.nested_types) {
+                    write_node(context, out, nested_type.get(), visible, evaluated);
+                }
+            } break;
+
+            case AST_Node_Type::array_type: {
+                auto& type = static_cast<const Array_Type&>(*node);
+                write_node(context, out, type.element_type.get(), visible, evaluated);
+                write_number(out, type.size);
+            } break;
+
+            case AST_Node_Type::template_parameter_list: {
+                auto& list = static_cast<const Template_Parameter_List&>(*node);
+                write_number(out, list.size());
+                for(const auto& parameter: list.parameters) {
+                    write_node(context, out, parameter.get(), visible, evaluated);
+                }
+            } break;
+
+            case AST_Node_Type::template_argument_list: {
+                auto& list = static_cast<const Template_Argument_List&>(*node);
+                write_number(out, list.size());
+                for(const auto& argument: list.arguments) {
+                    write_node(context, out, argument.get(), visible, evaluated);
+                }
+            } break;
+
+            case AST_Node_Type::identifier_expression: {
+                auto& expression = static_cast<const Identifier_Expression&>(*node);
+                write_node(context, out, expression.identifier.get(), visible, evaluated);
+                write_node(context, out, expression.template_arguments.get(), visible, evaluated);
+                add_variable_dependency(context, expression.identifier->name, expression.template_arguments.get() != nullptr, visible, evaluated);
+            } break;
+
+            case AST_Node_Type::binary_expression: {
+                auto& expression = static_cast<const Binary_Expression&>(*node);
+                write_number(out, static_cast<i64>(expression.op));
+                write_node(context, out, expression.lhs.get(), visible, evaluated);
+                write_node(context, out, expression.rhs.get(), visible, evaluated);
+            } break;
+
+            case AST_Node_Type::index_expression: {
+                auto& expression = static_cast<const Index_Expression&>(*node);
+                write_node(context, out, expression.base.get(), visible, evaluated);
+                write_node(context, out, expression.index.get(), visible, evaluated);
+            } break;
+
+            case AST_Node_Type::assignment_expression: {
+                auto& expression = static_cast<const Assignment_Expression&>(*node);
+                write_number(out, static_cast<i64>(expression.op));
+                write_node(context, out, expression.identifier.get(), visible, evaluated);
+                write_node(context, out, expression.element.get(), visible, evaluated);
+                write_node(context, out, expression.value.get(), visible, evaluated);
+                // Assignments to global variables are reported as such.
+                add_variable_dependency(context, expression.identifier->name, false, visible, evaluated);
+            } break;
+
+            case AST_Node_Type::argument_list: {
+                auto& list = static_cast<const Argument_List&>(*node);
+                write_number(out, static_cast<i64>(list.arguments.size()));
+                for(const auto& argument: list.arguments) {
+                    write_node(context, out, argument.get(), visible, evaluated);
+                }
+            } break;
+
+            case AST_Node_Type::function_call_expression: {
+                auto& expression = static_cast<const Function_Call_Expression&>(*node);
+                write_node(context, out, expression.identifier.get(), visible, evaluated);
+                write_node(context, out, expression.template_arguments.get(), visible, evaluated);
+                write_node(context, out, expression.arg_list.get(), visible, evaluated);
+                add_function_dependency(context, expression, visible, evaluated);
+            } break;
+
+            case AST_Node_Type::bool_literal: {
+                write_number(out, static_cast<const Bool_Literal&>(*node).value);
+            } break;
+
+            case AST_Node_Type::integer_literal: {
+                write_name(out, static_cast<const Integer_Literal&>(*node).value);
+            } break;
+
+            case AST_Node_Type::float_literal: {
+                write_name(out, static_cast<const Float_Literal&>(*node).value);
+            } break;
+
+            case AST_Node_Type::array_literal: {
+                auto& literal = static_cast<const Array_Literal&>(*node);
+                write_number(out, static_cast<i64>(literal.elements.size()));
+                for(const auto& element: literal.elements) {
+                    write_node(context, out, element.get(), visible, evaluated);
+                }
+            } break;
+
+            case AST_Node_Type::variable_declaration: {
+                auto& declaration = static_cast<const Variable_Declaration&>(*node);
+                write_node(context, out, declaration.template_parameters.get(), visible, evaluated);
+                write_node(context, out, declaration.type.get(), visible, evaluated);
+                write_node(context, out, declaration.identifier.get(), visible, evaluated);
+                write_number(out, declaration.is_mutable);
+                // Initializers of global variables are run by the evaluator unless they are literals.
+                bool const is_global = declaration.template_parameters || find_first_declaration(context, declaration.identifier->name,
+                                                                                                  AST_Node_Type::variable_declaration) != -1;
+                write_node(context, out, declaration.initializer.get(), visible, evaluated || is_global);
+            } break;
+
+            case AST_Node_Type::statement_list: {
+                auto& list = static_cast<const Statement_List&>(*node);
+                write_number(out, list.size());
+                for(const auto& statement: list.statements) {
+                    write_node(context, out, statement.get(), visible, evaluated);
+                }
+            } break;
+
+            case AST_Node_Type::block_statement: {
+                write_node(context, out, static_cast<const Block_Statement&>(*node).statements.get(), visible, evaluated);
+            } break;
+
+            case AST_Node_Type::if_statement: {
+                auto& statement = static_cast<const If_Statement&>(*node);
+                write_node(context, out, statement.condition.get(), visible, evaluated);
+                write_node(context, out, statement.block.get(), visible, evaluated);
+                write_node(context, out, statement.else_block.get(), visible, evaluated);
+                write_node(context, out, statement.else_if.get(), visible, evaluated);
+            } break;
+
+            case AST_Node_Type::for_statement: {
+                auto& statement = static_cast<const For_Statement&>(*node);
+                write_node(context, out, statement.init.get(), visible, evaluated);
+                write_node(context, out, statement.condition.get(), visible, evaluated);
+                write_node(context, out, statement.post_expr.get(), visible, evaluated);
+                write_node(context, out, statement.statements.get(), visible, evaluated);
+                write_node(context, out, statement.attributes.get(), visible, evaluated);
+            } break;
+
+            case AST_Node_Type::while_statement: {
+                auto& statement = static_cast<const While_Statement&>(*node);
+                write_node(context, out, statement.condition.get(), visible, evaluated);
+                write_node(context, out, statement.block.get(), visible, evaluated);
+                write_node(context, out, statement.attributes.get(), visible, evaluated);
+            } break;
+
+            case AST_Node_Type::do_while_statement: {
+                auto& statement = static_cast<const Do_While_Statement&>(*node);
+                write_node(context, out, statement.condition.get(), visible, evaluated);
+                write_node(context, out, statement.block.get(), visible, evaluated);
+                write_node(context, out, statement.attributes.get(), visible, evaluated);
+            } break;
+
+            case AST_Node_Type::return_statement: {
+                write_node(context, out, static_cast<const Return_Statement&>(*node).expression.get(), visible, evaluated);
+            } break;
+
+            case AST_Node_Type::declaration_statement: {
+                write_node(context, out, static_cast<const Declaration_Statement&>(*node).var_decl.get(), visible, evaluated);
+            } break;
+
+            case AST_Node_Type::expression_statement: {
+                write_node(context, out, static_cast<const Expression_Statement&>(*node).expr.get(), visible, evaluated);
+            } break;
+
+            case AST_Node_Type::function_parameter_list: {
+                // Parameters carry the node type of declaration statements, so they are written here.
+                auto& list = static_cast<const Function_Parameter_List&>(*node);
+                write_number(out, list.get_parameter_count());
+                for(const auto& parameter: list.params) {
+                    write_node(context, out, parameter->identifier.get(), visible, evaluated);
+                    write_node(context, out, parameter->type.get(), visible, evaluated);
+                }
+            } break;
+
+            case AST_Node_Type::function_body: {
+                write_node(context, out, static_cast<const Function_Body&>(*node).statements.get(), visible, evaluated);
+            } break;
+
+            case AST_Node_Type::function_declaration: {
+                auto& declaration = static_cast<const Function_Declaration&>(*node);
+                write_node(context, out, declaration.template_parameters.get(), visible, evaluated);
+                write_node(context, out, declaration.name.get(), visible, evaluated);
+                write_node(context, out, declaration.parameter_list.get(), visible, evaluated);
+                write_node(context, out, declaration.return_type.get(), visible, evaluated);
+                write_node(context, out, declaration.body.get(), visible, evaluated);
+                write_node(context, out, declaration.attributes.get(), visible, evaluated);
+            } break;
+
+            default:
+                break;
+        }
+    }
+
+    std::string fingerprint_unit(const Unit_Declarations& declarations, i64 const unit, const Codegen_Options& options) {
+        Fingerprint_Context context{declarations, options.evaluate_constant_calls, options.debug_info != Debug_Info_Level::none};
+        std::string contents;
+        if(unit == global_variables_unit) {
+            contents = "global variables ";
+            for(const auto& node: declarations.nodes) {
+                auto* declaration = static_cast<const Variable_Declaration*>(node.get());
+                if(node->node_type == AST_Node_Type::variable_declaration && !declaration->template_parameters) {
+                    write_node(context, contents, declaration, static_cast<i64>(declarations.nodes.size()), true);
+                }
+            }
+        } else {
+            contents = "function ";
+            auto& definition = static_cast<const Function_Declaration&>(*declarations.nodes[unit]);
+            write_node(context, contents, &definition, unit + 1, false);
+            // The unit checks its definition against the other declarations of the function.
+            for(i64 const index: declarations.declarations.at(definition.name->name)) {
+                const Declaration& node = *declarations.nodes[index];
+                if(index == unit || node.node_type != AST_Node_Type::function_declaration) {
+                    continue;
+                }
+
+                auto& declaration = static_cast<const Function_Declaration&>(node);
+                std::string redeclaration = index < unit && declaration.body ? "earlier definition " : "declaration ";
+                write_signature(context, redeclaration, declaration);
+                context.dependencies.insert(std::move(redeclaration));
+            }
+        }
+
+        llvm::SHA1 hash;
+        hash.update(contents);
+        for(const std::string& dependency: context.dependencies) {
+            hash.update("\n");
+            hash.update(dependency);
+        }
+        return llvm::toHex(hash.final(), true);
+    }
+
+    bool write_archive(const std::string& path, const std::vector<Archive_Member>& members, const Codegen_Options& options, std::string& error) {
+        anton::Expected<llvm::TargetMachine*, std::string> target_machine = Backend_Session::get().get_target_machine(make_target_description(options));
+        if(!target_machine) {
+            error = std::move(target_machine.error());
+            return false;
+        }
+
+        std::vector<llvm::NewArchiveMember> archive_members;
+        for(const Archive_Member& member: members) {
+            llvm::StringRef const object(member.object.data(), member.object.size());
+            archive_members.emplace_back(llvm::MemoryBufferRef(object, member.name));
+        }
+
+        // Deterministic archives have no timestamps, so that equal objects produce equal archives.
+        llvm::object::Archive::Kind const kind =
+            target_machine.value()->getTargetTriple().isOSDarwin() ? llvm::object::Archive::K_DARWIN : llvm::object::Archive::K_GNU;
+        if(llvm::Error result = llvm::writeArchive(path, archive_members, true, kind, true, false)) {
+            error = llvm::toString(std::move(result));
+            return false;
+        }
+        return true;
+    }
+} // namespace tildac
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <tildac/codegen.hpp>
+#include <tildac/types.hpp>
+
+#include <string>
+#include <vector>
+
+namespace tildac {
+    // Hashes everything that the object of a unit depends on: the declarations of the unit, the signatures
+    // of the functions and the types of the global variables that it uses and the templates that it
+    // instantiates. Functions whose calls may be evaluated at compile time contribute their definitions
+    // and everything those depend on in turn. A unit whose fingerprint did not change compiles to the same
+    // object under the same options, hence an edit recompiles only the units that it affects.
+    [[nodiscard]] std::string fingerprint_unit(const Unit_Declarations& declarations, i64 unit, const Codegen_Options& options);
+
+    struct Archive_Member {
+        std::string name;
+        Output_Buffer object;
+    };
+
+    // Writes the objects into a static archive with a symbol table in the format of the target of the options.
+    // Linkers take only the members that define referenced symbols out of the archive.
+    // Returns false and sets error if the archive could not be written.
+    [[nodiscard]] bool write_archive(const std::string& path, const std::vector<Archive_Member>& members, const Codegen_Options& options,
+                                     std::string& error);
+} // namespace tildac
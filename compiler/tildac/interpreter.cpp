@@ -0,0 +1,458 @@
+#include <tildac/interpreter.hpp>
+
+#include <limits>
+
+// Threaded dispatch jumps from the end of every instruction straight to the next one through a table
+// of label addresses. Each instruction gets a branch of its own, which the processor predicts far
+// better than the single indirect branch of a switch.
+#if defined(__GNUC__) || defined(__clang__)
+    #define TILDAC_THREADED_DISPATCH 1
+#endif
+
+namespace tildac {
+    Interpreter::Interpreter(const Bytecode_Program& program, i64 const stack_size)
+        : _program(program), _stack(new i64[static_cast<u64>(stack_size)]), _stack_size(stack_size), _globals(static_cast<u64>(program.global_count)) {}
+
+    anton::Expected<i64, std::string> Interpreter::call(i64 const function, const std::vector<i64>& arguments) {
+        if(!_globals_initialized) {
+            _globals_initialized = true;
+            anton::Expected<i64, std::string> result = execute(_program.global_initializer, _stack.get());
+            if(!result) {
+                return result;
+            }
+        }
+
+        const Bytecode_Function& callee = _program.functions[function];
+        if(static_cast<i64>(arguments.size()) != callee.parameter_count) {
+            return {anton::expected_error, "wrong number of arguments in call to \"" + callee.name + "\""};
+        }
+
+        for(u64 i = 0; i < arguments.size(); ++i) {
+            _stack[i] = arguments[i];
+        }
+        return execute(callee, _stack.get());
+    }
+
+    struct Call_Frame {
+        const Bytecode_Function* function;
+        const Instruction* return_address;
+        i64* registers;
+        // Register of the caller that receives the result, -1 for call_void.
+        i32 destination;
+    };
+
+    // Arithmetic wraps around like the generated code.
+    static i64 wrapping_add(i64 const lhs, i64 const rhs) {
+        return static_cast<i64>(static_cast<u64>(lhs) + static_cast<u64>(rhs));
+    }
+
+    static i64 wrapping_sub(i64 const lhs, i64 const rhs) {
+        return static_cast<i64>(static_cast<u64>(lhs) - static_cast<u64>(rhs));
+    }
+
+    static i64 wrapping_mul(i64 const lhs, i64 const rhs) {
+        return static_cast<i64>(static_cast<u64>(lhs) * static_cast<u64>(rhs));
+    }
+
+    // Overflow checks of the wrapped result for the trap policy.
+    static bool add_overflows(i64 const lhs, i64 const rhs, i64 const result) {
+        return ((lhs ^ result) & (rhs ^ result)) < 0;
+    }
+
+    static bool sub_overflows(i64 const lhs, i64 const rhs, i64 const result) {
+        return ((lhs ^ rhs) & (lhs ^ result)) < 0;
+    }
+
+    static bool mul_overflows(i64 const lhs, i64 const rhs, i64 const result) {
+        if(lhs == -1) {
+            return rhs == std::numeric_limits<i64>::min();
+        }
+        return lhs != 0 && result / lhs != rhs;
+    }
+
+    static bool mul_overflows_unsigned(u64 const lhs, u64 const rhs, u64 const result) {
+        return lhs != 0 && result / lhs != rhs;
+    }
+
+    anton::Expected<i64, std::string> Interpreter::execute(const Bytecode_Function& function, i64* registers) {
+        i64* const stack_end = _stack.get() + _stack_size;
+        if(registers + function.register_count > stack_end) {
+            return {anton::expected_error, "stack overflow in \"" + function.name + "\""};
+        }
+
+        std::vector<Call_Frame> frames;
+        const Bytecode_Function* current = &function;
+        // Jump targets are relative to the code of the current function.
+        const Instruction* code = function.code.data();
+        const Instruction* pc = code;
+        i64* r = registers;
+
+#ifdef TILDAC_THREADED_DISPATCH
+    // Labels as values and computed gotos are GNU extensions, which -pedantic warns about.
+    #pragma GCC diagnostic push
+    #pragma GCC diagnostic ignored "-Wpedantic"
+        static void* const dispatch_table[] = {
+    #define TILDAC_BYTECODE_OPCODE_LABEL(name, operands) &&op_##name,
+            TILDAC_BYTECODE_OPCODES(TILDAC_BYTECODE_OPCODE_LABEL)
+    #undef TILDAC_BYTECODE_OPCODE_LABEL
+        };
+
+    #define DISPATCH() goto* dispatch_table[static_cast<u8>(pc->opcode)]
+    #define OPCODE(name) op_##name:
+        DISPATCH();
+#else
+    #define DISPATCH() continue
+    #define OPCODE(name) case Opcode::name:
+        while(true) {
+            switch(pc->opcode) {
+#endif
+
+        OPCODE(load_immediate) {
+            r[pc->a] = pc->b;
+            ++pc;
+            DISPATCH();
+        }
+
+        OPCODE(load_global) {
+            r[pc->a] = _globals[pc->b];
+            ++pc;
+            DISPATCH();
+        }
+
+        OPCODE(store_global) {
+            _globals[pc->a] = r[pc->b];
+            ++pc;
+            DISPATCH();
+        }
+
+        OPCODE(move) {
+            r[pc->a] = r[pc->b];
+            ++pc;
+            DISPATCH();
+        }
+
+        OPCODE(sign_extend) {
+            r[pc->a] = static_cast<i64>(static_cast<u64>(r[pc->b]) << pc->c) >> pc->c;
+            ++pc;
+            DISPATCH();
+        }
+
+        OPCODE(zero_extend) {
+            r[pc->a] = static_cast<i64>((static_cast<u64>(r[pc->b]) << pc->c) >> pc->c);
+            ++pc;
+            DISPATCH();
+        }
+
+        OPCODE(sign_extend_checked) {
+            i64 const value = static_cast<i64>(static_cast<u64>(r[pc->b]) << pc->c) >> pc->c;
+            if(value != r[pc->b]) {
+                return {anton::expected_error, "integer overflow in \"" + current->name + "\""};
+            }
+            r[pc->a] = value;
+            ++pc;
+            DISPATCH();
+        }
+
+        OPCODE(zero_extend_checked) {
+            i64 const value = static_cast<i64>((static_cast<u64>(r[pc->b]) << pc->c) >> pc->c);
+            if(value != r[pc->b]) {
+                return {anton::expected_error, "integer overflow in \"" + current->name + "\""};
+            }
+            r[pc->a] = value;
+            ++pc;
+            DISPATCH();
+        }
+
+        OPCODE(truncate_to_bool) {
+            r[pc->a] = r[pc->b] & 1;
+            ++pc;
+            DISPATCH();
+        }
+
+        OPCODE(add) {
+            r[pc->a] = wrapping_add(r[pc->b], r[pc->c]);
+            ++pc;
+            DISPATCH();
+        }
+
+        OPCODE(sub) {
+            r[pc->a] = wrapping_sub(r[pc->b], r[pc->c]);
+            ++pc;
+            DISPATCH();
+        }
+
+        OPCODE(mul) {
+            r[pc->a] = wrapping_mul(r[pc->b], r[pc->c]);
+            ++pc;
+            DISPATCH();
+        }
+
+        OPCODE(div) {
+            i64 const lhs = r[pc->b];
+            i64 const rhs = r[pc->c];
+            if(rhs == 0) {
+                return {anton::expected_error, "division by zero in \"" + current->name + "\""};
+            }
+
+            if(lhs == std::numeric_limits<i64>::min() && rhs == -1) {
+                return {anton::expected_error, "signed division overflow in \"" + current->name + "\""};
+            }
+            r[pc->a] = lhs / rhs;
+            ++pc;
+            DISPATCH();
+        }
+
+        OPCODE(div_unsigned) {
+            u64 const rhs = static_cast<u64>(r[pc->c]);
+            if(rhs == 0) {
+                return {anton::expected_error, "division by zero in \"" + current->name + "\""};
+            }
+            r[pc->a] = static_cast<i64>(static_cast<u64>(r[pc->b]) / rhs);
+            ++pc;
+            DISPATCH();
+        }
+
+        OPCODE(add_checked) {
+            i64 const result = wrapping_add(r[pc->b], r[pc->c]);
+            if(add_overflows(r[pc->b], r[pc->c], result)) {
+                return {anton::expected_error, "integer overflow in \"" + current->name + "\""};
+            }
+            r[pc->a] = result;
+            ++pc;
+            DISPATCH();
+        }
+
+        OPCODE(sub_checked) {
+            i64 const result = wrapping_sub(r[pc->b], r[pc->c]);
+            if(sub_overflows(r[pc->b], r[pc->c], result)) {
+                return {anton::expected_error, "integer overflow in \"" + current->name + "\""};
+            }
+            r[pc->a] = result;
+            ++pc;
+            DISPATCH();
+        }
+
+        OPCODE(mul_checked) {
+            i64 const result = wrapping_mul(r[pc->b], r[pc->c]);
+            if(mul_overflows(r[pc->b], r[pc->c], result)) {
+                return {anton::expected_error, "integer overflow in \"" + current->name + "\""};
+            }
+            r[pc->a] = result;
+            ++pc;
+            DISPATCH();
+        }
+
+        OPCODE(add_unsigned_checked) {
+            i64 const result = wrapping_add(r[pc->b], r[pc->c]);
+            if(static_cast<u64>(result) < static_cast<u64>(r[pc->b])) {
+                return {anton::expected_error, "integer overflow in \"" + current->name + "\""};
+            }
+            r[pc->a] = result;
+            ++pc;
+            DISPATCH();
+        }
+
+        OPCODE(sub_unsigned_checked) {
+            if(static_cast<u64>(r[pc->b]) < static_cast<u64>(r[pc->c])) {
+                return {anton::expected_error, "integer overflow in \"" + current->name + "\""};
+            }
+            r[pc->a] = wrapping_sub(r[pc->b], r[pc->c]);
+            ++pc;
+            DISPATCH();
+        }
+
+        OPCODE(mul_unsigned_checked) {
+            i64 const result = wrapping_mul(r[pc->b], r[pc->c]);
+            if(mul_overflows_unsigned(static_cast<u64>(r[pc->b]), static_cast<u64>(r[pc->c]), static_cast<u64>(result))) {
+                return {anton::expected_error, "integer overflow in \"" + current->name + "\""};
+            }
+            r[pc->a] = result;
+            ++pc;
+            DISPATCH();
+        }
+
+        OPCODE(add_immediate) {
+            r[pc->a] = wrapping_add(r[pc->b], pc->c);
+            ++pc;
+            DISPATCH();
+        }
+
+        OPCODE(equal) {
+            r[pc->a] = r[pc->b] == r[pc->c];
+            ++pc;
+            DISPATCH();
+        }
+
+        OPCODE(not_equal) {
+            r[pc->a] = r[pc->b] != r[pc->c];
+            ++pc;
+            DISPATCH();
+        }
+
+        OPCODE(less) {
+            r[pc->a] = r[pc->b] < r[pc->c];
+            ++pc;
+            DISPATCH();
+        }
+
+        OPCODE(less_equal) {
+            r[pc->a] = r[pc->b] <= r[pc->c];
+            ++pc;
+            DISPATCH();
+        }
+
+        OPCODE(less_unsigned) {
+            r[pc->a] = static_cast<u64>(r[pc->b]) < static_cast<u64>(r[pc->c]);
+            ++pc;
+            DISPATCH();
+        }
+
+        OPCODE(less_equal_unsigned) {
+            r[pc->a] = static_cast<u64>(r[pc->b]) <= static_cast<u64>(r[pc->c]);
+            ++pc;
+            DISPATCH();
+        }
+
+        OPCODE(jump) {
+            pc = code + pc->a;
+            DISPATCH();
+        }
+
+        OPCODE(jump_if_zero) {
+            pc = r[pc->a] == 0 ? code + pc->b : pc + 1;
+            DISPATCH();
+        }
+
+        OPCODE(jump_if_not_zero) {
+            pc = r[pc->a] != 0 ? code + pc->b : pc + 1;
+            DISPATCH();
+        }
+
+        OPCODE(jump_if_less) {
+            pc = r[pc->a] < r[pc->b] ? code + pc->c : pc + 1;
+            DISPATCH();
+        }
+
+        OPCODE(jump_if_not_less) {
+            pc = !(r[pc->a] < r[pc->b]) ? code + pc->c : pc + 1;
+            DISPATCH();
+        }
+
+        OPCODE(jump_if_less_unsigned) {
+            pc = static_cast<u64>(r[pc->a]) < static_cast<u64>(r[pc->b]) ? code + pc->c : pc + 1;
+            DISPATCH();
+        }
+
+        OPCODE(jump_if_not_less_unsigned) {
+            pc = !(static_cast<u64>(r[pc->a]) < static_cast<u64>(r[pc->b])) ? code + pc->c : pc + 1;
+            DISPATCH();
+        }
+
+        OPCODE(jump_if_equal) {
+            pc = r[pc->a] == r[pc->b] ? code + pc->c : pc + 1;
+            DISPATCH();
+        }
+
+        OPCODE(jump_if_not_equal) {
+            pc = r[pc->a] != r[pc->b] ? code + pc->c : pc + 1;
+            DISPATCH();
+        }
+
+        OPCODE(call) {
+            const Bytecode_Function& callee = _program.functions[pc->b];
+            i64* const callee_registers = r + pc->c;
+            if(callee_registers + callee.register_count > stack_end) {
+                return {anton::expected_error, "stack overflow in \"" + callee.name + "\""};
+            }
+
+            frames.push_back(Call_Frame{current, pc + 1, r, pc->a});
+            current = &callee;
+            r = callee_registers;
+            code = callee.code.data();
+            pc = code;
+            DISPATCH();
+        }
+
+        OPCODE(call_void) {
+            const Bytecode_Function& callee = _program.functions[pc->a];
+            i64* const callee_registers = r + pc->b;
+            if(callee_registers + callee.register_count > stack_end) {
+                return {anton::expected_error, "stack overflow in \"" + callee.name + "\""};
+            }
+
+            frames.push_back(Call_Frame{current, pc + 1, r, -1});
+            current = &callee;
+            r = callee_registers;
+            code = callee.code.data();
+            pc = code;
+            DISPATCH();
+        }
+
+        OPCODE(ret) {
+            i64 const value = r[pc->a];
+            if(frames.empty()) {
+                return {anton::expected_value, value};
+            }
+
+            Call_Frame const frame = frames.back();
+            frames.pop_back();
+            current = frame.function;
+            code = current->code.data();
+            pc = frame.return_address;
+            r = frame.registers;
+            r[frame.destination] = value;
+            DISPATCH();
+        }
+
+        OPCODE(ret_void) {
+            if(frames.empty()) {
+                return {anton::expected_value, 0};
+            }
+
+            Call_Frame const frame = frames.back();
+            frames.pop_back();
+            current = frame.function;
+            code = current->code.data();
+            pc = frame.return_address;
+            r = frame.registers;
+            DISPATCH();
+        }
+
+        OPCODE(missing_return) {
+            return {anton::expected_error, "\"" + current->name + "\" did not return a value"};
+        }
+
+#ifdef TILDAC_THREADED_DISPATCH
+    #pragma GCC diagnostic pop
+#else
+            }
+        }
+#endif
+#undef OPCODE
+#undef DISPATCH
+    }
+
+    anton::Expected<int, std::string> run_bytecode(const Bytecode_Program& program, const std::vector<std::string>& arguments) {
+        i64 const main_function = find_bytecode_function(program, "main");
+        if(main_function < 0) {
+            return {anton::expected_error, "no definition of 'main'"};
+        }
+
+        const Bytecode_Function& main_definition = program.functions[main_function];
+        if(!main_definition.returns_value || (main_definition.parameter_count != 0 && main_definition.parameter_count != 2)) {
+            return {anton::expected_error, "'main' must be 'fn main() -> i32' or 'fn main(argc: i32, argv: c8**) -> i32'"};
+        }
+
+        std::vector<i64> main_arguments;
+        if(main_definition.parameter_count == 2) {
+            main_arguments = {static_cast<i64>(arguments.size()), 0};
+        }
+
+        Interpreter interpreter{program};
+        anton::Expected<i64, std::string> result = interpreter.call(main_function, main_arguments);
+        if(!result) {
+            return {anton::expected_error, std::move(result.error())};
+        }
+        return {anton::expected_value, static_cast<int>(result.value())};
+    }
+} // namespace tildac
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <anton/expected.hpp>
+#include <tildac/bytecode.hpp>
+#include <tildac/types.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace tildac {
+    // Executes bytecode without going through LLVM. The register stack is allocated once and shared
+    // by all frames; calls and returns do not recurse on the native stack.
+    class Interpreter {
+    public:
+        // stack_size is the number of 64 bit registers available to all frames together.
+        explicit Interpreter(const Bytecode_Program& program, i64 stack_size = 1 << 20);
+
+        // Calls the function with the arguments. Functions that do not return a value return 0.
+        // The global variables are initialized before the first call.
+        [[nodiscard]] anton::Expected<i64, std::string> call(i64 function, const std::vector<i64>& arguments);
+
+    private:
+        const Bytecode_Program& _program;
+        // Left uninitialized, so that only the pages that frames actually use are ever touched.
+        std::unique_ptr<i64[]> _stack;
+        i64 _stack_size;
+        std::vector<i64> _globals;
+        bool _globals_initialized = false;
+
+        anton::Expected<i64, std::string> execute(const Bytecode_Function& function, i64* registers);
+    };
+
+    // Runs `main` of the program. `main` may either take no parameters or `(argc: i32, argv: c8**)`,
+    // in which case argv is null since programs cannot dereference pointers yet.
+    // Returns the value returned by `main`.
+    [[nodiscard]] anton::Expected<int, std::string> run_bytecode(const Bytecode_Program& program, const std::vector<std::string>& arguments);
+} // namespace tildac
@@ -0,0 +1,373 @@
+#include <tildac/jit.hpp>
+
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/ExecutionEngine/Orc/CompileOnDemandLayer.h>
+#include <llvm/ExecutionEngine/Orc/Core.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/IndirectionUtils.h>
+#include <llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/GlobalVariable.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/MC/SubtargetFeature.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/SmallVectorMemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Transforms/Utils/BasicBlockUtils.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/Transforms/Utils/ValueMapper.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace tildac {
+    // Returns whether main takes argc and argv.
+    static anton::Expected<bool, std::string> check_main(llvm::Module& module) {
+        llvm::Function* main_function = module.getFunction("main");
+        if(!main_function || main_function->isDeclaration()) {
+            return {anton::expected_error, "no definition of 'main'"};
+        }
+
+        llvm::FunctionType* main_type = main_function->getFunctionType();
+        bool const takes_arguments = main_type->getNumParams() == 2;
+        if(!main_type->getReturnType()->isIntegerTy(32) || (main_type->getNumParams() != 0 && !takes_arguments)) {
+            return {anton::expected_error, "'main' must be 'fn main() -> i32' or 'fn main(argc: i32, argv: c8**) -> i32'"};
+        }
+        return {anton::expected_value, takes_arguments};
+    }
+
+    // The module was lowered for the cpu and the features of the target, so the JIT must compile for them too.
+    static anton::Expected<llvm::orc::JITTargetMachineBuilder, std::string> make_machine_builder(const Target_Description& target) {
+        anton::Expected<llvm::TargetMachine*, std::string> target_machine = Backend_Session::get().get_target_machine(target);
+        if(!target_machine) {
+            return {anton::expected_error, std::move(target_machine.error())};
+        }
+
+        llvm::orc::JITTargetMachineBuilder machine_builder{target_machine.value()->getTargetTriple()};
+        machine_builder.setCPU(target_machine.value()->getTargetCPU().str());
+        machine_builder.getFeatures() = llvm::SubtargetFeatures(target_machine.value()->getTargetFeatureString());
+        machine_builder.setCodeGenOptLevel(target.optimization);
+        return {anton::expected_value, std::move(machine_builder)};
+    }
+
+    // Makes the symbols of the host process, e.g. the C library, visible to the program.
+    static llvm::Error add_process_symbols(llvm::orc::LLJIT& jit) {
+        char const global_prefix = jit.getDataLayout().getGlobalPrefix();
+        auto process_symbols = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(global_prefix);
+        if(!process_symbols) {
+            return process_symbols.takeError();
+        }
+        jit.getMainJITDylib().addGenerator(std::move(*process_symbols));
+        return llvm::Error::success();
+    }
+
+    static int call_main(llvm::JITTargetAddress const address, bool const takes_arguments, const std::vector<std::string>& arguments) {
+        if(takes_arguments) {
+            // argv is null-terminated like the one the C runtime passes.
+            std::vector<char*> argv;
+            for(const std::string& argument: arguments) {
+                argv.push_back(const_cast<char*>(argument.c_str()));
+            }
+            argv.push_back(nullptr);
+            auto main_function = reinterpret_cast<int (*)(int, char**)>(address);
+            return main_function(static_cast<int>(arguments.size()), argv.data());
+        } else {
+            auto main_function = reinterpret_cast<int (*)()>(address);
+            return main_function();
+        }
+    }
+
+    anton::Expected<int, std::string> run_module(Generated_Module module, const Target_Description& target, const std::vector<std::string>& arguments) {
+        if(!module.module) {
+            return {anton::expected_error, "nothing to run"};
+        }
+
+        anton::Expected<bool, std::string> takes_arguments = check_main(*module.module);
+        if(!takes_arguments) {
+            return {anton::expected_error, std::move(takes_arguments.error())};
+        }
+
+        anton::Expected<llvm::orc::JITTargetMachineBuilder, std::string> machine_builder = make_machine_builder(target);
+        if(!machine_builder) {
+            return {anton::expected_error, std::move(machine_builder.error())};
+        }
+
+        llvm::Expected<std::unique_ptr<llvm::orc::LLLazyJIT>> jit =
+            llvm::orc::LLLazyJITBuilder().setJITTargetMachineBuilder(std::move(machine_builder.value())).create();
+        if(!jit) {
+            return {anton::expected_error, llvm::toString(jit.takeError())};
+        }
+
+        // Compile a function only when it is called instead of the whole module on the first call.
+        (*jit)->setPartitionFunction(llvm::orc::CompileOnDemandLayer::compileRequested);
+        if(llvm::Error error = add_process_symbols(**jit)) {
+            return {anton::expected_error, llvm::toString(std::move(error))};
+        }
+
+        module.module->setDataLayout((*jit)->getDataLayout());
+        if(llvm::Error error = (*jit)->addLazyIRModule(llvm::orc::ThreadSafeModule(std::move(module.module), std::move(module.context)))) {
+            return {anton::expected_error, llvm::toString(std::move(error))};
+        }
+
+        llvm::Expected<llvm::JITEvaluatedSymbol> main_symbol = (*jit)->lookup("main");
+        if(!main_symbol) {
+            return {anton::expected_error, llvm::toString(main_symbol.takeError())};
+        }
+        return {anton::expected_value, call_main(main_symbol->getAddress(), takes_arguments.value(), arguments)};
+    }
+
+    static constexpr char tier_up_function_name[] = "__tildac_tier_up";
+
+    // Prepares the -O0 module for tiering. Every function `f` is renamed to `f.tier0` and gets a call counter.
+    // All calls to `f`, including recursive ones, are redirected to a declaration of `f` that is resolved to
+    // the stub of the function. The counter calls the tier-up hook with the index of the function in
+    // `functions` when it reaches the threshold.
+    static void instrument_for_tiering(llvm::Module& module, i64 const threshold, std::vector<std::string>& functions) {
+        llvm::LLVMContext& context = module.getContext();
+        llvm::Type* counter_type = llvm::Type::getInt64Ty(context);
+        llvm::FunctionType* tier_up_type = llvm::FunctionType::get(llvm::Type::getVoidTy(context), {counter_type}, false);
+        llvm::FunctionCallee tier_up = module.getOrInsertFunction(tier_up_function_name, tier_up_type);
+
+        std::vector<llvm::Function*> definitions;
+        for(llvm::Function& function: module) {
+            if(!function.isDeclaration()) {
+                definitions.push_back(&function);
+            }
+        }
+
+        for(llvm::Function* function: definitions) {
+            std::string const name = function->getName().str();
+            i64 const index = static_cast<i64>(functions.size());
+            functions.push_back(name);
+
+            // Template instances are linkonce_odr, but there is only ever one definition in the JIT.
+            function->setName(name + ".tier0");
+            function->setLinkage(llvm::GlobalValue::ExternalLinkage);
+            function->setComdat(nullptr);
+            llvm::Function* stub = llvm::Function::Create(function->getFunctionType(), llvm::GlobalValue::ExternalLinkage, name, module);
+            function->replaceAllUsesWith(stub);
+
+            auto counter = new llvm::GlobalVariable(module, counter_type, false, llvm::GlobalValue::InternalLinkage,
+                                                    llvm::ConstantInt::get(counter_type, 0), name + ".calls");
+            // Allocas must stay in the entry block, so the counter goes after them.
+            llvm::BasicBlock::iterator insertion_point = function->getEntryBlock().getFirstInsertionPt();
+            while(llvm::isa<llvm::AllocaInst>(*insertion_point)) {
+                ++insertion_point;
+            }
+
+            llvm::IRBuilder<> builder(&function->getEntryBlock(), insertion_point);
+            // Relaxed load and store instead of a locked add keep the counter cheap. Increments lost to
+            // concurrent calls only delay the tier-up and a function may be requested more than once.
+            llvm::LoadInst* previous = builder.CreateAlignedLoad(counter_type, counter, llvm::MaybeAlign(8));
+            previous->setAtomic(llvm::AtomicOrdering::Monotonic);
+            llvm::StoreInst* store = builder.CreateAlignedStore(builder.CreateAdd(previous, builder.getInt64(1)), counter, llvm::MaybeAlign(8));
+            store->setAtomic(llvm::AtomicOrdering::Monotonic);
+            llvm::Value* reached = builder.CreateICmpEQ(previous, builder.getInt64(threshold - 1));
+            llvm::Instruction* tier_up_block_end = llvm::SplitBlockAndInsertIfThen(reached, &*builder.GetInsertPoint(), false);
+            builder.SetInsertPoint(tier_up_block_end);
+            builder.CreateCall(tier_up, {builder.getInt64(index)});
+        }
+    }
+
+    // Recompiles hot functions at -O3 on a background thread.
+    class Tiered_Compiler {
+    public:
+        Tiered_Compiler(const std::vector<Owning_Ptr<Declaration>>& nodes, const Codegen_Options& options, llvm::orc::LLJIT& jit,
+                        llvm::orc::IndirectStubsManager& stubs, std::vector<std::string> functions)
+            : _nodes(nodes), _options(options), _jit(jit), _stubs(stubs), _functions(std::move(functions)), _optimized_functions(_functions.size(), false) {
+            _options.optimization_level = Optimization_Level::O3;
+            _thread = std::thread([this]() { run(); });
+        }
+
+        Tiered_Compiler(const Tiered_Compiler&) = delete;
+        Tiered_Compiler& operator=(const Tiered_Compiler&) = delete;
+
+        ~Tiered_Compiler() {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stopping = true;
+            }
+            _condition.notify_one();
+            _thread.join();
+        }
+
+        // Called by the -O0 code of the program when a function becomes hot.
+        void request(i64 const index) {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _requests.push_back(index);
+            }
+            _condition.notify_one();
+        }
+
+    private:
+        const std::vector<Owning_Ptr<Declaration>>& _nodes;
+        Codegen_Options _options;
+        llvm::orc::LLJIT& _jit;
+        llvm::orc::IndirectStubsManager& _stubs;
+        std::vector<std::string> _functions;
+        std::vector<bool> _optimized_functions;
+        // The whole program at -O3. Generated on the first request and only used by the background thread.
+        Generated_Module _optimized;
+        std::unique_ptr<llvm::TargetMachine> _target_machine;
+        std::mutex _mutex;
+        std::condition_variable _condition;
+        std::deque<i64> _requests;
+        bool _stopping = false;
+        std::thread _thread;
+
+        void run() {
+            while(true) {
+                i64 index;
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _condition.wait(lock, [this]() { return _stopping || !_requests.empty(); });
+                    if(_stopping) {
+                        return;
+                    }
+                    index = _requests.front();
+                    _requests.pop_front();
+                }
+
+                if(_optimized_functions[index]) {
+                    continue;
+                }
+
+                _optimized_functions[index] = true;
+                if(llvm::Error error = tier_up(_functions[index])) {
+                    llvm::errs() << "warning: could not optimize '" << _functions[index] << "': " << llvm::toString(std::move(error)) << '\n';
+                }
+            }
+        }
+
+        llvm::Error tier_up(const std::string& name) {
+            if(!_optimized.module) {
+                _optimized = generate_module(_nodes, _options);
+                anton::Expected<std::unique_ptr<llvm::TargetMachine>, std::string> target_machine =
+                    Backend_Session::get().create_target_machine(make_target_description(_options));
+                if(!_optimized.module || !target_machine) {
+                    return llvm::createStringError(llvm::inconvertibleErrorCode(), "the optimized program could not be generated");
+                }
+                _target_machine = std::move(target_machine.value());
+            }
+
+            // Only the hot function is defined in the clone. Everything it refers to is declared and
+            // resolves to the stubs and the globals of the -O0 code.
+            llvm::ValueToValueMapTy value_map;
+            std::unique_ptr<llvm::Module> clone =
+                llvm::CloneModule(*_optimized.module, value_map, [&name](const llvm::GlobalValue* value) { return value->getName() == name; });
+            llvm::Function* function = clone->getFunction(name);
+            if(!function || function->isDeclaration()) {
+                return llvm::createStringError(llvm::inconvertibleErrorCode(), "the function was optimized away");
+            }
+
+            std::string const optimized_name = name + ".tier1";
+            function->setName(optimized_name);
+            function->setLinkage(llvm::GlobalValue::ExternalLinkage);
+            function->setComdat(nullptr);
+
+            llvm::SmallVector<char, 0> object;
+            llvm::raw_svector_ostream output(object);
+            llvm::legacy::PassManager pass_manager;
+            if(_target_machine->addPassesToEmitFile(pass_manager, output, nullptr, llvm::CGFT_ObjectFile)) {
+                return llvm::createStringError(llvm::inconvertibleErrorCode(), "the target cannot emit object files");
+            }
+            pass_manager.run(*clone);
+
+            if(llvm::Error error = _jit.addObjectFile(std::make_unique<llvm::SmallVectorMemoryBuffer>(std::move(object)))) {
+                return error;
+            }
+
+            llvm::Expected<llvm::JITEvaluatedSymbol> symbol = _jit.lookup(optimized_name);
+            if(!symbol) {
+                return symbol.takeError();
+            }
+            // Callers that enter through the stub from now on run the optimized code.
+            return _stubs.updatePointer(name, symbol->getAddress());
+        }
+    };
+
+    static Tiered_Compiler* active_tiered_compiler = nullptr;
+
+    static void request_tier_up(i64 const index) {
+        active_tiered_compiler->request(index);
+    }
+
+    anton::Expected<int, std::string> run_tiered(const std::vector<Owning_Ptr<Declaration>>& nodes, const Codegen_Options& options,
+                                                 const Tiering_Options& tiering, const std::vector<std::string>& arguments) {
+        Codegen_Options baseline_options = options;
+        baseline_options.optimization_level = Optimization_Level::O0;
+        Generated_Module module = generate_module(nodes, baseline_options);
+        if(!module.module) {
+            return {anton::expected_error, "nothing to run"};
+        }
+
+        anton::Expected<bool, std::string> takes_arguments = check_main(*module.module);
+        if(!takes_arguments) {
+            return {anton::expected_error, std::move(takes_arguments.error())};
+        }
+
+        anton::Expected<llvm::orc::JITTargetMachineBuilder, std::string> machine_builder = make_machine_builder(make_target_description(baseline_options));
+        if(!machine_builder) {
+            return {anton::expected_error, std::move(machine_builder.error())};
+        }
+
+        llvm::Triple const triple = machine_builder.value().getTargetTriple();
+        llvm::Expected<std::unique_ptr<llvm::orc::LLJIT>> jit = llvm::orc::LLJITBuilder().setJITTargetMachineBuilder(std::move(machine_builder.value())).create();
+        if(!jit) {
+            return {anton::expected_error, llvm::toString(jit.takeError())};
+        }
+
+        if(llvm::Error error = add_process_symbols(**jit)) {
+            return {anton::expected_error, llvm::toString(std::move(error))};
+        }
+
+        std::vector<std::string> functions;
+        instrument_for_tiering(*module.module, tiering.threshold, functions);
+
+        // The stubs are defined before the module is added, so that the calls in the module resolve to them.
+        std::unique_ptr<llvm::orc::IndirectStubsManager> stubs = llvm::orc::createLocalIndirectStubsManagerBuilder(triple)();
+        llvm::orc::SymbolMap symbols;
+        llvm::JITSymbolFlags const flags = llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable;
+        for(const std::string& name: functions) {
+            if(llvm::Error error = stubs->createStub(name, 0, flags)) {
+                return {anton::expected_error, llvm::toString(std::move(error))};
+            }
+            symbols[(*jit)->mangleAndIntern(name)] = stubs->findStub(name, false);
+        }
+        symbols[(*jit)->mangleAndIntern(tier_up_function_name)] =
+            llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(&request_tier_up), flags);
+        if(llvm::Error error = (*jit)->getMainJITDylib().define(llvm::orc::absoluteSymbols(std::move(symbols)))) {
+            return {anton::expected_error, llvm::toString(std::move(error))};
+        }
+
+        module.module->setDataLayout((*jit)->getDataLayout());
+        if(llvm::Error error = (*jit)->addIRModule(llvm::orc::ThreadSafeModule(std::move(module.module), std::move(module.context)))) {
+            return {anton::expected_error, llvm::toString(std::move(error))};
+        }
+
+        for(const std::string& name: functions) {
+            llvm::Expected<llvm::JITEvaluatedSymbol> baseline = (*jit)->lookup(name + ".tier0");
+            if(!baseline) {
+                return {anton::expected_error, llvm::toString(baseline.takeError())};
+            }
+
+            if(llvm::Error error = stubs->updatePointer(name, baseline->getAddress())) {
+                return {anton::expected_error, llvm::toString(std::move(error))};
+            }
+        }
+
+        Tiered_Compiler compiler{nodes, options, **jit, *stubs, functions};
+        active_tiered_compiler = &compiler;
+        int const result = call_main(stubs->findStub("main", false).getAddress(), takes_arguments.value(), arguments);
+        active_tiered_compiler = nullptr;
+        return {anton::expected_value, result};
+    }
+} // namespace tildac
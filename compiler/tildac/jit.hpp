@@ -0,0 +1,32 @@
+#pragma once
+
+#include <anton/expected.hpp>
+#include <tildac/ast.hpp>
+#include <tildac/backend.hpp>
+#include <tildac/codegen.hpp>
+#include <tildac/types.hpp>
+#include <tildac/utility.hpp>
+
+#include <string>
+#include <vector>
+
+namespace tildac {
+    // Runs `main` of the module in this process. Functions are compiled lazily, each when it is
+    // first called, so only the code that actually runs is ever compiled.
+    // `main` may either take no parameters or `(argc: i32, argv: c8**)`. arguments[0] is the program name.
+    // Returns the value returned by `main`.
+    [[nodiscard]] anton::Expected<int, std::string> run_module(Generated_Module module, const Target_Description& target,
+                                                               const std::vector<std::string>& arguments);
+
+    struct Tiering_Options {
+        // Number of calls after which a function is recompiled with full optimization.
+        i64 threshold = 1000;
+    };
+
+    // Runs `main` like run_module, but compiles the whole program at -O0 first, with a call counter
+    // at the entry of every function. Calls between functions go through stubs. A function that reaches
+    // the threshold is recompiled at -O3 on a background thread and its stub is repointed to the new code.
+    // Functions that are already running stay in the -O0 code until they return.
+    [[nodiscard]] anton::Expected<int, std::string> run_tiered(const std::vector<Owning_Ptr<Declaration>>& nodes, const Codegen_Options& options,
+                                                               const Tiering_Options& tiering, const std::vector<std::string>& arguments);
+} // namespace tildac
@@ -0,0 +1,124 @@
+#include <tildac/lto.hpp>
+
+#include <tildac/backend.hpp>
+
+#include <llvm/LTO/LTO.h>
+#include <llvm/MC/SubtargetFeature.h>
+#include <llvm/Support/CachePruning.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Threading.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+
+#include <memory>
+#include <unordered_map>
+
+namespace tildac {
+    // Os and Oz run the O2 pipeline. The functions carry optsize and minsize attributes that the passes respect.
+    static unsigned get_lto_optimization_level(Optimization_Level const level) {
+        switch(level) {
+            case Optimization_Level::O0:
+                return 0;
+            case Optimization_Level::O1:
+                return 1;
+            case Optimization_Level::O3:
+                return 3;
+            default:
+                return 2;
+        }
+    }
+
+    anton::Expected<std::vector<Output_Buffer>, std::string> link_thin(const std::vector<Bitcode_Module>& modules, const Codegen_Options& options,
+                                                                     const Thin_Link_Options& link_options) {
+        Target_Description const target = make_target_description(options);
+        anton::Expected<llvm::TargetMachine*, std::string> target_machine = Backend_Session::get().get_target_machine(target);
+        if(!target_machine) {
+            return {anton::expected_error, std::move(target_machine.error())};
+        }
+
+        // The backends create target machines of their own from the configuration.
+        llvm::TargetMachine& machine = *target_machine.value();
+        llvm::lto::Config config;
+        config.CPU = machine.getTargetCPU().str();
+        config.MAttrs = llvm::SubtargetFeatures(machine.getTargetFeatureString()).getFeatures();
+        config.Options = machine.Options;
+        config.RelocModel = machine.getRelocationModel();
+        config.CGOptLevel = target.optimization;
+        config.OptLevel = get_lto_optimization_level(options.optimization_level);
+        config.UseNewPM = true;
+        config.CGFileType = options.output_kind == Output_Kind::assembly ? llvm::CGFT_AssemblyFile : llvm::CGFT_ObjectFile;
+
+        unsigned const jobs = link_options.jobs > 0 ? static_cast<unsigned>(link_options.jobs) : llvm::heavyweight_hardware_concurrency();
+        llvm::lto::LTO lto(std::move(config), llvm::lto::createInProcessThinBackend(jobs));
+
+        // Template instances are weak and defined by every module that uses them. The first definition prevails.
+        // Maps the name of every defined symbol to whether its first definition is weak.
+        std::unordered_map<std::string, bool> definitions;
+        for(const Bitcode_Module& module: modules) {
+            llvm::MemoryBufferRef const buffer(llvm::StringRef(module.bitcode.data(), module.bitcode.size()), module.name);
+            llvm::Expected<std::unique_ptr<llvm::lto::InputFile>> input = llvm::lto::InputFile::create(buffer);
+            if(!input) {
+                return {anton::expected_error, module.name + ": " + llvm::toString(input.takeError())};
+            }
+
+            std::vector<llvm::lto::SymbolResolution> resolutions;
+            for(const llvm::lto::InputFile::Symbol& symbol: input.get()->symbols()) {
+                llvm::lto::SymbolResolution resolution;
+                if(!symbol.isUndefined()) {
+                    auto [iter, first] = definitions.emplace(symbol.getName().str(), symbol.isWeak());
+                    if(!first && !iter->second && !symbol.isWeak()) {
+                        return {anton::expected_error, module.name + ": duplicate definition of \"" + iter->first + "\""};
+                    }
+
+                    resolution.Prevailing = first;
+                    resolution.FinalDefinitionInLinkageUnit = true;
+                }
+                resolution.VisibleToRegularObj = symbol.getName() == "main";
+                resolutions.push_back(resolution);
+            }
+
+            if(llvm::Error error = lto.add(std::move(input.get()), resolutions)) {
+                return {anton::expected_error, module.name + ": " + llvm::toString(std::move(error))};
+            }
+        }
+
+        // Every task writes into a buffer of its own, so that the backends need no synchronization.
+        std::vector<Output_Buffer> buffers(lto.getMaxTasks());
+        auto add_stream = [&buffers](unsigned const task) {
+            return std::make_unique<llvm::lto::NativeObjectStream>(std::make_unique<llvm::raw_svector_ostream>(buffers[task]));
+        };
+
+        // Cached modules are handed out as memory buffers, both on hits and after misses have been compiled.
+        llvm::lto::NativeObjectCache cache = nullptr;
+        if(!link_options.cache_directory.empty()) {
+            auto add_buffer = [&buffers](unsigned const task, std::unique_ptr<llvm::MemoryBuffer> buffer) {
+                buffers[task].assign(buffer->getBufferStart(), buffer->getBufferEnd());
+            };
+            llvm::Expected<llvm::lto::NativeObjectCache> local_cache = llvm::lto::localCache(link_options.cache_directory, add_buffer);
+            if(!local_cache) {
+                return {anton::expected_error, llvm::toString(local_cache.takeError())};
+            }
+            cache = std::move(local_cache.get());
+        }
+
+        if(llvm::Error error = lto.run(add_stream, cache)) {
+            return {anton::expected_error, llvm::toString(std::move(error))};
+        }
+
+        if(!link_options.cache_directory.empty()) {
+            llvm::CachePruningPolicy policy;
+            policy.MaxSizeBytes = static_cast<u64>(link_options.cache_size);
+            llvm::pruneCache(link_options.cache_directory, policy);
+        }
+
+        // Task 0 compiles the modules without summaries, of which there are none, and stays empty.
+        std::vector<Output_Buffer> objects;
+        for(Output_Buffer& buffer: buffers) {
+            if(!buffer.empty()) {
+                objects.push_back(std::move(buffer));
+            }
+        }
+        return {anton::expected_value, std::move(objects)};
+    }
+} // namespace tildac
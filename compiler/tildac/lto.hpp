@@ -0,0 +1,35 @@
+#pragma once
+
+#include <anton/expected.hpp>
+#include <tildac/codegen.hpp>
+#include <tildac/types.hpp>
+
+#include <string>
+#include <vector>
+
+namespace tildac {
+    struct Bitcode_Module {
+        // Name of the module in diagnostics, usually the path it was read from.
+        std::string name;
+        Output_Buffer bitcode;
+    };
+
+    struct Thin_Link_Options {
+        // Number of modules that are optimized and compiled in parallel. 0 uses every hardware thread.
+        i64 jobs = 0;
+        // Compiled modules are cached in this directory across links. Empty disables the cache.
+        std::string cache_directory;
+        // The cache is pruned to this many bytes after every link.
+        i64 cache_size = 0;
+    };
+
+    // Links modules emitted with LTO_Mode::thin into native code. The thin link reads only the summaries
+    // of the modules and decides which functions every module imports from the others. Each module is
+    // then optimized together with its imports and compiled on a backend thread of its own, producing
+    // one output per module.
+    //
+    // The modules are treated as the whole program. Only `main` remains visible to the system linker,
+    // every other definition may be internalized or removed.
+    [[nodiscard]] anton::Expected<std::vector<Output_Buffer>, std::string> link_thin(const std::vector<Bitcode_Module>& modules, const Codegen_Options& options,
+                                                                                   const Thin_Link_Options& link_options);
+} // namespace tildac
@@ -1,24 +1,882 @@
+#include <charconv>
+#include <chrono>
+#include <filesystem>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <iterator>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <vector>
 
 #include <tildac/ast.hpp>
+#include <tildac/bytecode.hpp>
+#include <tildac/cache.hpp>
 #include <tildac/codegen.hpp>
+#include <tildac/incremental.hpp>
+#include <tildac/interpreter.hpp>
+#include <tildac/jit.hpp>
+#include <tildac/lto.hpp>
+#include <tildac/memory_report.hpp>
 #include <tildac/parser.hpp>
+#include <tildac/profile.hpp>
+#include <tildac/timing.hpp>
 #include <tildac/types.hpp>
 
+#include <llvm/Support/Regex.h>
+
+using namespace tildac;
+
+static double milliseconds_since(std::chrono::steady_clock::time_point const start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void print_benchmark(std::string_view const name, double const compile_time, double const execution_time, int const result) {
+    std::cout << "    " << std::left << std::setw(12) << name << std::right << std::fixed << std::setprecision(2) << "compile " << std::setw(10)
+              << compile_time << " ms    execute " << std::setw(10) << execution_time << " ms    result " << result << '\n';
+}
+
+// Compiles and runs every file with the bytecode interpreter, the JIT at -O0 and the JIT at the selected
+// level. The execution time of the JIT includes instruction selection since functions are compiled lazily.
+// The first JIT run also pays for initializing LLVM.
+static int run_benchmarks(const std::vector<std::string_view>& input_files, const Codegen_Options& options, const std::vector<std::string>& arguments) {
+    static constexpr std::string_view level_names[] = {"llvm -O0", "llvm -O1", "llvm -O2", "llvm -O3", "llvm -Os", "llvm -Oz"};
+    for(std::string_view const path: input_files) {
+        anton::Expected<Owning_Ptr<Declaration_Sequence>, Parse_Error> res = parse_file(path);
+        if(!res) {
+            Parse_Error const& error = res.error();
+            std::cout << path << ":" << error.line << ":" << error.column << ": error:" << error.message << '\n';
+            return -1;
+        }
+
+        std::vector<std::string> program_arguments = arguments;
+        program_arguments.emplace(program_arguments.begin(), path);
+        std::cout << path << '\n';
+
+        auto start = std::chrono::steady_clock::now();
+        anton::Expected<Bytecode_Program, std::string> program = compile_bytecode(res.value()->decls, options.overflow);
+        double const compile_time = milliseconds_since(start);
+        if(!program) {
+            std::cout << "error: " << program.error() << '\n';
+            return -1;
+        }
+
+        start = std::chrono::steady_clock::now();
+        anton::Expected<int, std::string> expected_result = run_bytecode(program.value(), program_arguments);
+        double const execution_time = milliseconds_since(start);
+        if(!expected_result) {
+            std::cout << "error: " << expected_result.error() << '\n';
+            return -1;
+        }
+        print_benchmark("bytecode", compile_time, execution_time, expected_result.value());
+
+        Optimization_Level const levels[] = {Optimization_Level::O0, options.optimization_level};
+        for(i64 i = 0; i < (options.optimization_level == Optimization_Level::O0 ? 1 : 2); ++i) {
+            Codegen_Options level_options = options;
+            level_options.optimization_level = levels[i];
+            start = std::chrono::steady_clock::now();
+            Generated_Module module = generate_module(res.value()->decls, level_options);
+            double const compile_time = milliseconds_since(start);
+            start = std::chrono::steady_clock::now();
+            anton::Expected<int, std::string> result = run_module(std::move(module), make_target_description(level_options), program_arguments);
+            double const execution_time = milliseconds_since(start);
+            if(!result) {
+                std::cout << "error: " << result.error() << '\n';
+                return -1;
+            }
+
+            print_benchmark(level_names[static_cast<i64>(levels[i])], compile_time, execution_time, result.value());
+            if(result.value() != expected_result.value()) {
+                std::cout << "error: the results of the bytecode interpreter and the JIT differ\n";
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+// `file.tc` becomes `file.o`, `file.s`, `file.ll` or `file.bc` in the working directory.
+static std::filesystem::path make_output_path(std::string_view const input_file, Output_Kind const kind) {
+    static constexpr std::string_view extensions[] = {".o", ".s", ".ll", ".bc"};
+    std::filesystem::path path = std::filesystem::path(input_file).filename();
+    path.replace_extension(extensions[static_cast<i64>(kind)]);
+    return path;
+}
+
+// Partition i of a module split into several partitions goes to `name.<i>.ext`.
+static std::vector<std::filesystem::path> make_partition_paths(const std::filesystem::path& path, u64 const partition_count) {
+    if(partition_count == 1) {
+        return {path};
+    }
+
+    std::vector<std::filesystem::path> paths;
+    for(u64 i = 0; i < partition_count; ++i) {
+        paths.push_back(path);
+        paths.back().replace_filename(path.stem().string() + "." + std::to_string(i) + path.extension().string());
+    }
+    return paths;
+}
+
+// Writes the buffers to the path, or to stdout if the path is `-`.
+static bool write_output(const std::filesystem::path& path, const std::vector<Output_Buffer>& buffers) {
+    std::vector<std::filesystem::path> const partition_paths = make_partition_paths(path, buffers.size());
+    for(u64 i = 0; i < buffers.size(); ++i) {
+        const Output_Buffer& buffer = buffers[i];
+        if(path == "-") {
+            std::cout.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            continue;
+        }
+
+        const std::filesystem::path& partition_path = partition_paths[i];
+        std::ofstream file(partition_path, std::ios::binary);
+        file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        if(!file) {
+            std::cout << "error: could not write '" << partition_path.string() << "'\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool read_file(std::string_view const path, std::string& contents) {
+    std::ifstream file{std::string(path), std::ios::binary};
+    if(!file) {
+        return false;
+    }
+
+    contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return !file.bad();
+}
+
+// Identifies the build of the compiler, so that a rebuilt compiler does not reuse outputs of the old one.
+// The size and modification time of the executable stand in for a hash of it, which would cost more
+// than most compilations.
+static std::string get_compiler_identity(char const* const argv0) {
+    std::string identity = "tildac";
+    std::error_code error;
+    std::filesystem::path executable = "/proc/self/exe";
+    if(!std::filesystem::exists(executable, error)) {
+        executable = argv0;
+    }
+
+    std::filesystem::path const resolved = std::filesystem::canonical(executable, error);
+    if(!error) {
+        identity += ";" + resolved.string() + ";" + std::to_string(std::filesystem::file_size(resolved, error)) + ";" +
+                    std::to_string(std::filesystem::last_write_time(resolved, error).time_since_epoch().count());
+    }
+    return identity;
+}
+
+// Parses non-negative decimal numbers without a sign.
+static bool parse_number(std::string_view const string, i64& number) {
+    char const* const end = string.data() + string.size();
+    auto const [last, error] = std::from_chars(string.data(), end, number);
+    return string.size() != 0 && string[0] != '-' && error == std::errc() && last == end;
+}
+
+// Parses the number that follows the prefix of the argument, e.g. `-fcodegen-threads=`.
+static bool parse_number_argument(std::string_view const argument, u64 const prefix_length, i64& number) {
+    if(!parse_number(argument.substr(prefix_length), number)) {
+        std::cout << "error: '" << argument << "' requires a number\n";
+        return false;
+    }
+    return true;
+}
+
+// Parses sizes such as `500M`, where the suffixes K, M and G are powers of 1024.
+static bool parse_size(std::string_view const string, i64& size) {
+    i64 multiplier = 1;
+    std::string_view digits = string;
+    if(digits.size() != 0) {
+        switch(digits.back()) {
+            case 'K':
+                multiplier = i64(1) << 10;
+                break;
+            case 'M':
+                multiplier = i64(1) << 20;
+                break;
+            case 'G':
+                multiplier = i64(1) << 30;
+                break;
+        }
+        if(multiplier != 1) {
+            digits.remove_suffix(1);
+        }
+    }
+
+    if(digits.size() > 12 || !parse_number(digits, size)) {
+        return false;
+    }
+    size *= multiplier;
+    return true;
+}
+
+// Debug info names the source by its absolute path, hence the output also depends on the working directory.
+static std::string describe_debug_source(std::string_view const path, const Codegen_Options& options) {
+    if(options.debug_info == Debug_Info_Level::none) {
+        return "";
+    }
+    return ";debug-source=" + std::filesystem::absolute(std::filesystem::path(path)).string();
+}
+
+// Compiles every unit of the file into an object of its own and collects the objects in an archive.
+// Only the units whose fingerprints are not in the cache are lowered, the others are read from it.
+static bool compile_incremental(std::string_view const path, const std::filesystem::path& output, const Codegen_Options& options, Compilation_Cache& cache,
+                                std::string_view const compiler_identity, std::string_view const options_description) {
+    anton::Expected<Owning_Ptr<Declaration_Sequence>, Parse_Error> res = parse_file(path);
+    if(!res) {
+        Parse_Error const& error = res.error();
+        std::cout << path << ":" << error.line << ":" << error.column << ": error:" << error.message << '\n';
+        return false;
+    }
+
+    Unit_Declarations declarations{res.value()->decls, options.evaluation_limits, options.overflow};
+    std::vector<i64> units = declarations.function_units;
+    for(const auto& node: res.value()->decls) {
+        if(node->node_type == AST_Node_Type::variable_declaration && !static_cast<const Variable_Declaration&>(*node).template_parameters) {
+            units.insert(units.begin(), global_variables_unit);
+            break;
+        }
+    }
+
+    // Objects record the path of their source.
+    std::string const description = std::string(options_description) + ";unit;source=" + std::string(path) + describe_debug_source(path, options);
+    std::string const stem = std::filesystem::path(path).stem().string();
+    std::vector<Archive_Member> members(units.size());
+    for(u64 i = 0; i < units.size(); ++i) {
+        i64 const unit = units[i];
+        Archive_Member& member = members[i];
+        member.name = stem + "." + (unit == global_variables_unit ? "globals" : static_cast<const Function_Declaration&>(*res.value()->decls[unit]).name->name) + ".o";
+        std::string const key = Compilation_Cache::make_key(fingerprint_unit(declarations, unit, options), compiler_identity, description);
+        if(cache.retrieve(key, member.object)) {
+            continue;
+        }
+
+        std::vector<Output_Buffer> buffers(1);
+        if(!generate_unit(declarations, unit, path, options, buffers[0])) {
+            return false;
+        }
+        cache.store(key, buffers);
+        member.object = std::move(buffers[0]);
+    }
+
+    std::string error;
+    if(!write_archive(output.string(), members, options, error)) {
+        std::cout << "error: could not write '" << output.string() << "': " << error << '\n';
+        return false;
+    }
+    return true;
+}
+
+// Compiles the file into the output, or copies the output out of the cache if it is not nullptr.
+static bool compile_file(std::string_view const path, const std::filesystem::path& output, const Codegen_Options& options, Compilation_Cache* const cache,
+                         std::string_view const compiler_identity, std::string_view const options_description, bool const cache_hard_link) {
+    // The source is hashed as is. There is no preprocessor or import mechanism, so the file alone
+    // determines the output.
+    std::string key;
+    if(cache) {
+        Time_Scope const scope("Look up cache", path);
+        std::string source;
+        if(!read_file(path, source)) {
+            std::cout << path << ":0:0: error:Could not open for reading\n";
+            return false;
+        }
+
+        // The output records the path of the source as its module identifier and source file name.
+        std::string const description = std::string(options_description) + ";source=" + std::string(path) + describe_debug_source(path, options);
+        key = Compilation_Cache::make_key(source, compiler_identity, description);
+        bool const partitioned = options.output_kind == Output_Kind::object || options.output_kind == Output_Kind::assembly;
+        u64 const partition_count = partitioned ? static_cast<u64>(options.codegen_threads) : 1;
+        if(cache->retrieve(key, make_partition_paths(output, partition_count), cache_hard_link)) {
+            return true;
+        }
+    }
+
+    anton::Expected<Owning_Ptr<Declaration_Sequence>, Parse_Error> res = parse_file(path);
+    if(!res) {
+        Parse_Error const& error = res.error();
+        std::cout << path << ":" << error.line << ":" << error.column << ": error:" << error.message << '\n';
+        return false;
+    }
+
+    std::vector<Output_Buffer> buffers;
+    if(!generate(res.value()->decls, path, options, buffers)) {
+        return false;
+    }
+
+    {
+        Time_Scope const scope("Write output", output.string());
+        if(!write_output(output, buffers)) {
+            return false;
+        }
+    }
+
+    if(cache) {
+        Time_Scope const scope("Store in cache", path);
+        cache->store(key, buffers);
+    }
+    return true;
+}
+
+// `file.json` next to the output, or in the working directory if the output is written to stdout.
+static std::filesystem::path make_time_trace_path(std::string_view const path, const std::filesystem::path& output) {
+    std::filesystem::path trace_path = output == "-" ? std::filesystem::path(path).filename() : output;
+    return trace_path.replace_extension(".json");
+}
+
+static bool write_time_trace(const std::filesystem::path& path) {
+    std::string error;
+    if(!finish_time_trace(path, error)) {
+        std::cout << "error: could not write '" << path.string() << "': " << error << '\n';
+        return false;
+    }
+    return true;
+}
+
+// Remarks select passes by regular expressions, e.g. `-Rpass=inline|loop-vectorize`.
+static bool check_remark_pattern(std::string_view const argument, const std::string& pattern) {
+    std::string error;
+    if(!llvm::Regex(pattern).isValid(error)) {
+        std::cout << "error: invalid regular expression in '" << argument << "': " << error << '\n';
+        return false;
+    }
+    return true;
+}
+
+static int print_cache_statistics(const Compilation_Cache& cache, const std::filesystem::path& directory, i64 const max_size) {
+    Cache_Statistics const statistics = cache.get_statistics();
+    i64 const lookups = statistics.hits + statistics.misses;
+    double const hit_rate = lookups != 0 ? 100.0 * static_cast<double>(statistics.hits) / static_cast<double>(lookups) : 0.0;
+    std::cout << "cache directory  " << directory.string() << '\n';
+    std::cout << "hits             " << statistics.hits << '\n';
+    std::cout << "misses           " << statistics.misses << '\n';
+    std::cout << "hit rate         " << std::fixed << std::setprecision(1) << hit_rate << " %\n";
+    std::cout << "size             " << statistics.size << " bytes\n";
+    std::cout << "limit            " << max_size << " bytes\n";
+    return 0;
+}
+
 int main(int argc, char** argv) {
-    for(tildac::i64 i = 1; i < argc; ++i) {
-        anton::Expected<Owning_Ptr<Declaration_Sequence>, Parse_Error> res = tildac::parse_file(argv[i]);
+    Codegen_Options options;
+    bool tiered_compilation = false;
+    bool interpret = false;
+    bool dump_bytecode = false;
+    // With -flto=thin the driver links the inputs unless -c, -S or -emit-* stops it after compiling them.
+    bool compile_only = false;
+    // Both -emit-llvm and -S select the textual variant of the output.
+    bool emit_assembly = false;
+    bool emit_llvm = false;
+    bool emit_bitcode = false;
+    std::string_view output_path;
+    bool use_cache = false;
+    bool cache_hard_link = false;
+    // Compiles every function into an object of its own that is cached separately.
+    bool incremental = false;
+    std::filesystem::path cache_directory = Compilation_Cache::default_directory();
+    i64 cache_size = i64(1) << 30;
+    i64 lto_jobs = 0;
+    // Writes a Chrome trace of the phases and passes of every file into `file.json` next to its output.
+    bool time_trace = false;
+    i64 time_trace_granularity = 500;
+    bool time_report = false;
+    bool memory_report = false;
+    Tiering_Options tiering;
+    std::vector<std::string_view> input_files;
+    // `tildac run file.tc -- args` runs the program in the JIT instead of writing an object file.
+    bool const run = argc > 1 && std::string_view(argv[1]) == "run";
+    // `tildac bench files... -- args` compares the bytecode interpreter against the JIT.
+    bool const bench = argc > 1 && std::string_view(argv[1]) == "bench";
+    // `tildac cache-stats` and `tildac cache-clear` inspect and empty the compilation cache.
+    bool const cache_stats = argc > 1 && std::string_view(argv[1]) == "cache-stats";
+    bool const cache_clear = argc > 1 && std::string_view(argv[1]) == "cache-clear";
+    // `tildac profile-merge -o out.profdata files...` turns raw profiles into the input of -fprofile-use.
+    bool const profile_merge = argc > 1 && std::string_view(argv[1]) == "profile-merge";
+    std::vector<std::string> program_arguments;
+    for(i64 i = run || bench || cache_stats || cache_clear || profile_merge ? 2 : 1; i < argc; ++i) {
+        std::string_view const argument = argv[i];
+        if((run || bench) && argument == "--") {
+            for(i += 1; i < argc; ++i) {
+                program_arguments.emplace_back(argv[i]);
+            }
+        } else if(argument == "-o") {
+            if(i + 1 == argc) {
+                std::cout << "error: '-o' requires a path\n";
+                return -1;
+            }
+            i += 1;
+            output_path = argv[i];
+        } else if(argument == "-c") {
+            compile_only = true;
+            emit_assembly = false;
+        } else if(argument == "-S") {
+            emit_assembly = true;
+        } else if(argument == "-emit-llvm") {
+            emit_llvm = true;
+        } else if(argument == "-emit-bc") {
+            emit_bitcode = true;
+        } else if(argument == "-O0") {
+            options.optimization_level = Optimization_Level::O0;
+        } else if(argument == "-O1") {
+            options.optimization_level = Optimization_Level::O1;
+        } else if(argument == "-O2") {
+            options.optimization_level = Optimization_Level::O2;
+        } else if(argument == "-O3") {
+            options.optimization_level = Optimization_Level::O3;
+        } else if(argument == "-Os") {
+            options.optimization_level = Optimization_Level::Os;
+        } else if(argument == "-Oz") {
+            options.optimization_level = Optimization_Level::Oz;
+        } else if(argument == "-g") {
+            options.debug_info = Debug_Info_Level::full;
+        } else if(argument == "-gline-tables-only") {
+            options.debug_info = Debug_Info_Level::line_tables_only;
+        } else if(argument == "-g0") {
+            options.debug_info = Debug_Info_Level::none;
+        } else if(argument.substr(0, 7) == "-Rpass=") {
+            options.remarks.passed = argument.substr(7);
+            if(!check_remark_pattern(argument, options.remarks.passed)) {
+                return -1;
+            }
+        } else if(argument == "-Rpass-missed") {
+            options.remarks.missed = ".*";
+        } else if(argument.substr(0, 14) == "-Rpass-missed=") {
+            options.remarks.missed = argument.substr(14);
+            if(!check_remark_pattern(argument, options.remarks.missed)) {
+                return -1;
+            }
+        } else if(argument == "-Rpass-analysis") {
+            options.remarks.analysis = ".*";
+        } else if(argument.substr(0, 16) == "-Rpass-analysis=") {
+            options.remarks.analysis = argument.substr(16);
+            if(!check_remark_pattern(argument, options.remarks.analysis)) {
+                return -1;
+            }
+        } else if(argument == "-fxray-instrument") {
+            options.xray_instrument = true;
+        } else if(argument == "-fno-xray-instrument") {
+            options.xray_instrument = false;
+        } else if(argument.substr(0, 29) == "-fxray-instruction-threshold=") {
+            if(!parse_number_argument(argument, 29, options.xray_instruction_threshold)) {
+                return -1;
+            }
+        } else if(argument == "-ffast-math") {
+            options.fast_math.fast = true;
+        } else if(argument == "-fno-fast-math") {
+            options.fast_math = Fast_Math_Options();
+        } else if(argument == "-fassociative-math") {
+            options.fast_math.associative = true;
+        } else if(argument == "-fno-associative-math") {
+            options.fast_math.associative = false;
+        } else if(argument == "-fno-signed-zeros") {
+            options.fast_math.no_signed_zeros = true;
+        } else if(argument == "-fsigned-zeros") {
+            options.fast_math.no_signed_zeros = false;
+        } else if(argument == "-freciprocal-math") {
+            options.fast_math.reciprocal = true;
+        } else if(argument == "-fno-reciprocal-math") {
+            options.fast_math.reciprocal = false;
+        } else if(argument.substr(0, 14) == "-ffp-contract=") {
+            std::string_view const mode = argument.substr(14);
+            if(mode != "fast" && mode != "off") {
+                std::cout << "error: '" << argument << "' requires fast or off\n";
+                return -1;
+            }
+            options.fast_math.contract = mode == "fast";
+        } else if(argument.substr(0, 11) == "-foverflow=") {
+            std::string_view const policy = argument.substr(11);
+            if(policy == "wrap") {
+                options.overflow = Overflow_Policy::wrap;
+            } else if(policy == "trap") {
+                options.overflow = Overflow_Policy::trap;
+            } else if(policy == "undefined") {
+                options.overflow = Overflow_Policy::undefined;
+            } else {
+                std::cout << "error: '" << argument << "' requires wrap, trap or undefined\n";
+                return -1;
+            }
+        } else if(argument.substr(0, 27) == "-fsave-optimization-record=") {
+            options.remarks.record_path = argument.substr(27);
+        } else if(argument == "-fglobal-isel") {
+            options.target.global_isel = true;
+        } else if(argument == "-fno-global-isel") {
+            options.target.global_isel = false;
+        } else if(argument == "-ftemplate-comdat") {
+            options.deduplicate_instantiations = true;
+        } else if(argument == "-fno-template-comdat") {
+            options.deduplicate_instantiations = false;
+        } else if(argument == "-fconstant-evaluation") {
+            options.evaluate_constant_calls = true;
+        } else if(argument == "-fno-constant-evaluation") {
+            options.evaluate_constant_calls = false;
+        } else if(argument.substr(0, 18) == "-fconstexpr-steps=") {
+            if(!parse_number_argument(argument, 18, options.evaluation_limits.max_steps)) {
+                return -1;
+            }
+        } else if(argument.substr(0, 19) == "-fconstexpr-memory=") {
+            if(!parse_number_argument(argument, 19, options.evaluation_limits.max_memory)) {
+                return -1;
+            }
+        } else if(argument.substr(0, 18) == "-fcodegen-threads=") {
+            if(!parse_number_argument(argument, 18, options.codegen_threads)) {
+                return -1;
+            } else if(options.codegen_threads < 1) {
+                std::cout << "error: '" << argument << "' requires at least 1 thread\n";
+                return -1;
+            }
+        } else if(argument == "-fcache") {
+            use_cache = true;
+        } else if(argument == "-fno-cache") {
+            use_cache = false;
+        } else if(argument.substr(0, 12) == "-fcache-dir=") {
+            use_cache = true;
+            cache_directory = argument.substr(12);
+        } else if(argument.substr(0, 13) == "-fcache-size=") {
+            if(!parse_size(argument.substr(13), cache_size)) {
+                std::cout << "error: '" << argument << "' requires a size in bytes with an optional K, M or G suffix\n";
+                return -1;
+            }
+        } else if(argument == "-fincremental") {
+            incremental = true;
+            use_cache = true;
+        } else if(argument == "-fno-incremental") {
+            incremental = false;
+        } else if(argument == "-fcache-hardlink") {
+            cache_hard_link = true;
+        } else if(argument == "-fno-cache-hardlink") {
+            cache_hard_link = false;
+        } else if(argument == "-flto=thin") {
+            options.lto = LTO_Mode::thin;
+        } else if(argument == "-fno-lto") {
+            options.lto = LTO_Mode::none;
+        } else if(argument.substr(0, 11) == "-flto-jobs=") {
+            if(!parse_number_argument(argument, 11, lto_jobs)) {
+                return -1;
+            }
+        } else if(argument == "-flto" || argument.substr(0, 6) == "-flto=") {
+            std::cout << "error: only '-flto=thin' is supported\n";
+            return -1;
+        } else if(argument == "-fprofile-generate") {
+            options.profile_mode = Profile_Mode::generate;
+            options.profile_path = "default.profraw";
+        } else if(argument.substr(0, 19) == "-fprofile-generate=") {
+            options.profile_mode = Profile_Mode::generate;
+            options.profile_path = argument.substr(19);
+        } else if(argument == "-fprofile-use") {
+            options.profile_mode = Profile_Mode::use;
+            options.profile_path = "default.profdata";
+        } else if(argument.substr(0, 14) == "-fprofile-use=") {
+            options.profile_mode = Profile_Mode::use;
+            options.profile_path = argument.substr(14);
+        } else if(argument == "-fno-profile-generate" || argument == "-fno-profile-use") {
+            options.profile_mode = Profile_Mode::none;
+        } else if(argument == "-ftime-trace") {
+            time_trace = true;
+        } else if(argument == "-fno-time-trace") {
+            time_trace = false;
+        } else if(argument.substr(0, 25) == "-ftime-trace-granularity=") {
+            if(!parse_number_argument(argument, 25, time_trace_granularity)) {
+                return -1;
+            }
+        } else if(argument == "-ftime-report") {
+            time_report = true;
+        } else if(argument == "-fno-time-report") {
+            time_report = false;
+        } else if(argument == "-fmem-report") {
+            memory_report = true;
+        } else if(argument == "-fno-mem-report") {
+            memory_report = false;
+        } else if(argument == "-finterpret") {
+            interpret = true;
+        } else if(argument == "-fno-interpret") {
+            interpret = false;
+        } else if(argument == "-fdump-bytecode") {
+            dump_bytecode = true;
+        } else if(argument == "-ftiered-compilation") {
+            tiered_compilation = true;
+        } else if(argument == "-fno-tiered-compilation") {
+            tiered_compilation = false;
+        } else if(argument.substr(0, 20) == "-ftier-up-threshold=") {
+            if(!parse_number_argument(argument, 20, tiering.threshold)) {
+                return -1;
+            } else if(tiering.threshold < 1) {
+                std::cout << "error: '" << argument << "' requires at least 1 call\n";
+                return -1;
+            }
+        } else if(argument.substr(0, 7) == "-march=") {
+            options.target.cpu = argument.substr(7);
+        } else if(argument.substr(0, 6) == "-mcpu=") {
+            options.target.cpu = argument.substr(6);
+        } else if(argument.substr(0, 7) == "-mattr=") {
+            // Repeated -mattr options accumulate.
+            if(options.target.features.size() != 0) {
+                options.target.features += ',';
+            }
+            options.target.features += argument.substr(7);
+        } else if(argument.size() > 1 && argument[0] == '-') {
+            std::cout << "error: unknown option '" << argument << "'\n";
+            return -1;
+        } else {
+            input_files.push_back(argument);
+        }
+    }
+
+    if(emit_bitcode) {
+        options.output_kind = Output_Kind::llvm_bitcode;
+    } else if(emit_llvm) {
+        options.output_kind = emit_assembly ? Output_Kind::llvm_ir : Output_Kind::llvm_bitcode;
+    } else {
+        options.output_kind = emit_assembly ? Output_Kind::assembly : Output_Kind::object;
+    }
+
+    if(profile_merge) {
+        std::vector<std::string> const inputs(input_files.begin(), input_files.end());
+        anton::Expected<i64, std::string> result = merge_profiles(inputs, output_path.size() != 0 ? std::string(output_path) : "default.profdata");
+        if(!result) {
+            std::cout << "error: " << result.error() << '\n';
+            return -1;
+        }
+        return 0;
+    }
+
+    if(options.profile_mode != Profile_Mode::none && options.optimization_level == Optimization_Level::O0) {
+        std::cout << "error: '-fprofile-generate' and '-fprofile-use' require optimizations\n";
+        return -1;
+    }
+
+    if(options.profile_mode == Profile_Mode::generate && (run || bench)) {
+        std::cout << "error: programs compiled with '-fprofile-generate' must be linked with the profile runtime\n";
+        return -1;
+    }
+
+    // The passes report a missing profile only once the module has been generated.
+    if(options.profile_mode == Profile_Mode::use && !std::ifstream(options.profile_path)) {
+        std::cout << "error: could not read profile '" << options.profile_path << "'\n";
+        return -1;
+    }
+
+    if((time_trace || time_report) && (run || bench)) {
+        std::cout << "error: '-ftime-trace' and '-ftime-report' only time the compilation of files\n";
+        return -1;
+    }
+
+    if(!options.remarks.record_path.empty() && (run || bench)) {
+        std::cout << "error: '-fsave-optimization-record' only records the compilation of files\n";
+        return -1;
+    }
+
+    if(!options.remarks.record_path.empty() && input_files.size() > 1) {
+        std::cout << "error: '-fsave-optimization-record' cannot be used with multiple input files\n";
+        return -1;
+    }
+
+    // The XRay runtime finds the sleds in the sections of the executable, which code of the JIT lacks.
+    if(options.xray_instrument && (run || bench)) {
+        std::cout << "error: '-fxray-instrument' only instruments the compilation of files\n";
+        return -1;
+    }
+
+    if(memory_report && (run || bench)) {
+        std::cout << "error: '-fmem-report' only measures the compilation of files\n";
+        return -1;
+    }
+
+    // LLVM records the events of all threads into the same trace without synchronizing them.
+    if(time_trace && options.codegen_threads > 1) {
+        std::cout << "error: '-ftime-trace' requires '-fcodegen-threads=1'\n";
+        return -1;
+    }
+
+    if(cache_stats || cache_clear) {
+        Compilation_Cache cache{cache_directory, cache_size};
+        if(cache_clear) {
+            cache.clear();
+            return 0;
+        }
+        return print_cache_statistics(cache, cache_directory, cache_size);
+    }
+
+    if(bench) {
+        return run_benchmarks(input_files, options, program_arguments);
+    }
+
+    if(run) {
+        if(input_files.size() != 1) {
+            std::cout << "error: 'run' requires exactly one input file\n";
+            return -1;
+        }
+
+        std::string_view const path = input_files[0];
+        anton::Expected<Owning_Ptr<Declaration_Sequence>, Parse_Error> res = parse_file(path);
         if(!res) {
             Parse_Error const& error = res.error();
-            std::cout << argv[i] << ":" << error.line << ":" << error.column << ": error:" << error.message << '\n';
+            std::cout << path << ":" << error.line << ":" << error.column << ": error:" << error.message << '\n';
+            return -1;
+        }
+
+        program_arguments.emplace(program_arguments.begin(), path);
+        if(interpret) {
+            anton::Expected<Bytecode_Program, std::string> program = compile_bytecode(res.value()->decls, options.overflow);
+            if(!program) {
+                std::cout << "error: " << program.error() << '\n';
+                return -1;
+            }
+
+            if(dump_bytecode) {
+                std::cout << print_bytecode(program.value());
+            }
+
+            anton::Expected<int, std::string> result = run_bytecode(program.value(), program_arguments);
+            if(!result) {
+                std::cout << "error: " << result.error() << '\n';
+                return -1;
+            }
+            return result.value();
+        }
+
+        anton::Expected<int, std::string> result =
+            tiered_compilation ? run_tiered(res.value()->decls, options, tiering, program_arguments)
+                               : run_module(generate_module(res.value()->decls, options), make_target_description(options), program_arguments);
+        if(!result) {
+            std::cout << "error: " << result.error() << '\n';
             return -1;
         }
+        return result.value();
+    }
+
+    if(time_report) {
+        enable_time_report();
+    }
+
+    if(memory_report) {
+        enable_memory_report();
+    }
+
+    // Inputs other than source files are bitcode compiled earlier with -c -flto=thin. Compiling files
+    // separately and linking them afterwards recompiles only the sources that changed.
+
+    if(options.lto == LTO_Mode::thin && !compile_only && !emit_assembly && !emit_llvm && !emit_bitcode) {
+        if(time_trace) {
+            std::cout << "error: '-ftime-trace' cannot trace the thin link, which runs on several threads\n";
+            return -1;
+        }
+
+        std::vector<Bitcode_Module> modules;
+        for(std::string_view const path: input_files) {
+            Bitcode_Module& module = modules.emplace_back();
+            module.name = path;
+            if(std::filesystem::path(path).extension() != ".tc") {
+                std::string bitcode;
+                if(!read_file(path, bitcode)) {
+                    std::cout << "error: could not read '" << path << "'\n";
+                    return -1;
+                }
+                module.bitcode.assign(bitcode.begin(), bitcode.end());
+                continue;
+            }
+
+            anton::Expected<Owning_Ptr<Declaration_Sequence>, Parse_Error> res = parse_file(path);
+            if(!res) {
+                Parse_Error const& error = res.error();
+                std::cout << path << ":" << error.line << ":" << error.column << ": error:" << error.message << '\n';
+                return -1;
+            }
+
+            std::vector<Output_Buffer> buffers;
+            if(!generate(res.value()->decls, path, options, buffers)) {
+                return -1;
+            }
+            module.bitcode = std::move(buffers[0]);
+        }
+
+        Thin_Link_Options link_options;
+        link_options.jobs = lto_jobs;
+        if(use_cache) {
+            link_options.cache_directory = (cache_directory / "thinlto").string();
+            link_options.cache_size = cache_size;
+        }
+
+        anton::Expected<std::vector<Output_Buffer>, std::string> objects = [&modules, &options, &link_options]() {
+            Time_Scope const scope("Link modules");
+            return link_thin(modules, options, link_options);
+        }();
+        if(!objects) {
+            std::cout << "error: " << objects.error() << '\n';
+            return -1;
+        }
+
+        // Every module becomes an object of its own, `a.<i>.o` by default.
+        if(!write_output(output_path.size() != 0 ? std::filesystem::path(output_path) : std::filesystem::path("a.o"), objects.value())) {
+            return -1;
+        }
+        print_time_report();
+        print_memory_report();
+        return 0;
+    }
+
+    if(output_path.size() != 0 && input_files.size() > 1) {
+        std::cout << "error: '-o' cannot be used with multiple input files\n";
+        return -1;
+    }
 
-        generate(res.value()->decls, true);
+    if(incremental) {
+        if(!use_cache) {
+            std::cout << "error: '-fincremental' requires the compilation cache\n";
+            return -1;
+        }
+
+        if(options.output_kind != Output_Kind::object || options.lto != LTO_Mode::none || output_path == "-") {
+            std::cout << "error: '-fincremental' only writes archives of object files\n";
+            return -1;
+        }
+
+        // Units that are taken from the cache report no remarks.
+        if(options.remarks.enabled()) {
+            std::cout << "error: '-fincremental' cannot report optimization remarks\n";
+            return -1;
+        }
+    }
+
+    // The description of the options is the same for all files and requires a target machine, so that
+    // it is only computed when the cache is actually used. Files are compiled without the cache when
+    // remarks are requested, which the output taken from the cache would not report.
+    std::optional<Compilation_Cache> cache;
+    std::string compiler_identity;
+    std::string options_description;
+    if(use_cache && output_path != "-" && !options.remarks.enabled()) {
+        anton::Expected<std::string, std::string> description = describe_output_options(options);
+        if(!description) {
+            std::cout << "error: " << description.error() << '\n';
+            return -1;
+        }
+
+        cache.emplace(cache_directory, cache_size);
+        compiler_identity = get_compiler_identity(argv[0]);
+        options_description = std::move(description.value());
+    }
+
+    for(std::string_view const path: input_files) {
+        std::filesystem::path output = output_path.size() != 0 ? std::filesystem::path(output_path) : make_output_path(path, options.output_kind);
+        // The objects of the units are linked from an archive, `file.a` by default.
+        if(incremental && output_path.size() == 0) {
+            output.replace_extension(".a");
+        }
+
+        if(time_trace) {
+            start_time_trace(time_trace_granularity, argv[0]);
+        }
+
+        bool const compiled = incremental ? compile_incremental(path, output, options, *cache, compiler_identity, options_description)
+                                          : compile_file(path, output, options, cache ? &*cache : nullptr, compiler_identity, options_description, cache_hard_link);
+        if(time_trace && !write_time_trace(make_time_trace_path(path, output))) {
+            return -1;
+        }
+
+        if(!compiled) {
+            return -1;
+        }
     }
+    print_time_report();
+    print_memory_report();
     return 0;
 }
@@ -0,0 +1,301 @@
+#include <tildac/memory_report.hpp>
+
+#include <tildac/ast.hpp>
+
+#include <llvm/IR/Function.h>
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <sys/resource.h>
+#endif
+
+namespace tildac {
+    constexpr i64 ast_node_type_count = static_cast<i64>(AST_Node_Type::function_declaration) + 1;
+
+    struct Node_Statistics {
+        i64 count = 0;
+        i64 bytes = 0;
+    };
+
+    struct Phase_Memory {
+        std::string name;
+        i64 occurrences = 0;
+        // Summed up over all occurrences.
+        i64 peak_growth = 0;
+        // At the end of the last occurrence.
+        i64 peak = 0;
+    };
+
+    struct Module_Size {
+        i64 modules = 0;
+        i64 functions = 0;
+        i64 blocks = 0;
+        i64 instructions = 0;
+    };
+
+    struct Memory_Report {
+        // Every node that has been allocated, including those that the parser discarded when it backtracked.
+        std::array<Node_Statistics, ast_node_type_count> nodes;
+        // The sizes of the nodes from their allocation until their constructor attributes them to a type.
+        std::unordered_map<void const*, i64> unattributed_nodes;
+        i64 live_node_bytes = 0;
+        i64 peak_node_bytes = 0;
+        i64 strings = 0;
+        i64 string_characters = 0;
+        i64 string_heap_bytes = 0;
+        // In the order in which the phases first ran.
+        std::vector<Phase_Memory> phases;
+        std::array<Module_Size, 2> modules;
+    };
+
+    static std::unique_ptr<Memory_Report> memory_report;
+
+    void* AST_Node::operator new(std::size_t const size) {
+        void* const pointer = ::operator new(size);
+        if(memory_report) {
+            memory_report->unattributed_nodes.emplace(pointer, static_cast<i64>(size));
+            memory_report->live_node_bytes += static_cast<i64>(size);
+            memory_report->peak_node_bytes = max(memory_report->peak_node_bytes, memory_report->live_node_bytes);
+        }
+        return pointer;
+    }
+
+    void AST_Node::operator delete(void* const pointer, std::size_t const size) {
+        if(memory_report) {
+            memory_report->live_node_bytes -= static_cast<i64>(size);
+        }
+        ::operator delete(pointer);
+    }
+
+    void count_ast_node(AST_Node const& node) {
+        if(!memory_report) {
+            return;
+        }
+
+        // Nodes derive from AST_Node alone, hence the node starts at the address of its allocation.
+        auto const allocation = memory_report->unattributed_nodes.find(&node);
+        if(allocation == memory_report->unattributed_nodes.end()) {
+            return;
+        }
+
+        Node_Statistics& statistics = memory_report->nodes[static_cast<u64>(node.node_type)];
+        statistics.count += 1;
+        statistics.bytes += allocation->second;
+        memory_report->unattributed_nodes.erase(allocation);
+    }
+
+    // Strings short enough for the buffer inside of the string object allocate nothing.
+    static i64 get_heap_bytes(std::string const& string) {
+        char const* const object = reinterpret_cast<char const*>(&string);
+        std::less<char const*> const less;
+        bool const is_inline = !less(string.data(), object) && less(string.data(), object + sizeof(string));
+        return is_inline ? 0 : static_cast<i64>(string.capacity()) + 1;
+    }
+
+    void count_ast_string(std::string const& string) {
+        if(!memory_report) {
+            return;
+        }
+
+        memory_report->strings += 1;
+        memory_report->string_characters += static_cast<i64>(string.size());
+        memory_report->string_heap_bytes += get_heap_bytes(string);
+    }
+
+    void enable_memory_report() {
+        memory_report = std::make_unique<Memory_Report>();
+    }
+
+    bool memory_report_enabled() {
+        return memory_report != nullptr;
+    }
+
+    i64 get_peak_resident_set() {
+#if defined(__unix__) || defined(__APPLE__)
+        rusage usage;
+        if(getrusage(RUSAGE_SELF, &usage) != 0) {
+            return 0;
+        }
+    #if defined(__APPLE__)
+        return static_cast<i64>(usage.ru_maxrss);
+    #else
+        // Linux and the BSDs report kilobytes.
+        return static_cast<i64>(usage.ru_maxrss) * 1024;
+    #endif
+#else
+        return 0;
+#endif
+    }
+
+    void record_phase_memory(std::string_view const phase, i64 const peak_at_begin) {
+        if(!memory_report) {
+            return;
+        }
+
+        std::vector<Phase_Memory>& phases = memory_report->phases;
+        auto iterator = std::find_if(phases.begin(), phases.end(), [phase](const Phase_Memory& entry) { return entry.name == phase; });
+        if(iterator == phases.end()) {
+            iterator = phases.insert(phases.end(), Phase_Memory{std::string(phase)});
+        }
+
+        i64 const peak = get_peak_resident_set();
+        iterator->occurrences += 1;
+        iterator->peak_growth += peak - peak_at_begin;
+        iterator->peak = peak;
+    }
+
+    void record_module_size(Module_Stage const stage, const llvm::Module& module) {
+        if(!memory_report) {
+            return;
+        }
+
+        Module_Size& size = memory_report->modules[static_cast<u64>(stage)];
+        size.modules += 1;
+        for(const llvm::Function& function: module) {
+            if(function.isDeclaration()) {
+                continue;
+            }
+
+            size.functions += 1;
+            for(const llvm::BasicBlock& block: function) {
+                size.blocks += 1;
+                size.instructions += static_cast<i64>(block.size());
+            }
+        }
+    }
+
+    static std::string_view get_node_type_name(AST_Node_Type const type) {
+        switch(type) {
+            case AST_Node_Type::identifier:
+                return "identifier";
+            case AST_Node_Type::attribute:
+                return "attribute";
+            case AST_Node_Type::attribute_list:
+                return "attribute_list";
+            case AST_Node_Type::qualified_type:
+                return "qualified_type";
+            case AST_Node_Type::template_id:
+                return "template_id";
+            case AST_Node_Type::array_type:
+                return "array_type";
+            case AST_Node_Type::template_parameter_list:
+                return "template_parameter_list";
+            case AST_Node_Type::template_argument_list:
+                return "template_argument_list";
+            case AST_Node_Type::identifier_expression:
+                return "identifier_expression";
+            case AST_Node_Type::binary_expression:
+                return "binary_expression";
+            case AST_Node_Type::index_expression:
+                return "index_expression";
+            case AST_Node_Type::assignment_expression:
+                return "assignment_expression";
+            case AST_Node_Type::argument_list:
+                return "argument_list";
+            case AST_Node_Type::function_call_expression:
+                return "function_call_expression";
+            case AST_Node_Type::bool_literal:
+                return "bool_literal";
+            case AST_Node_Type::integer_literal:
+                return "integer_literal";
+            case AST_Node_Type::float_literal:
+                return "float_literal";
+            case AST_Node_Type::array_literal:
+                return "array_literal";
+            case AST_Node_Type::declaration_sequence:
+                return "declaration_sequence";
+            case AST_Node_Type::variable_declaration:
+                return "variable_declaration";
+            case AST_Node_Type::statement_list:
+                return "statement_list";
+            case AST_Node_Type::block_statement:
+                return "block_statement";
+            case AST_Node_Type::if_statement:
+                return "if_statement";
+            case AST_Node_Type::for_statement:
+                return "for_statement";
+            case AST_Node_Type::while_statement:
+                return "while_statement";
+            case AST_Node_Type::do_while_statement:
+                return "do_while_statement";
+            case AST_Node_Type::return_statement:
+                return "return_statement";
+            case AST_Node_Type::declaration_statement:
+                // Function parameters carry the node type of declaration statements.
+                return "declaration_statement";
+            case AST_Node_Type::expression_statement:
+                return "expression_statement";
+            case AST_Node_Type::function_parameter:
+                return "function_parameter";
+            case AST_Node_Type::function_parameter_list:
+                return "function_parameter_list";
+            case AST_Node_Type::function_body:
+                return "function_body";
+            case AST_Node_Type::function_declaration:
+                return "function_declaration";
+        }
+        return "";
+    }
+
+    void print_memory_report() {
+        if(!memory_report) {
+            return;
+        }
+
+        const Memory_Report& report = *memory_report;
+        std::ostream& out = std::cerr;
+        out << "===-------------------------------------------------------------------------===\n";
+        out << "                              Memory usage report\n";
+        out << "===-------------------------------------------------------------------------===\n";
+
+        out << "\n  " << std::left << std::setw(28) << "AST node type" << std::right << std::setw(12) << "Nodes" << std::setw(14) << "Bytes" << '\n';
+        Node_Statistics total;
+        for(i64 type = 0; type < ast_node_type_count; ++type) {
+            const Node_Statistics& statistics = report.nodes[static_cast<u64>(type)];
+            if(statistics.count == 0) {
+                continue;
+            }
+
+            total.count += statistics.count;
+            total.bytes += statistics.bytes;
+            out << "  " << std::left << std::setw(28) << get_node_type_name(static_cast<AST_Node_Type>(type)) << std::right << std::setw(12)
+                << statistics.count << std::setw(14) << statistics.bytes << '\n';
+        }
+        out << "  " << std::left << std::setw(28) << "Total" << std::right << std::setw(12) << total.count << std::setw(14) << total.bytes << '\n';
+        out << "  " << std::left << std::setw(40) << "Peak of the live nodes" << std::right << std::setw(14) << report.peak_node_bytes << '\n';
+
+        out << "\n  " << std::left << std::setw(40) << "Strings in the AST" << std::right << std::setw(14) << report.strings << '\n';
+        out << "  " << std::left << std::setw(40) << "Characters" << std::right << std::setw(14) << report.string_characters << '\n';
+        out << "  " << std::left << std::setw(40) << "Bytes allocated" << std::right << std::setw(14) << report.string_heap_bytes << '\n';
+
+        out << "\n  " << std::left << std::setw(28) << "Phase" << std::right << std::setw(12) << "Runs" << std::setw(14) << "Peak growth"
+            << std::setw(14) << "Peak RSS" << '\n';
+        for(const Phase_Memory& phase: report.phases) {
+            out << "  " << std::left << std::setw(28) << phase.name << std::right << std::setw(12) << phase.occurrences << std::setw(14)
+                << phase.peak_growth << std::setw(14) << phase.peak << '\n';
+        }
+
+        const Module_Size& generated = report.modules[static_cast<u64>(Module_Stage::generated)];
+        const Module_Size& optimized = report.modules[static_cast<u64>(Module_Stage::optimized)];
+        out << "\n  " << std::left << std::setw(28) << "LLVM modules" << std::right << std::setw(12) << "Generated" << std::setw(14) << "Optimized"
+            << '\n';
+        out << "  " << std::left << std::setw(28) << "Modules" << std::right << std::setw(12) << generated.modules << std::setw(14) << optimized.modules
+            << '\n';
+        out << "  " << std::left << std::setw(28) << "Functions" << std::right << std::setw(12) << generated.functions << std::setw(14)
+            << optimized.functions << '\n';
+        out << "  " << std::left << std::setw(28) << "Basic blocks" << std::right << std::setw(12) << generated.blocks << std::setw(14) << optimized.blocks
+            << '\n';
+        out << "  " << std::left << std::setw(28) << "Instructions" << std::right << std::setw(12) << generated.instructions << std::setw(14)
+            << optimized.instructions << '\n';
+        memory_report.reset();
+    }
+} // namespace tildac
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <tildac/types.hpp>
+
+#include <llvm/IR/Module.h>
+
+#include <string_view>
+
+namespace tildac {
+    // Counts the nodes and the strings of the syntax trees as they are allocated, the growth of the peak
+    // resident set during every phase and the size of the modules.
+    void enable_memory_report();
+    [[nodiscard]] bool memory_report_enabled();
+    // Prints the counts to stderr and disables the report.
+    void print_memory_report();
+
+    // The peak resident set size of the process in bytes. 0 where the platform does not report it.
+    [[nodiscard]] i64 get_peak_resident_set();
+    // Records that the peak resident set was peak_at_begin when the phase began. Phases that are entered
+    // several times are summed up.
+    void record_phase_memory(std::string_view phase, i64 peak_at_begin);
+
+    enum struct Module_Stage {
+        // As lowered from the syntax tree.
+        generated,
+        optimized,
+    };
+
+    // Adds the functions, basic blocks and instructions of the module to those of the stage.
+    void record_module_size(Module_Stage stage, const llvm::Module& module);
+} // namespace tildac
@@ -2,10 +2,12 @@
 
 #include <tildac/ast.hpp>
 #include <tildac/ast_printing.hpp>
+#include <tildac/timing.hpp>
 #include <tildac/types.hpp>
 #include <tildac/utility.hpp>
 
 #include <fstream>
+#include <sstream>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -29,6 +31,8 @@ namespace tildac {
     static constexpr std::string_view kw_var = "var";
     static constexpr std::string_view kw_true = "true";
     static constexpr std::string_view kw_false = "false";
+    static constexpr std::string_view kw_template = "template";
+    static constexpr std::string_view kw_typename = "typename";
     // builtin types
     static constexpr std::string_view token_void = "void";
     static constexpr std::string_view token_bool = "bool";
@@ -76,6 +80,7 @@ namespace tildac {
     static constexpr std::string_view token_bit_rshift = ">>";
     static constexpr std::string_view token_equal = "==";
     static constexpr std::string_view token_not_equal = "!=";
+    static constexpr std::string_view token_attribute_open = "#[";
     static constexpr std::string_view token_less = "<";
     static constexpr std::string_view token_greater = ">";
     static constexpr std::string_view token_less_equal = "<=";
@@ -246,7 +251,7 @@ namespace tildac {
 
     class Parser {
     public:
-        Parser(std::istream& stream): _lexer(stream) {}
+        Parser(std::istream& stream, std::string_view filename): _lexer(stream), _filename(filename) {}
 
         anton::Expected<Owning_Ptr<Declaration_Sequence>, Parse_Error> build_ast() {
             Owning_Ptr decls = new Declaration_Sequence();
@@ -285,21 +290,137 @@ namespace tildac {
         }
 
         Source_Info src_info(Lexer_State const& state) {
-            return Source_Info{_filename, state.line, state.column, state.stream_offset};
+            return Source_Info{_filename, state.stream_offset, state.line, state.column};
         }
 
+        // Parses a declaration optionally preceded by an attribute list, e.g. `#[xray_always] fn ...`.
+        // Only functions take attributes.
         Declaration* try_declaration() {
-            if(Variable_Declaration* variable_declaration = try_variable_declaration(); variable_declaration) {
-                return variable_declaration;
+            Lexer_State const state_backup = _lexer.get_current_state();
+            Owning_Ptr<Attribute_List> attributes = nullptr;
+            if(_lexer.match(token_attribute_open)) {
+                attributes = try_attribute_list();
+                if(!attributes) {
+                    _lexer.restore_state(state_backup);
+                    return nullptr;
+                }
+            }
+
+            // The template parameter list is optional, but if the `template` keyword is present,
+            // the list must be well-formed.
+            Owning_Ptr<Template_Parameter_List> template_parameters = nullptr;
+            if(_lexer.match(kw_template, true)) {
+                template_parameters = try_template_parameter_list();
+                if(!template_parameters) {
+                    _lexer.restore_state(state_backup);
+                    return nullptr;
+                }
+            }
+
+            if(!attributes) {
+                if(Variable_Declaration* variable_declaration = try_variable_declaration(); variable_declaration) {
+                    variable_declaration->template_parameters = std::move(template_parameters);
+                    return variable_declaration;
+                }
             }
 
             if(Function_Declaration* function_declaration = try_function_declaration(); function_declaration) {
+                function_declaration->template_parameters = std::move(template_parameters);
+                function_declaration->attributes = std::move(attributes);
                 return function_declaration;
             }
 
+            if(attributes) {
+                set_error("Expected a function after the attribute list.");
+            }
+
+            _lexer.restore_state(state_backup);
             return nullptr;
         }
 
+        Template_Parameter_List* try_template_parameter_list() {
+            Lexer_State const state_backup = _lexer.get_current_state();
+            if(!_lexer.match(token_angle_open)) {
+                set_error("Expected `<` after `template`.");
+                _lexer.restore_state(state_backup);
+                return nullptr;
+            }
+
+            Owning_Ptr parameters = new Template_Parameter_List;
+            do {
+                if(!_lexer.match(kw_typename, true)) {
+                    set_error("Expected `typename`.");
+                    _lexer.restore_state(state_backup);
+                    return nullptr;
+                }
+
+                if(std::string name; _lexer.match_identifier(name)) {
+                    parameters->append(new Identifier(std::move(name)));
+                } else {
+                    set_error("Expected template parameter name.");
+                    _lexer.restore_state(state_backup);
+                    return nullptr;
+                }
+            } while(_lexer.match(token_comma));
+
+            if(!_lexer.match(token_angle_close)) {
+                set_error("Expected `>` after template parameter list.");
+                _lexer.restore_state(state_backup);
+                return nullptr;
+            }
+
+            return parameters.release();
+        }
+
+        // Whether the next token may follow a template argument list in an expression. The language has
+        // no unary operators, so none of these tokens can continue a comparison as in `a < b, c > d`.
+        bool is_template_argument_list_follower() {
+            static constexpr std::string_view followers[] = {
+                token_paren_open, token_paren_close, token_comma,     token_semicolon, token_bracket_close, token_brace_open,
+                token_equal,      token_not_equal,   token_logic_and, token_logic_or,  token_plus,          token_minus,
+                token_multiply,   token_divide,      token_assign,
+            };
+
+            Lexer_State const state_backup = _lexer.get_current_state();
+            for(std::string_view const follower: followers) {
+                if(_lexer.match(follower)) {
+                    _lexer.restore_state(state_backup);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Does not report errors since template argument lists are always optional
+        // and a failed match is not necessarily an error (e.g. `a < b`).
+        // A list that is not followed by one of the followers above is a comparison, unless it is
+        // written explicitly as `f::<T>`.
+        Template_Argument_List* try_template_argument_list() {
+            Lexer_State const state_backup = _lexer.get_current_state();
+            bool const is_explicit = _lexer.match(token_scope_resolution);
+            if(!_lexer.match(token_angle_open)) {
+                _lexer.restore_state(state_backup);
+                return nullptr;
+            }
+
+            Owning_Ptr arguments = new Template_Argument_List;
+            do {
+                if(Type* type = try_type()) {
+                    arguments->append(type);
+                } else {
+                    _lexer.restore_state(state_backup);
+                    return nullptr;
+                }
+            } while(_lexer.match(token_comma));
+
+            if(!_lexer.match(token_angle_close) || (!is_explicit && !is_template_argument_list_follower())) {
+                _lexer.restore_state(state_backup);
+                return nullptr;
+            }
+
+            return arguments.release();
+        }
+
         Variable_Declaration* try_variable_declaration() {
             Lexer_State const state_backup = _lexer.get_current_state();
             if(!_lexer.match(kw_var)) {
@@ -308,6 +429,8 @@ namespace tildac {
                 return nullptr;
             }
 
+            bool const is_mutable = _lexer.match(kw_mut, true);
+
             Owning_Ptr<Identifier> var_name = nullptr;
             if(std::string identifier; _lexer.match_identifier(identifier)) {
                 var_name = new Identifier(std::move(identifier));
@@ -345,7 +468,7 @@ namespace tildac {
                 return nullptr;
             }
 
-            return new Variable_Declaration(var_type.release(), var_name.release(), initializer.release());
+            return new Variable_Declaration(var_type.release(), var_name.release(), initializer.release(), is_mutable, src_info(state_backup));
         }
 
         Function_Declaration* try_function_declaration() {
@@ -384,13 +507,18 @@ namespace tildac {
                 return nullptr;
             }
 
+            // A declaration without a body refers to a function defined later or in another file.
+            if(_lexer.match(token_semicolon)) {
+                return new Function_Declaration(name.release(), param_list.release(), return_type.release(), nullptr, src_info(state_backup));
+            }
+
             Owning_Ptr function_body = try_function_body();
             if(!function_body) {
                 _lexer.restore_state(state_backup);
                 return nullptr;
             }
 
-            return new Function_Declaration(name.release(), param_list.release(), return_type.release(), function_body.release());
+            return new Function_Declaration(name.release(), param_list.release(), return_type.release(), function_body.release(), src_info(state_backup));
         }
 
         Function_Parameter* try_function_parameter() {
@@ -417,7 +545,7 @@ namespace tildac {
                 return nullptr;
             }
 
-            return new Function_Parameter(identifier.release(), parameter_type.release());
+            return new Function_Parameter(identifier.release(), parameter_type.release(), src_info(state_backup));
         }
 
         Function_Parameter_List* try_function_parameter_list() {
@@ -491,23 +619,13 @@ namespace tildac {
                     continue;
                 }
 
-                if(For_Statement* for_statement = try_for_statement()) {
-                    statements->append(for_statement);
-                    continue;
-                }
-
-                if(While_Statement* while_statement = try_while_statement()) {
-                    statements->append(while_statement);
-                    continue;
-                }
-
-                if(Do_While_Statement* do_while_statement = try_do_while_statement()) {
-                    statements->append(do_while_statement);
+                if(Statement* loop_statement = try_loop_statement()) {
+                    statements->append(loop_statement);
                     continue;
                 }
 
                 if(Variable_Declaration* decl = try_variable_declaration()) {
-                    Declaration_Statement* decl_stmt = new Declaration_Statement(decl);
+                    Declaration_Statement* decl_stmt = new Declaration_Statement(decl, decl->source_info);
                     statements->append(decl_stmt);
                     continue;
                 }
@@ -527,13 +645,50 @@ namespace tildac {
         }
 
         Type* try_type() {
+            Lexer_State const state_backup = _lexer.get_current_state();
+            Owning_Ptr<Type> type = nullptr;
             if(Template_ID* template_id = try_template_id()) {
-                return template_id;
+                type = template_id;
             } else if(Qualified_Type* qualified_type = try_qualified_type()) {
-                return qualified_type;
+                type = qualified_type;
             } else {
                 return nullptr;
             }
+
+            // `T[4]` or `T[]`. The brackets apply from left to right.
+            while(_lexer.match(token_bracket_open)) {
+                i64 size = -1;
+                if(!_lexer.match(token_bracket_close)) {
+                    if(!try_array_size(size)) {
+                        _lexer.restore_state(state_backup);
+                        return nullptr;
+                    }
+
+                    if(!_lexer.match(token_bracket_close)) {
+                        set_error("Expected `]`.");
+                        _lexer.restore_state(state_backup);
+                        return nullptr;
+                    }
+                }
+                type = new Array_Type(type.release(), size);
+            }
+            return type.release();
+        }
+
+        bool try_array_size(i64& out) {
+            _lexer.ignore_whitespace_and_comments();
+            std::string digits;
+            while(is_digit(_lexer.peek_next())) {
+                digits += _lexer.get_next();
+            }
+
+            // Leaves the sizes that do not fit in i64 out.
+            if(digits.size() == 0 || digits.size() > 18) {
+                set_error("Expected the size of the array.");
+                return false;
+            }
+            out = std::stoll(digits);
+            return true;
         }
 
         Template_ID* try_template_id() {
@@ -575,6 +730,10 @@ namespace tildac {
 
         Qualified_Type* try_qualified_type() {
             if(std::string name; _lexer.match_identifier(name)) {
+                // Pointers are spelled as part of the type name, e.g. `c8**` for argv.
+                while(_lexer.match(token_multiply)) {
+                    name += '*';
+                }
                 return new Qualified_Type(name);
             } else {
                 set_error("Expected identifier.");
@@ -591,7 +750,7 @@ namespace tildac {
             }
 
             if(_lexer.match(token_brace_close)) {
-                return new Block_Statement(new Statement_List());
+                return new Block_Statement(new Statement_List(), src_info(state_backup));
             }
 
             Owning_Ptr statements = try_statement_list();
@@ -606,7 +765,7 @@ namespace tildac {
                 return nullptr;
             }
 
-            return new Block_Statement(statements.release());
+            return new Block_Statement(statements.release(), src_info(state_backup));
         }
 
         If_Statement* try_if_statement() {
@@ -631,17 +790,113 @@ namespace tildac {
 
             if(_lexer.match(kw_else, true)) {
                 if(Owning_Ptr else_if = try_if_statement()) {
-                    return new If_Statement(condition.release(), block.release(), nullptr, else_if.release());
+                    return new If_Statement(condition.release(), block.release(), nullptr, else_if.release(), src_info(state_backup));
                 } else if(Owning_Ptr else_block = try_block_statement()) {
-                    return new If_Statement(condition.release(), block.release(), else_block.release(), nullptr);
+                    return new If_Statement(condition.release(), block.release(), else_block.release(), nullptr, src_info(state_backup));
                 } else {
                     set_error("expected 'if' keyword or '{' token after 'else'");
                     _lexer.restore_state(state_backup);
                     return nullptr;
                 }
             } else {
-                return new If_Statement(condition.release(), block.release(), nullptr, nullptr);
+                return new If_Statement(condition.release(), block.release(), nullptr, nullptr, src_info(state_backup));
+            }
+        }
+
+        // Parses a loop optionally preceded by an attribute list, e.g. `#[unroll(4)] for ...`.
+        Statement* try_loop_statement() {
+            Lexer_State const state_backup = _lexer.get_current_state();
+            Owning_Ptr<Attribute_List> attributes = nullptr;
+            if(_lexer.match(token_attribute_open)) {
+                attributes = try_attribute_list();
+                if(!attributes) {
+                    _lexer.restore_state(state_backup);
+                    return nullptr;
+                }
+            }
+
+            if(For_Statement* for_statement = try_for_statement()) {
+                for_statement->attributes = std::move(attributes);
+                return for_statement;
+            }
+
+            if(While_Statement* while_statement = try_while_statement()) {
+                while_statement->attributes = std::move(attributes);
+                return while_statement;
+            }
+
+            if(Do_While_Statement* do_while_statement = try_do_while_statement()) {
+                do_while_statement->attributes = std::move(attributes);
+                return do_while_statement;
             }
+
+            if(attributes) {
+                set_error("Expected a loop after the attribute list.");
+            }
+            _lexer.restore_state(state_backup);
+            return nullptr;
+        }
+
+        // Parses the remainder of `#[name, name(value), name(key=value, ...)]` after `#[`.
+        Attribute_List* try_attribute_list() {
+            Owning_Ptr attributes = new Attribute_List;
+            do {
+                std::string name;
+                if(!_lexer.match_identifier(name)) {
+                    set_error("Expected attribute name.");
+                    return nullptr;
+                }
+
+                Owning_Ptr attribute = new Attribute(std::move(name));
+                if(_lexer.match(token_paren_open)) {
+                    do {
+                        Attribute_Argument argument;
+                        if(!try_attribute_value(argument.value)) {
+                            set_error("Expected attribute argument.");
+                            return nullptr;
+                        }
+
+                        if(_lexer.match(token_assign)) {
+                            argument.key = std::move(argument.value);
+                            argument.value.clear();
+                            if(!try_attribute_value(argument.value)) {
+                                set_error("Expected attribute argument value after `=`.");
+                                return nullptr;
+                            }
+                        }
+
+                        count_ast_string(argument.key);
+                        count_ast_string(argument.value);
+                        attribute->arguments.push_back(std::move(argument));
+                    } while(_lexer.match(token_comma));
+
+                    if(!_lexer.match(token_paren_close)) {
+                        set_error("Expected `)` after attribute arguments.");
+                        return nullptr;
+                    }
+                }
+
+                attributes->append(attribute.release());
+            } while(_lexer.match(token_comma));
+
+            if(!_lexer.match(token_bracket_close)) {
+                set_error("Expected `]` at the end of the attribute list.");
+                return nullptr;
+            }
+
+            return attributes.release();
+        }
+
+        // Attribute values are either identifiers or unsigned integers.
+        bool try_attribute_value(std::string& out) {
+            if(_lexer.match_identifier(out)) {
+                return true;
+            }
+
+            while(is_digit(_lexer.peek_next())) {
+                out += _lexer.get_next();
+            }
+            return out.size() != 0;
         }
 
         For_Statement* try_for_statement() {
@@ -652,10 +907,20 @@ namespace tildac {
                 return nullptr;
             }
 
-            if(!_lexer.match(token_semicolon)) {
-                set_error(u8"expected ';'");
-                _lexer.restore_state(state_backup);
-                return nullptr;
+            // The init statement is a variable declaration (which consumes the `;`) or an optional expression.
+            Owning_Ptr<Statement> init = nullptr;
+            if(Variable_Declaration* decl = try_variable_declaration()) {
+                init = new Declaration_Statement(decl, decl->source_info);
+            } else {
+                if(Expression* expression = try_expression()) {
+                    init = new Expression_Statement(expression, expression->source_info);
+                }
+
+                if(!_lexer.match(token_semicolon)) {
+                    set_error(u8"expected ';'");
+                    _lexer.restore_state(state_backup);
+                    return nullptr;
+                }
             }
 
             Owning_Ptr condition = try_expression();
@@ -682,7 +947,7 @@ namespace tildac {
                 return nullptr;
             }
 
-            return new For_Statement(condition.release(), post_expr.release(), statements.release(), src_info(state_backup));
+            return new For_Statement(init.release(), condition.release(), post_expr.release(), statements.release(), src_info(state_backup));
         }
 
         While_Statement* try_while_statement() {
@@ -705,7 +970,7 @@ namespace tildac {
                 return nullptr;
             }
 
-            return new While_Statement(condition.release(), block.release());
+            return new While_Statement(condition.release(), block.release(), src_info(state_backup));
         }
 
         Do_While_Statement* try_do_while_statement() {
@@ -740,7 +1005,7 @@ namespace tildac {
                 return nullptr;
             }
 
-            return new Do_While_Statement(condition.release(), block.release());
+            return new Do_While_Statement(condition.release(), block.release(), src_info(state_backup));
         }
 
         Return_Statement* try_return_statement() {
@@ -762,7 +1027,7 @@ namespace tildac {
                 return nullptr;
             }
 
-            return new Return_Statement(expression.release());
+            return new Return_Statement(expression.release(), src_info(state_backup));
         }
 
         Expression_Statement* try_expression_statement() {
@@ -779,10 +1044,14 @@ namespace tildac {
                 return nullptr;
             }
 
-            return new Expression_Statement(expression.release());
+            return new Expression_Statement(expression.release(), src_info(state_backup));
         }
 
         Expression* try_expression() {
+            if(Assignment_Expression* assignment = try_assignment_expression()) {
+                return assignment;
+            }
+
             if(auto* boolean_or = try_boolean_or_expression()) {
                 return boolean_or;
             }
@@ -798,6 +1067,69 @@ namespace tildac {
             return nullptr;
         }
 
+        Assignment_Expression* try_assignment_expression() {
+            Lexer_State const state_backup = _lexer.get_current_state();
+            Owning_Ptr<Identifier> identifier = nullptr;
+            if(std::string name; _lexer.match_identifier(name)) {
+                identifier = new Identifier(std::move(name));
+            } else {
+                set_error("Expected an identifier.");
+                _lexer.restore_state(state_backup);
+                return nullptr;
+            }
+
+            // `a[i][j] = value` assigns an element of a.
+            Owning_Ptr<Index_Expression> element = nullptr;
+            while(true) {
+                Lexer_State const subscript_state = _lexer.get_current_state();
+                if(!_lexer.match(token_bracket_open)) {
+                    break;
+                }
+
+                Owning_Ptr index = try_expression();
+                if(!index || !_lexer.match(token_bracket_close)) {
+                    _lexer.restore_state(state_backup);
+                    return nullptr;
+                }
+
+                Expression* base = element.release();
+                if(!base) {
+                    base = new Identifier_Expression(new Identifier(identifier->name), nullptr, src_info(state_backup));
+                }
+                element = new Index_Expression(base, index.release(), src_info(subscript_state));
+            }
+
+            Operator op;
+            if(_lexer.match(token_compound_plus)) {
+                op = Operator::binary_add;
+            } else if(_lexer.match(token_compound_minus)) {
+                op = Operator::binary_sub;
+            } else if(_lexer.match(token_compound_multiply)) {
+                op = Operator::binary_mul;
+            } else if(_lexer.match(token_compound_divice)) {
+                op = Operator::binary_div;
+            } else if(_lexer.match(token_equal)) {
+                // `==` is a comparison, not an assignment.
+                _lexer.restore_state(state_backup);
+                return nullptr;
+            } else if(_lexer.match(token_assign)) {
+                op = Operator::assign;
+            } else {
+                _lexer.restore_state(state_backup);
+                return nullptr;
+            }
+
+            Owning_Ptr value = try_expression();
+            if(!value) {
+                _lexer.restore_state(state_backup);
+                return nullptr;
+            }
+
+            Assignment_Expression* assignment = new Assignment_Expression(identifier.release(), op, value.release(), src_info(state_backup));
+            assignment->element = element.release();
+            return assignment;
+        }
+
         Expression* try_boolean_or_expression() {
             Lexer_State const state_backup = _lexer.get_current_state();
             Owning_Ptr lhs = try_boolean_and_expression();
@@ -806,14 +1138,19 @@ namespace tildac {
                 return nullptr;
             }
 
-            while(_lexer.match(token_logic_or)) {
+            while(true) {
+                Lexer_State const operator_state = _lexer.get_current_state();
+                if(!_lexer.match(token_logic_or)) {
+                    break;
+                }
+
                 Owning_Ptr rhs = try_boolean_or_expression();
                 if(!rhs) {
                     _lexer.restore_state(state_backup);
                     return nullptr;
                 }
 
-                lhs = new Binary_Expression(lhs.release(), Operator::binary_or, rhs.release());
+                lhs = new Binary_Expression(lhs.release(), Operator::binary_or, rhs.release(), src_info(operator_state));
             }
             return lhs.release();
         }
@@ -826,19 +1163,54 @@ namespace tildac {
                 return nullptr;
             }
 
-            while(_lexer.match(token_logic_and)) {
+            while(true) {
+                Lexer_State const operator_state = _lexer.get_current_state();
+                if(!_lexer.match(token_logic_and)) {
+                    break;
+                }
+
                 Owning_Ptr rhs = try_boolean_and_expression();
                 if(!rhs) {
                     _lexer.restore_state(state_backup);
                     return nullptr;
                 }
 
-                lhs = new Binary_Expression(lhs.release(), Operator::binary_and, rhs.release());
+                lhs = new Binary_Expression(lhs.release(), Operator::binary_and, rhs.release(), src_info(operator_state));
             }
             return lhs.release();
         }
 
         Expression* try_equality_expression() {
+            Lexer_State const state_backup = _lexer.get_current_state();
+            Owning_Ptr lhs = try_relational_expression();
+            if(!lhs) {
+                _lexer.restore_state(state_backup);
+                return nullptr;
+            }
+
+            while(true) {
+                Lexer_State const operator_state = _lexer.get_current_state();
+                Operator op;
+                if(_lexer.match(token_equal)) {
+                    op = Operator::binary_eq;
+                } else if(_lexer.match(token_not_equal)) {
+                    op = Operator::binary_neq;
+                } else {
+                    break;
+                }
+
+                Owning_Ptr rhs = try_relational_expression();
+                if(!rhs) {
+                    _lexer.restore_state(state_backup);
+                    return nullptr;
+                }
+
+                lhs = new Binary_Expression(lhs.release(), op, rhs.release(), src_info(operator_state));
+            }
+            return lhs.release();
+        }
+
+        Expression* try_relational_expression() {
             Lexer_State const state_backup = _lexer.get_current_state();
             Owning_Ptr lhs = try_add_sub_expression();
             if(!lhs) {
@@ -846,14 +1218,32 @@ namespace tildac {
                 return nullptr;
             }
 
-            while(_lexer.match(token_equal)) {
-                Owning_Ptr rhs = try_equality_expression();
+            while(true) {
+                Lexer_State const operator_state = _lexer.get_current_state();
+                Operator op;
+                if(_lexer.match(token_less_equal)) {
+                    op = Operator::binary_leq;
+                } else if(_lexer.match(token_greater_equal)) {
+                    op = Operator::binary_geq;
+                } else if(_lexer.match(token_bit_lshift) || _lexer.match(token_bit_rshift)) {
+                    // Shifts are not supported yet. Do not mistake them for two comparisons.
+                    _lexer.restore_state(operator_state);
+                    break;
+                } else if(_lexer.match(token_less)) {
+                    op = Operator::binary_lt;
+                } else if(_lexer.match(token_greater)) {
+                    op = Operator::binary_gt;
+                } else {
+                    break;
+                }
+
+                Owning_Ptr rhs = try_add_sub_expression();
                 if(!rhs) {
                     _lexer.restore_state(state_backup);
                     return nullptr;
                 }
 
-                lhs = new Binary_Expression(lhs.release(), Operator::binary_eq, rhs.release());
+                lhs = new Binary_Expression(lhs.release(), op, rhs.release(), src_info(operator_state));
             }
             return lhs.release();
         }
@@ -866,40 +1256,91 @@ namespace tildac {
                 return nullptr;
             }
 
-            bool const is_add = _lexer.match(token_plus);
-            while(is_add || _lexer.match(token_minus)) {
-                Owning_Ptr rhs = try_add_sub_expression();
+            while(true) {
+                Lexer_State const operator_state = _lexer.get_current_state();
+                Operator op;
+                if(_lexer.match(token_plus)) {
+                    op = Operator::binary_add;
+                } else if(_lexer.match(token_minus)) {
+                    op = Operator::binary_sub;
+                } else {
+                    break;
+                }
+
+                // Parse only the next operand so that the operators associate to the left.
+                Owning_Ptr rhs = try_mul_div_expression();
                 if(!rhs) {
                     _lexer.restore_state(state_backup);
                     return nullptr;
                 }
 
-                lhs = new Binary_Expression(lhs.release(), is_add ? Operator::binary_add : Operator::binary_sub, rhs.release());
+                lhs = new Binary_Expression(lhs.release(), op, rhs.release(), src_info(operator_state));
             }
             return lhs.release();
         }
 
         Expression* try_mul_div_expression() {
             Lexer_State const state_backup = _lexer.get_current_state();
-            Owning_Ptr lhs = try_primary_expression();
+            Owning_Ptr lhs = try_postfix_expression();
             if(!lhs) {
                 _lexer.restore_state(state_backup);
                 return nullptr;
             }
 
-            bool const is_mul = _lexer.match(token_multiply);
-            while(is_mul || _lexer.match(token_divide)) {
-                Owning_Ptr rhs = try_mul_div_expression();
+            while(true) {
+                Lexer_State const operator_state = _lexer.get_current_state();
+                Operator op;
+                if(_lexer.match(token_multiply)) {
+                    op = Operator::binary_mul;
+                } else if(_lexer.match(token_divide)) {
+                    op = Operator::binary_div;
+                } else {
+                    break;
+                }
+
+                Owning_Ptr rhs = try_postfix_expression();
                 if(!rhs) {
                     _lexer.restore_state(state_backup);
                     return nullptr;
                 }
 
-                lhs = new Binary_Expression(lhs.release(), is_mul ? Operator::binary_mul : Operator::binary_div, rhs.release());
+                lhs = new Binary_Expression(lhs.release(), op, rhs.release(), src_info(operator_state));
             }
             return lhs.release();
         }
 
+        // An operand followed by any number of subscripts, e.g. `m[i][j]`.
+        Expression* try_postfix_expression() {
+            Lexer_State const state_backup = _lexer.get_current_state();
+            Owning_Ptr operand = try_primary_expression();
+            if(!operand) {
+                _lexer.restore_state(state_backup);
+                return nullptr;
+            }
+
+            while(true) {
+                Lexer_State const subscript_state = _lexer.get_current_state();
+                if(!_lexer.match(token_bracket_open)) {
+                    break;
+                }
+
+                Owning_Ptr index = try_expression();
+                if(!index) {
+                    _lexer.restore_state(state_backup);
+                    return nullptr;
+                }
+
+                if(!_lexer.match(token_bracket_close)) {
+                    set_error("Expected `]`.");
+                    _lexer.restore_state(state_backup);
+                    return nullptr;
+                }
+
+                operand = new Index_Expression(operand.release(), index.release(), src_info(subscript_state));
+            }
+            return operand.release();
+        }
+
         Expression* try_primary_expression() {
             Lexer_State const state_backup = _lexer.get_current_state();
             if(_lexer.match(token_paren_open)) {
@@ -918,10 +1359,18 @@ namespace tildac {
                 }
             }
 
+            if(Float_Literal* float_literal = try_float_literal()) {
+                return float_literal;
+            }
+
             if(Integer_Literal* integer_literal = try_integer_literal()) {
                 return integer_literal;
             }
 
+            if(Array_Literal* array_literal = try_array_literal()) {
+                return array_literal;
+            }
+
             if(Function_Call_Expression* function_call = try_function_call_expression()) {
                 return function_call;
             }
@@ -948,6 +1397,8 @@ namespace tildac {
                 return nullptr;
             }
 
+            Owning_Ptr template_arguments = try_template_argument_list();
+
             if(!_lexer.match(token_paren_open)) {
                 set_error("Expected `(` after function name.");
                 _lexer.restore_state(state_backup);
@@ -956,7 +1407,7 @@ namespace tildac {
 
             Owning_Ptr arg_list = new Argument_List;
             if(_lexer.match(token_paren_close)) {
-                return new Function_Call_Expression(identifier.release(), arg_list.release());
+                return new Function_Call_Expression(identifier.release(), template_arguments.release(), arg_list.release(), src_info(state_backup));
             }
 
             do {
@@ -974,7 +1425,33 @@ namespace tildac {
                 return nullptr;
             }
 
-            return new Function_Call_Expression(identifier.release(), arg_list.release());
+            return new Function_Call_Expression(identifier.release(), template_arguments.release(), arg_list.release(), src_info(state_backup));
+        }
+
+        Array_Literal* try_array_literal() {
+            Lexer_State const state_backup = _lexer.get_current_state();
+            if(!_lexer.match(token_bracket_open)) {
+                set_error("Expected `[`.");
+                return nullptr;
+            }
+
+            Owning_Ptr literal = new Array_Literal(src_info(state_backup));
+            do {
+                if(Expression* element = try_expression()) {
+                    literal->append(element);
+                } else {
+                    _lexer.restore_state(state_backup);
+                    return nullptr;
+                }
+            } while(_lexer.match(token_comma));
+
+            if(!_lexer.match(token_bracket_close)) {
+                set_error("Expected `]`.");
+                _lexer.restore_state(state_backup);
+                return nullptr;
+            }
+
+            return literal.release();
         }
 
         Integer_Literal* try_integer_literal() {
@@ -999,7 +1476,7 @@ namespace tildac {
             }
 
             if(length != 0) {
-                return new Integer_Literal(std::move(out));
+                return new Integer_Literal(std::move(out), src_info(state_backup));
             } else {
                 set_error("Expected more than 0 digits.");
                 _lexer.restore_state(state_backup);
@@ -1007,11 +1484,73 @@ namespace tildac {
             }
         }
 
+        // Digits with a fraction, an exponent or both, e.g. `1.5`, `2e8` or `0.25e-3`.
+        Float_Literal* try_float_literal() {
+            _lexer.ignore_whitespace_and_comments();
+
+            Lexer_State const state_backup = _lexer.get_current_state();
+
+            std::string out;
+            char32 next = _lexer.peek_next();
+            if(next == '-' || next == '+') {
+                out += next;
+                _lexer.get_next();
+            }
+
+            auto const match_digits = [this, &out]() {
+                i64 length = 0;
+                while(is_digit(_lexer.peek_next())) {
+                    out += _lexer.get_next();
+                    length += 1;
+                }
+                return length != 0;
+            };
+
+            if(!match_digits()) {
+                _lexer.restore_state(state_backup);
+                return nullptr;
+            }
+
+            bool has_fraction = false;
+            if(_lexer.peek_next() == '.') {
+                out += _lexer.get_next();
+                if(!match_digits()) {
+                    _lexer.restore_state(state_backup);
+                    return nullptr;
+                }
+                has_fraction = true;
+            }
+
+            bool has_exponent = false;
+            if(_lexer.peek_next() == 'e' || _lexer.peek_next() == 'E') {
+                Lexer_State const exponent_backup = _lexer.get_current_state();
+                std::string const mantissa = out;
+                out += _lexer.get_next();
+                if(_lexer.peek_next() == '-' || _lexer.peek_next() == '+') {
+                    out += _lexer.get_next();
+                }
+
+                has_exponent = match_digits();
+                if(!has_exponent) {
+                    // E.g. an identifier that follows the digits.
+                    _lexer.restore_state(exponent_backup);
+                    out = mantissa;
+                }
+            }
+
+            if(!has_fraction && !has_exponent) {
+                _lexer.restore_state(state_backup);
+                return nullptr;
+            }
+            return new Float_Literal(std::move(out), src_info(state_backup));
+        }
+
         Bool_Literal* try_bool_literal() {
+            Lexer_State const state = _lexer.get_current_state();
             if(_lexer.match(kw_true)) {
-                return new Bool_Literal(true);
+                return new Bool_Literal(true, src_info(state));
             } else if(_lexer.match(kw_false)) {
-                return new Bool_Literal(false);
+                return new Bool_Literal(false, src_info(state));
             } else {
                 set_error("Expected bool literal.");
                 return nullptr;
@@ -1019,9 +1558,11 @@ namespace tildac {
         }
 
         Identifier_Expression* try_identifier_expression() {
+            Lexer_State const state = _lexer.get_current_state();
             if(std::string name; _lexer.match_identifier(name)) {
                 Identifier* identifier = new Identifier(name);
-                return new Identifier_Expression(identifier);
+                Template_Argument_List* template_arguments = try_template_argument_list();
+                return new Identifier_Expression(identifier, template_arguments, src_info(state));
             } else {
                 set_error("Expected an identifer.");
                 return nullptr;
@@ -1030,14 +1571,24 @@ namespace tildac {
     };
 
     anton::Expected<Owning_Ptr<Declaration_Sequence>, Parse_Error> parse_file(std::string_view const path) {
-        std::string const path_str(path);
-        std::ifstream file(path_str);
-        if(!file) {
-            Parse_Error error{u8"Could not open for reading", 0, 0, 0};
-            return {anton::expected_error, anton::move(error)};
+        // The lexer backtracks a lot, which is cheaper on a buffer in memory than on the file.
+        std::stringstream source;
+        {
+            Time_Scope const scope("Read source", path);
+            std::string const path_str(path);
+            std::ifstream file(path_str);
+            if(!file) {
+                Parse_Error error{u8"Could not open for reading", 0, 0, 0};
+                return {anton::expected_error, anton::move(error)};
+            }
+            // Inserting an empty file fails the stream.
+            source << file.rdbuf();
+            source.clear();
         }
 
-        Parser parser(file);
+        // Tokens are lexed on demand, so lexing is timed as part of parsing.
+        Time_Scope const scope("Parse", path);
+        Parser parser(source, path);
         return parser.build_ast();
     }
 } // namespace tildac
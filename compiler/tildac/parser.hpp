@@ -3,7 +3,9 @@
 #include <anton/expected.hpp>
 #include <string>
 #include <string_view>
+#include <tildac/ast.hpp>
 #include <tildac/types.hpp>
+#include <tildac/utility.hpp>
 
 namespace tildac {
     struct Parse_Error {
@@ -13,5 +15,6 @@ namespace tildac {
         i64 file_offset;
     };
 
+    // The source info of the nodes refers to path, which must outlive the tree.
     anton::Expected<Owning_Ptr<Declaration_Sequence>, Parse_Error> parse_file(std::string_view path);
 } // namespace tildac
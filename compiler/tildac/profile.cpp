@@ -0,0 +1,53 @@
+#include <tildac/profile.hpp>
+
+#include <llvm/ProfileData/InstrProfReader.h>
+#include <llvm/ProfileData/InstrProfWriter.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+
+namespace tildac {
+    anton::Expected<i64, std::string> merge_profiles(const std::vector<std::string>& inputs, const std::string& output) {
+        llvm::InstrProfWriter writer;
+        i64 records = 0;
+        for(const std::string& input: inputs) {
+            llvm::Expected<std::unique_ptr<llvm::InstrProfReader>> reader = llvm::InstrProfReader::create(input);
+            if(!reader) {
+                return {anton::expected_error, input + ": " + llvm::toString(reader.takeError())};
+            }
+
+            // Profiles of the frontend and of the IR cannot be mixed.
+            if(llvm::Error error = writer.setIsIRLevelProfile(reader.get()->isIRLevelProfile(), reader.get()->hasCSIRLevelProfile())) {
+                return {anton::expected_error, input + ": " + llvm::toString(std::move(error))};
+            }
+
+            // A function whose hash differs from the one in an earlier profile was compiled from a different
+            // source. Its counts cannot be merged.
+            std::string mismatch;
+            for(llvm::NamedInstrProfRecord& record: *reader.get()) {
+                std::string const name = record.Name.str();
+                writer.addRecord(std::move(record), [&mismatch, &name](llvm::Error error) {
+                    llvm::consumeError(std::move(error));
+                    mismatch = name;
+                });
+                records += 1;
+            }
+
+            if(reader.get()->hasError()) {
+                return {anton::expected_error, input + ": " + llvm::toString(reader.get()->getError())};
+            }
+
+            if(!mismatch.empty()) {
+                return {anton::expected_error, input + ": the profile of \"" + mismatch + "\" does not match the other profiles"};
+            }
+        }
+
+        std::error_code error;
+        llvm::raw_fd_ostream file(output, error, llvm::sys::fs::OF_None);
+        if(error) {
+            return {anton::expected_error, "could not write '" + output + "': " + error.message()};
+        }
+        writer.write(file);
+        return {anton::expected_value, records};
+    }
+} // namespace tildac
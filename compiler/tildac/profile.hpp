@@ -0,0 +1,14 @@
+#pragma once
+
+#include <anton/expected.hpp>
+#include <tildac/types.hpp>
+
+#include <string>
+#include <vector>
+
+namespace tildac {
+    // Merges raw profiles written by programs compiled with -fprofile-generate, or indexed profiles,
+    // into the indexed profile that -fprofile-use reads. The counts of functions that occur in several
+    // profiles are added up. Returns the number of function profiles that were read.
+    [[nodiscard]] anton::Expected<i64, std::string> merge_profiles(const std::vector<std::string>& inputs, const std::string& output);
+} // namespace tildac
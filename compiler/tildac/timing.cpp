@@ -0,0 +1,134 @@
+#include <tildac/timing.hpp>
+
+#include <tildac/memory_report.hpp>
+
+#include <llvm/ADT/Any.h>
+#include <llvm/ADT/Statistic.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/PassTimingInfo.h>
+#include <llvm/Pass.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/TimeProfiler.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <memory>
+#include <unordered_map>
+
+namespace tildac {
+    // The timers of the phases are created on first use and live until the report is printed.
+    struct Time_Report {
+        llvm::TimerGroup phases{"tildac", "Compilation phase timing report"};
+        std::unordered_map<std::string, std::unique_ptr<llvm::Timer>> timers;
+        // Times the passes of the new pass manager. The legacy pass manager of the code generator
+        // times its passes by itself once llvm::TimePassesIsEnabled is set.
+        llvm::TimePassesHandler passes{true};
+    };
+
+    static std::unique_ptr<Time_Report> time_report;
+
+    Time_Scope::Time_Scope(std::string_view const name, std::string_view const detail): _name(name) {
+        if(memory_report_enabled()) {
+            _peak_at_begin = get_peak_resident_set();
+        }
+
+        if(llvm::timeTraceProfilerEnabled()) {
+            llvm::timeTraceProfilerBegin(llvm::StringRef(name.data(), name.size()), llvm::StringRef(detail.data(), detail.size()));
+            _traced = true;
+        }
+
+        if(time_report) {
+            std::unique_ptr<llvm::Timer>& timer = time_report->timers[std::string(name)];
+            if(!timer) {
+                timer = std::make_unique<llvm::Timer>(llvm::StringRef(name.data(), name.size()), llvm::StringRef(name.data(), name.size()),
+                                                      time_report->phases);
+            }
+            // A phase that is entered again while it runs is timed once, so that no time is counted twice.
+            if(!timer->isRunning()) {
+                _timer = timer.get();
+                _timer->startTimer();
+            }
+        }
+    }
+
+    Time_Scope::~Time_Scope() {
+        if(_timer) {
+            _timer->stopTimer();
+        }
+
+        if(_traced) {
+            llvm::timeTraceProfilerEnd();
+        }
+
+        if(_peak_at_begin >= 0) {
+            record_phase_memory(_name, _peak_at_begin);
+        }
+    }
+
+    void enable_time_report() {
+        llvm::TimePassesIsEnabled = true;
+        time_report = std::make_unique<Time_Report>();
+    }
+
+    void print_time_report() {
+        if(!time_report) {
+            return;
+        }
+
+        // The reports of the passes are printed to the info output of LLVM, which is stderr by default.
+        // Timers that have been printed are cleared, so that they are not printed again when destroyed.
+        time_report->phases.print(*llvm::CreateInfoOutputFile());
+        time_report->phases.clear();
+        // The handler prints the passes of the optimizer when it is destroyed.
+        time_report.reset();
+        llvm::reportAndResetTimings();
+        llvm::TimePassesIsEnabled = false;
+    }
+
+    void start_time_trace(i64 const granularity, std::string_view const process_name) {
+        llvm::timeTraceProfilerInitialize(static_cast<unsigned>(granularity), llvm::StringRef(process_name.data(), process_name.size()));
+    }
+
+    bool finish_time_trace(const std::filesystem::path& path, std::string& error) {
+        std::error_code error_code;
+        llvm::raw_fd_ostream output(path.string(), error_code, llvm::sys::fs::OF_Text);
+        if(!error_code) {
+            llvm::timeTraceProfilerWrite(output);
+            output.close();
+            error_code = output.error();
+        }
+        llvm::timeTraceProfilerCleanup();
+        if(error_code) {
+            error = error_code.message();
+            return false;
+        }
+        return true;
+    }
+
+    // Names the function or the module that a pass runs on. Passes over loops and call graph SCCs
+    // show up as the function or the module pass that runs them.
+    static std::string describe_ir_unit(const llvm::Any& ir) {
+        if(llvm::any_isa<const llvm::Function*>(ir)) {
+            return llvm::any_cast<const llvm::Function*>(ir)->getName().str();
+        } else if(llvm::any_isa<const llvm::Module*>(ir)) {
+            return llvm::any_cast<const llvm::Module*>(ir)->getModuleIdentifier();
+        } else {
+            return "";
+        }
+    }
+
+    void register_pass_timing(llvm::PassInstrumentationCallbacks& callbacks) {
+        if(time_report) {
+            time_report->passes.registerCallbacks(callbacks);
+        }
+
+        if(llvm::timeTraceProfilerEnabled()) {
+            callbacks.registerBeforePassCallback([](llvm::StringRef const pass, llvm::Any const ir) {
+                llvm::timeTraceProfilerBegin(pass, describe_ir_unit(ir));
+                return true;
+            });
+            callbacks.registerAfterPassCallback([](llvm::StringRef, llvm::Any) { llvm::timeTraceProfilerEnd(); });
+            callbacks.registerAfterPassInvalidatedCallback([](llvm::StringRef) { llvm::timeTraceProfilerEnd(); });
+        }
+    }
+} // namespace tildac
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <tildac/types.hpp>
+
+#include <llvm/IR/PassInstrumentation.h>
+#include <llvm/Support/Timer.h>
+
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+namespace tildac {
+    // Times a phase of the compilation for -ftime-report, records it as an event of the -ftime-trace
+    // trace and measures the growth of the peak resident set for -fmem-report. detail tells apart the events
+    // of a phase in the trace, e.g. the declarations that are lowered. name must outlive the scope.
+    // Does nothing unless a report or the trace are enabled. Scopes are opened by the thread that drives
+    // the compilation only.
+    class Time_Scope {
+    public:
+        Time_Scope(std::string_view name, std::string_view detail = {});
+        Time_Scope(const Time_Scope&) = delete;
+        Time_Scope& operator=(const Time_Scope&) = delete;
+        ~Time_Scope();
+
+    private:
+        std::string_view _name;
+        llvm::Timer* _timer = nullptr;
+        bool _traced = false;
+        // Negative unless the memory report is enabled.
+        i64 _peak_at_begin = -1;
+    };
+
+    // Times the phases and every pass of the optimizer and of the code generator.
+    void enable_time_report();
+    // Prints the times of the phases followed by those of the passes and disables the report.
+    void print_time_report();
+
+    // Starts recording the phases and the passes of the optimizer. Events shorter than granularity
+    // microseconds are left out of the trace.
+    void start_time_trace(i64 granularity, std::string_view process_name);
+    // Writes the events as Chrome trace JSON, which chrome://tracing and Perfetto display,
+    // and stops recording. Returns false and sets error if the file could not be written.
+    [[nodiscard]] bool finish_time_trace(const std::filesystem::path& path, std::string& error);
+
+    // Reports the passes that the callbacks instrument to the enabled report and trace.
+    void register_pass_timing(llvm::PassInstrumentationCallbacks& callbacks);
+} // namespace tildac
@@ -5,6 +5,7 @@ namespace tildac {
     using char32 = char32_t;
     
     using u8 = unsigned char;
+    using i32 = int;
     using i64 = long long;
     using u64 = unsigned long long;
 }
@@ -55,6 +55,10 @@ namespace tildac {
             return _pointer;
         }
 
+        [[nodiscard]] T* get() const {
+            return _pointer;
+        }
+
         [[nodiscard]] T* release() {
             T* pointer = _pointer;
             _pointer = nullptr;